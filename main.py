@@ -1,19 +1,168 @@
+import http.client
+import json
 import os
+import shutil
+import signal
+import subprocess
+import threading
 import time
+import urllib.error
+import urllib.parse
+import urllib.request
 import uuid
+from typing import NamedTuple
 from fastapi import FastAPI, Header, HTTPException
+from fastapi.responses import FileResponse
 from pydantic import BaseModel
 
 app = FastAPI()
 
 API_KEY = os.environ.get("WORKER_API_KEY", "")
 JOBS = {}  # demo only (memory). Replace with Redis/DB in production.
+JOBS_LOCK = threading.Lock()
+
+IV2GLB_BIN = os.environ.get("IV2GLB_BIN", "/app/bin/iv2glb")
+WORK_DIR = os.environ.get("WORK_DIR", "/tmp/iv2glb-work")
+OUTPUT_DIR = os.environ.get("OUTPUT_DIR", "/tmp/iv2glb-out")
+PUBLIC_BASE_URL = os.environ.get("PUBLIC_BASE_URL", "").rstrip("/")
+# Outputs go to OUTPUT_DIR (served by /v1/jobs/{id}/files/{name}) unless
+# OUTPUT_PUT_URL is set, e.g. "https://store.example/{jobId}/{name}", in which
+# case they are streamed there with chunked PUTs and published as
+# OUTPUT_PUBLIC_URL (same placeholders; defaults to the PUT URL).
+OUTPUT_PUT_URL = os.environ.get("OUTPUT_PUT_URL", "")
+OUTPUT_PUBLIC_URL = os.environ.get("OUTPUT_PUBLIC_URL", "")
+OUTPUT_PUT_AUTHORIZATION = os.environ.get("OUTPUT_PUT_AUTHORIZATION", "")
+MAX_CONCURRENT_JOBS = int(os.environ.get("MAX_CONCURRENT_JOBS", str(os.cpu_count() or 1)))
+
+# Scheduler knobs. A queued job's predicted cost is divided by
+# (1 + wait / SCHED_AGING_SECONDS), so a big job waiting that long competes
+# as if it were half its size. Tenant usage (predicted seconds dispatched)
+# decays with SCHED_USAGE_HALFLIFE and is added, weighted, to every job
+# score so one tenant's burst cannot monopolise the slots.
+SCHED_AGING_SECONDS = float(os.environ.get("SCHED_AGING_SECONDS", "60"))
+SCHED_FAIR_SHARE_WEIGHT = float(os.environ.get("SCHED_FAIR_SHARE_WEIGHT", "0.5"))
+SCHED_USAGE_HALFLIFE = float(os.environ.get("SCHED_USAGE_HALFLIFE", "300"))
+
+# Rough parse throughput per input kind (bytes/second) used until we have
+# something better. ASCII tokenizing dominates, binary is mostly memcpy.
+COST_BYTES_PER_SEC = {
+    "ascii": 20e6,
+    "vrml1": 20e6,
+    "vrml2": 20e6,
+    "binary": 120e6,
+    # Compressed inputs: scan bytes are the decompressed size.
+    "gzip": 15e6,
+    "zstd": 18e6,  # decoded on its own thread, overlapping the parse
+    "zip": 20e6,  # scan bytes are the inflated model entries
+    "mesh": 1e9,  # stored geometry: mapped, not parsed
+    "unknown": 20e6,
+}
+COST_FIXED_SEC = 0.2  # process start + SoDB::init
+
+# Pre-flight limits enforced in the validating stage from `iv2glb --scan`
+# (0 disables a limit). Anything over them is rejected before queueing.
+MAX_INPUT_BYTES = int(os.environ.get("MAX_INPUT_BYTES", "0"))
+MAX_INPUT_NODES = int(os.environ.get("MAX_INPUT_NODES", "0"))
+MAX_INPUT_COORDINATES = int(os.environ.get("MAX_INPUT_COORDINATES", "0"))
+MAX_INPUT_TRIANGLES = int(os.environ.get("MAX_INPUT_TRIANGLES", "0"))
+SCAN_TIMEOUT_SEC = float(os.environ.get("SCAN_TIMEOUT_SEC", "60"))
+
+# Pipelined jobs pipe the download into iv2glb's stdin while it parses
+# and upload the GLB from its stdout while it is written, so end-to-end time
+# approaches the slowest of download/convert/upload instead of their sum.
+# Used when options.streaming is true, or for inputs of at least
+# STREAMING_MIN_BYTES (0 = only on request). The native pre-flight scan needs
+# the whole file, so streamed inputs are only header-checked when validating.
+STREAMING_MIN_BYTES = int(os.environ.get("STREAMING_MIN_BYTES", "0"))
+STREAM_CHUNK = 1 << 20
+
+# Inputs are fetched over http(s) only (no file:// or ftp:// reads of the
+# worker's own files). A server that sends nothing for INPUT_FETCH_TIMEOUT_SEC
+# fails the download instead of holding the job's slot.
+INPUT_URL_SCHEMES = ("http", "https")
+INPUT_FETCH_TIMEOUT_SEC = float(os.environ.get("INPUT_FETCH_TIMEOUT_SEC", "60"))
+
+# options.preview: iv2glb writes a GLB of one box per part (--preview) as soon
+# as the scene is parsed; it is published as the job's previewUrl while the
+# full conversion continues, and the final GLB replaces it at completion.
+PREVIEW_POLL_SEC = 0.2
+
+# Thumbnails rendered by iv2glb on the CPU (--thumbnail), published as the
+# job's thumbnailUrl. THUMBNAIL_SIZE=0 disables them; options.thumbnail=false
+# opts a job out.
+THUMBNAIL_SIZE = int(os.environ.get("THUMBNAIL_SIZE", "256"))
+
+# Textures are scaled down to power-of-two sides of at most this many pixels
+# (--texture-max-size); 0 keeps them at their own size. Jobs may ask for
+# less via options.textureMaxSize.
+TEXTURE_MAX_SIZE = int(os.environ.get("TEXTURE_MAX_SIZE", "2048"))
+# png, or etc1s / uastc for GPU-compressed KTX2 (KHR_texture_basisu; needs an
+# iv2glb built with Basis Universal). options.textureFormat picks per job.
+TEXTURE_FORMAT = os.environ.get("TEXTURE_FORMAT", "png")
+TEXTURE_FORMATS = ("png", "etc1s", "uastc")
+# Small textures are packed into shared atlases (--texture-atlas) so their
+# materials and draw calls merge. TEXTURE_ATLAS=0 disables it;
+# options.textureAtlas=false opts a job out.
+TEXTURE_ATLAS = os.environ.get("TEXTURE_ATLAS", "1") != "0"
+
+# Per-job budgets passed to iv2glb (--deadline-ms / --max-rss-mb). Jobs may
+# ask for less via options.timeLimitSec / options.maxMemoryMb, never more.
+JOB_TIME_LIMIT_SEC = float(os.environ.get("JOB_TIME_LIMIT_SEC", "3600"))
+JOB_MAX_RSS_MB = int(os.environ.get("JOB_MAX_RSS_MB", "0"))
+CANCEL_GRACE_SEC = 2.0  # SIGTERM -> SIGKILL
+
+# Output triangle budget (options.maxTriangles may lower it; 0 = none). With
+# degrade on (default; options.degrade=false opts out) iv2glb meets the
+# triangle and memory budgets by streaming, dropping small parts and
+# decimating, and lists what it did in the job warnings, instead of failing.
+MAX_OUTPUT_TRIANGLES = int(os.environ.get("MAX_OUTPUT_TRIANGLES", "0"))
+DEGRADE_ON_BUDGET = os.environ.get("DEGRADE_ON_BUDGET", "1") != "0"
+
+# Binary Inventor cache of parsed inputs (iv2glb --cache-dir), so converting
+# the same source again (other options, retries) skips ASCII parsing. Empty
+# disables it. Least recently used entries are evicted past PARSE_CACHE_MAX_MB.
+PARSE_CACHE_DIR = os.environ.get("PARSE_CACHE_DIR", "")
+PARSE_CACHE_MAX_MB = int(os.environ.get("PARSE_CACHE_MAX_MB", "10240"))
+CACHE_PRUNE_LOCK = threading.Lock()
+
+# Extracted geometry of finished jobs (iv2glb --save-mesh), keyed by worker
+# job id. A later job with input {"type": "mesh", "jobId": ...} re-exports it
+# (other budgets or output options) without downloading or parsing the
+# source again. Empty disables it; evicted like the parse cache.
+MESH_STORE_DIR = os.environ.get("MESH_STORE_DIR", "")
+MESH_STORE_MAX_MB = int(os.environ.get("MESH_STORE_MAX_MB", "10240"))
+
+# iv2glb --io: read-ahead / write-behind through io_uring ("uring") or a
+# helper thread ("thread"). Empty keeps the converter's plain blocking I/O;
+# opt in where the overlap has been measured to pay off on this storage.
+CONVERTER_IO = os.environ.get("CONVERTER_IO", "")
+
+# iv2glb exit codes other than 0.
+IV2GLB_EXIT_MESSAGES = {
+    2: "invalid converter arguments",
+    3: "could not open input",
+    4: "invalid or unsupported Inventor file",
+    5: "GLB export failed",
+    6: "conversion exceeded its time budget",
+    7: "conversion exceeded its memory budget",
+    8: "conversion cancelled",
+    9: "conversion exceeded its triangle budget",
+}
+
+# Completed-job history used to train the cost predictor (JSON lines).
+COST_HISTORY_PATH = os.environ.get("COST_HISTORY_PATH", "/tmp/iv2glb-history.jsonl")
+PREDICTOR_MIN_SAMPLES = int(os.environ.get("PREDICTOR_MIN_SAMPLES", "20"))
+PREDICTOR_MAX_SAMPLES = 5000
+PREDICTOR_RIDGE = 1e-3
 
 
 class StartJobRequest(BaseModel):
     jobId: str
     input: dict  # { type: "iv"|"zip", url: "...", filename: "..." }
-    options: dict | None = None
+    options: dict | None = None  # { tenantId: "...", zipOutput: "combined"|"separate", layout: "glb"|"gltf",
+    #                                splitAssemblies: depth, preview: bool, proxyBoxes: depth,
+    #                                thumbnail: bool, textureMaxSize: px,
+    #                                textureFormat: "png"|"etc1s"|"uastc", textureAtlas: bool, ... }
 
 
 def require_auth(authorization: str | None):
@@ -26,6 +175,1214 @@ def require_auth(authorization: str | None):
         raise HTTPException(status_code=403, detail="Invalid token")
 
 
+def update_job(job_id: str, **fields):
+    """Update a job's fields unless it has been cancelled (cancellation is final)."""
+    with JOBS_LOCK:
+        job = JOBS.get(job_id)
+        if job is not None and job["status"] != "cancelled":
+            job.update(fields)
+        return job
+
+
+def fail_job(job_id: str, message: str):
+    with JOBS_LOCK:
+        job = JOBS.get(job_id)
+        if job is None or job["status"] == "cancelled":
+            return
+        job.update(status="failed", stage="failed", error=message, finishedAt=time.time())
+
+
+class JobCancelled(Exception):
+    pass
+
+
+def check_cancelled(job_id: str):
+    if JOBS[job_id]["cancelEvent"].is_set():
+        raise JobCancelled()
+
+
+def sniff_header(prefix: bytes) -> str:
+    """Input kind from its first bytes (the header line check of --scan)."""
+    if prefix[:2] == b"\x1f\x8b":
+        return "gzip"
+    if prefix[:4] == b"\x28\xb5\x2f\xfd":
+        return "zstd"
+    first_line = prefix.split(b"\n", 1)[0]
+    if first_line.startswith(b"#Inventor V"):
+        return "binary" if b"binary" in first_line else "ascii"
+    if first_line.startswith(b"#VRML V1.0"):
+        return "vrml1"
+    if first_line.startswith(b"#VRML V2.0"):
+        return "vrml2"
+    return "unknown"
+
+
+class InputRedirectHandler(urllib.request.HTTPRedirectHandler):
+    """Follows redirects only to other http(s) URLs."""
+
+    def redirect_request(self, req, fp, code, msg, headers, newurl):
+        if urllib.parse.urlsplit(newurl).scheme not in INPUT_URL_SCHEMES:
+            raise urllib.error.HTTPError(newurl, code, f"redirect to unsupported URL {newurl}", headers, fp)
+        return super().redirect_request(req, fp, code, msg, headers, newurl)
+
+
+INPUT_OPENER = urllib.request.build_opener(InputRedirectHandler)
+
+
+def check_input_url(url: str):
+    scheme = urllib.parse.urlsplit(url).scheme
+    if scheme not in INPUT_URL_SCHEMES:
+        raise ValueError(f"unsupported input URL scheme: {scheme or 'none'}")
+
+
+def open_input(url: str, headers: dict | None = None):
+    """The input's HTTP response, with the fetch timeout applied to every read."""
+    check_input_url(url)
+    return INPUT_OPENER.open(urllib.request.Request(url, headers=headers or {}), timeout=INPUT_FETCH_TIMEOUT_SEC)
+
+
+def input_chunks(resp, size: int = STREAM_CHUNK):
+    """The body of an open_input response in chunks of up to `size` bytes.
+
+    http.client ends a body cut short of its Content-Length like a complete
+    one, so that is checked here: a connection dropped mid-download must
+    fail the job, not hand iv2glb a truncated input.
+    """
+    while chunk := resp.read(size):
+        yield chunk
+    if resp.length:
+        raise http.client.IncompleteRead(b"", resp.length)
+
+
+def probe_input(url: str) -> tuple[int | None, bytes]:
+    """Size and first 4 KiB of a remote input without downloading it."""
+    with open_input(url, {"Range": "bytes=0-4095"}) as resp:
+        prefix = resp.read(4096)
+        size = None
+        content_range = resp.headers.get("Content-Range", "")
+        if resp.status == 206 and "/" in content_range:
+            total = content_range.rsplit("/", 1)[1]
+            size = int(total) if total.isdigit() else None
+        elif resp.headers.get("Content-Length"):
+            size = int(resp.headers["Content-Length"])
+    return size, prefix
+
+
+def scan_input(path: str) -> dict:
+    """Run the native pre-flight scan. Raises ValueError if the input is rejected."""
+    try:
+        proc = subprocess.run(
+            [IV2GLB_BIN, "--scan", path],
+            capture_output=True,
+            text=True,
+            timeout=SCAN_TIMEOUT_SEC,
+        )
+    except subprocess.TimeoutExpired:
+        raise ValueError("pre-flight scan timed out")
+    try:
+        scan = json.loads(proc.stdout)
+    except ValueError:
+        raise ValueError(proc.stderr.strip() or f"pre-flight scan failed (exit {proc.returncode})")
+    if not scan.get("valid"):
+        raise ValueError(scan.get("error") or "malformed input")
+
+    limits = (
+        ("bytes", MAX_INPUT_BYTES, "input size"),
+        ("nodes", MAX_INPUT_NODES, "node count"),
+        ("coordinates", MAX_INPUT_COORDINATES, "coordinate count"),
+        ("triangleEstimate", MAX_INPUT_TRIANGLES, "estimated triangle count"),
+    )
+    for key, limit, label in limits:
+        if limit and scan.get(key, 0) > limit:
+            raise ValueError(f"{label} {scan[key]} exceeds limit {limit}")
+    return scan
+
+
+def scan_features(scan: dict) -> dict:
+    """Map scan counts onto the predictor's (iv2glb --stats) feature names."""
+    if scan.get("format", scan["kind"]) not in ("ascii", "vrml1", "vrml2"):
+        return {"inputBytes": scan["bytes"]}
+    nodes = scan["nodes"]
+    return {
+        "inputBytes": scan["bytes"],
+        "nodeCount": nodes,
+        "shapeCount": scan["shapes"],
+        "triangleCount": scan["triangleEstimate"],
+        "defUseRatio": (nodes + scan["uses"]) / nodes if nodes else 1.0,
+    }
+
+
+def estimate_cost(size_bytes: int, kind: str) -> float:
+    """Predicted conversion time in seconds, used only for ordering."""
+    return COST_FIXED_SEC + size_bytes / COST_BYTES_PER_SEC.get(kind, COST_BYTES_PER_SEC["unknown"])
+
+
+def _solve(a, b):
+    """Solve a x = b for a small dense system (Gaussian elimination, partial pivoting)."""
+    n = len(b)
+    m = [row[:] + [b[i]] for i, row in enumerate(a)]
+    for col in range(n):
+        piv = max(range(col, n), key=lambda r: abs(m[r][col]))
+        if abs(m[piv][col]) < 1e-12:
+            continue
+        m[col], m[piv] = m[piv], m[col]
+        for r in range(n):
+            if r != col and m[r][col] != 0.0:
+                f = m[r][col] / m[col][col]
+                for c in range(col, n + 1):
+                    m[r][c] -= f * m[col][c]
+    return [m[i][n] / m[i][i] if abs(m[i][i]) >= 1e-12 else 0.0 for i in range(n)]
+
+
+def _fit_ridge(xs, ys):
+    n = len(xs[0])
+    xtx = [[0.0] * n for _ in range(n)]
+    xty = [0.0] * n
+    for x, y in zip(xs, ys):
+        for i in range(n):
+            xty[i] += x[i] * y
+            for j in range(n):
+                xtx[i][j] += x[i] * x[j]
+    for i in range(1, n):  # leave the intercept unpenalised
+        xtx[i][i] += PREDICTOR_RIDGE * len(xs)
+    return _solve(xtx, xty)
+
+
+def _error_report(pairs):
+    """pairs: [(predicted, actual)] -> MAE, median abs % error, R^2."""
+    if not pairs:
+        return None
+    actual = [a for _, a in pairs]
+    mean = sum(actual) / len(actual)
+    ss_tot = sum((a - mean) ** 2 for a in actual)
+    ss_res = sum((p - a) ** 2 for p, a in pairs)
+    pct = sorted(abs(p - a) / a for p, a in pairs if a > 0)
+    return {
+        "n": len(pairs),
+        "mae": sum(abs(p - a) for p, a in pairs) / len(pairs),
+        "medianAbsPctError": pct[len(pct) // 2] if pct else None,
+        "r2": 1.0 - ss_res / ss_tot if ss_tot > 0 else None,
+    }
+
+
+class CostPredictor:
+    """Linear (ridge) model of conversion time and peak RSS from job features.
+
+    Features are the job's features as of submission (scan_features: input
+    bytes, node/shape/triangle counts and DEF/USE ratio from the pre-flight
+    scan, through the decompressor for gzip/zstd), for training as well as
+    prediction, so the model never learns from counts it cannot see up front
+    (iv2glb's shapeCount counts instances, the scan counts shape nodes). Counts
+    the scan cannot take (binary, streamed inputs) are imputed from the input
+    size using the median per-byte density seen in history. Until
+    PREDICTOR_MIN_SAMPLES jobs have completed the size-based heuristic
+    (estimate_cost) is used instead.
+    """
+
+    FEATURES = ("inputBytes", "nodeCount", "shapeCount", "triangleCount", "defUseRatio")
+    SCALE = (1e6, 1e3, 1e3, 1e6, 1.0)
+
+    def __init__(self, path: str):
+        self._path = path
+        self._lock = threading.Lock()
+        self._rows = []
+        self._time_w = None
+        self._rss_w = None
+        self._density = {}
+        try:
+            with open(path) as f:
+                self._rows = [json.loads(line) for line in f if line.strip()][-PREDICTOR_MAX_SAMPLES:]
+        except (OSError, ValueError):
+            self._rows = []
+        self._refit()
+
+    def _vector(self, features: dict, kind: str):
+        x = [1.0]
+        for name, scale in zip(self.FEATURES, self.SCALE):
+            x.append(float(features.get(name) or 0.0) / scale)
+        x.append(1.0 if kind == "binary" else 0.0)
+        x.append(1.0 if kind in ("gzip", "zstd") else 0.0)
+        return x
+
+    def _refit(self):
+        rows = self._rows
+        if len(rows) < PREDICTOR_MIN_SAMPLES:
+            self._time_w = self._rss_w = None
+            return
+        for name in self.FEATURES[1:-1]:
+            ratios = sorted(
+                r["features"][name] / r["features"]["inputBytes"]
+                for r in rows
+                if r["features"].get(name) is not None and r["features"].get("inputBytes")
+            )
+            self._density[name] = ratios[len(ratios) // 2] if ratios else 0.0
+        ratios = sorted(r["features"]["defUseRatio"] for r in rows if r["features"].get("defUseRatio") is not None)
+        self._density["defUseRatio"] = ratios[len(ratios) // 2] if ratios else 1.0
+        xs = [self._vector(self._impute(r["features"]), r.get("kind", "unknown")) for r in rows]
+        self._time_w = _fit_ridge(xs, [r["seconds"] for r in rows])
+        self._rss_w = _fit_ridge(xs, [r["peakRssMb"] for r in rows])
+
+    def _impute(self, features: dict, density: dict | None = None) -> dict:
+        density = self._density if density is None else density
+        full = dict(features)
+        size = full.get("inputBytes") or 0
+        for name in self.FEATURES[1:]:
+            if full.get(name) is None:
+                d = density.get(name, 1.0 if name == "defUseRatio" else 0.0)
+                full[name] = d if name == "defUseRatio" else d * size
+        return full
+
+    def predict(self, features: dict, kind: str) -> dict:
+        with self._lock:
+            # The regression models parsing, which stored meshes skip.
+            if self._time_w is None or kind == "mesh":
+                return {
+                    "seconds": estimate_cost(features.get("inputBytes") or 0, kind),
+                    "peakRssMb": None,
+                    "model": "heuristic",
+                }
+            x = self._vector(self._impute(features), kind)
+            seconds = sum(w * v for w, v in zip(self._time_w, x))
+            rss = sum(w * v for w, v in zip(self._rss_w, x))
+            return {
+                "seconds": max(COST_FIXED_SEC, seconds),
+                "peakRssMb": max(1.0, rss),
+                "model": "regression",
+            }
+
+    def record(self, features: dict, kind: str, seconds: float, peak_rss_mb: float, predicted: dict | None):
+        row = {
+            "features": {k: features.get(k) for k in self.FEATURES},
+            "kind": kind,
+            "seconds": seconds,
+            "peakRssMb": peak_rss_mb,
+            "predicted": predicted,
+            "at": time.time(),
+        }
+        with self._lock:
+            self._rows.append(row)
+            del self._rows[:-PREDICTOR_MAX_SAMPLES]
+            try:
+                with open(self._path, "a") as f:
+                    f.write(json.dumps(row) + "\n")
+            except OSError:
+                pass
+            self._refit()
+
+    def report(self) -> dict:
+        """Accuracy of the predictions actually made at submit time, plus a
+        holdout refit (train on the oldest 80%, score the newest 20%)."""
+        with self._lock:
+            rows = list(self._rows)
+            density = dict(self._density)
+        live = [r for r in rows if (r.get("predicted") or {}).get("model") == "regression"]
+        result = {
+            "samples": len(rows),
+            "model": "regression" if len(rows) >= PREDICTOR_MIN_SAMPLES else "heuristic",
+            "live": {
+                "seconds": _error_report([(r["predicted"]["seconds"], r["seconds"]) for r in live]),
+                "peakRssMb": _error_report([(r["predicted"]["peakRssMb"], r["peakRssMb"]) for r in live]),
+            },
+            "holdout": None,
+        }
+        split = int(len(rows) * 0.8)
+        if split >= PREDICTOR_MIN_SAMPLES and len(rows) - split >= 5:
+            xs = [self._vector(self._impute(r["features"], density), r.get("kind", "unknown")) for r in rows]
+            tw = _fit_ridge(xs[:split], [r["seconds"] for r in rows[:split]])
+            rw = _fit_ridge(xs[:split], [r["peakRssMb"] for r in rows[:split]])
+            dot = lambda w, x: sum(a * b for a, b in zip(w, x))
+            result["holdout"] = {
+                "seconds": _error_report([(dot(tw, x), r["seconds"]) for x, r in zip(xs[split:], rows[split:])]),
+                "peakRssMb": _error_report([(dot(rw, x), r["peakRssMb"]) for x, r in zip(xs[split:], rows[split:])]),
+            }
+        return result
+
+
+class QueueEntry(NamedTuple):
+    job_id: str
+    queued_at: float
+    predicted_cost: float
+    tenant: str
+
+
+class Scheduler:
+    """Shortest-expected-job-first with aging and per-tenant fair share.
+
+    Scores are time dependent (aging, usage decay), so the queue is a plain
+    list scanned on every dispatch rather than a heap; it only ever holds the
+    jobs that are waiting for one of MAX_CONCURRENT_JOBS slots. Entries carry
+    the score inputs as of submission, so scoring never reads JOBS (which
+    request handlers change under JOBS_LOCK).
+    """
+
+    def __init__(self, slots: int):
+        self._cv = threading.Condition()
+        self._queue = []  # QueueEntry
+        self._usage = {}  # tenant -> [decayed predicted seconds, timestamp]
+        self._threads = [
+            threading.Thread(target=self._worker_loop, name=f"job-slot-{i}", daemon=True)
+            for i in range(max(1, slots))
+        ]
+        for t in self._threads:
+            t.start()
+
+    def submit(self, job_id: str, queued_at: float, predicted_cost: float, tenant: str):
+        with self._cv:
+            self._queue.append(QueueEntry(job_id, queued_at, predicted_cost, tenant))
+            self._cv.notify()
+
+    def remove(self, job_id: str) -> bool:
+        with self._cv:
+            for entry in self._queue:
+                if entry.job_id == job_id:
+                    self._queue.remove(entry)
+                    return True
+            return False
+
+    def queue_position(self, job_id: str) -> int | None:
+        with self._cv:
+            now = time.time()
+            order = [e.job_id for e in sorted(self._queue, key=lambda e: self._score(e, now))]
+            return order.index(job_id) if job_id in order else None
+
+    def _tenant_usage(self, tenant: str, now: float) -> float:
+        usage, stamp = self._usage.get(tenant, (0.0, now))
+        return usage * 0.5 ** ((now - stamp) / SCHED_USAGE_HALFLIFE)
+
+    def _charge(self, tenant: str, cost: float, now: float):
+        self._usage[tenant] = [self._tenant_usage(tenant, now) + cost, now]
+
+    def _score(self, entry: "QueueEntry", now: float) -> float:
+        wait = now - entry.queued_at
+        aged_cost = entry.predicted_cost / (1.0 + wait / SCHED_AGING_SECONDS)
+        return aged_cost + SCHED_FAIR_SHARE_WEIGHT * self._tenant_usage(entry.tenant, now)
+
+    def _next(self) -> str:
+        with self._cv:
+            while not self._queue:
+                self._cv.wait()
+            now = time.time()
+            entry = min(self._queue, key=lambda e: self._score(e, now))
+            self._queue.remove(entry)
+            self._charge(entry.tenant, entry.predicted_cost, now)
+            return entry.job_id
+
+    def _worker_loop(self):
+        while True:
+            job_id = self._next()
+            try:
+                run_job(job_id)
+            except JobCancelled:
+                pass
+            except Exception as e:  # keep the slot alive whatever happens
+                fail_job(job_id, f"Internal error: {e}")
+
+
+PART_SUFFIX = ".part"
+
+
+class LocalOutputStore:
+    """Outputs under OUTPUT_DIR/<job>/, served by GET /v1/jobs/{id}/files/{name}.
+
+    Each file is written under a .part name and renamed into place, so a
+    file that exists is complete and can be served while the job runs
+    (the preview).
+    """
+
+    def put_stream(self, job_id: str, name: str, stream, content_type: str) -> str:
+        out_dir = os.path.join(OUTPUT_DIR, job_id)
+        os.makedirs(out_dir, exist_ok=True)
+        part = os.path.join(out_dir, name + PART_SUFFIX)
+        with open(part, "wb") as f:
+            shutil.copyfileobj(stream, f, STREAM_CHUNK)
+        os.replace(part, os.path.join(out_dir, name))
+        return output_url(job_id, name)
+
+    def put_file(self, job_id: str, name: str, path: str, content_type: str) -> str:
+        out_dir = os.path.join(OUTPUT_DIR, job_id)
+        os.makedirs(out_dir, exist_ok=True)
+        part = os.path.join(out_dir, name + PART_SUFFIX)
+        shutil.move(path, part)
+        os.replace(part, os.path.join(out_dir, name))
+        return output_url(job_id, name)
+
+    def delete(self, job_id: str):
+        shutil.rmtree(os.path.join(OUTPUT_DIR, job_id), ignore_errors=True)
+
+
+class HttpOutputStore:
+    """Streams outputs to OUTPUT_PUT_URL with chunked-encoding PUTs."""
+
+    def __init__(self, put_template: str, public_template: str):
+        self._put = put_template
+        self._public = public_template or put_template
+        self._names = {}  # job id -> names uploaded, for delete()
+
+    def _request(self, method: str, job_id: str, name: str, body=None, headers=None):
+        url = urllib.parse.urlsplit(self._put.format(jobId=job_id, name=name))
+        conn_cls = http.client.HTTPSConnection if url.scheme == "https" else http.client.HTTPConnection
+        conn = conn_cls(url.netloc, timeout=300)
+        headers = dict(headers or {})
+        if OUTPUT_PUT_AUTHORIZATION:
+            headers["Authorization"] = OUTPUT_PUT_AUTHORIZATION
+        try:
+            path = url.path + (f"?{url.query}" if url.query else "")
+            conn.request(method, path, body=body, headers=headers, encode_chunked=body is not None)
+            resp = conn.getresponse()
+            resp.read()
+            return resp.status
+        finally:
+            conn.close()
+
+    def put_stream(self, job_id: str, name: str, stream, content_type: str) -> str:
+        def chunks():
+            while chunk := stream.read(STREAM_CHUNK):
+                yield chunk
+
+        self._names.setdefault(job_id, set()).add(name)
+        status = self._request("PUT", job_id, name, chunks(), {"Content-Type": content_type})
+        if status >= 300:
+            raise OSError(f"upload of {name} failed: HTTP {status}")
+        return self._public.format(jobId=job_id, name=name)
+
+    def put_file(self, job_id: str, name: str, path: str, content_type: str) -> str:
+        with open(path, "rb") as f:
+            return self.put_stream(job_id, name, f, content_type)
+
+    def delete(self, job_id: str):
+        for name in self._names.pop(job_id, ()):
+            try:
+                self._request("DELETE", job_id, name)
+            except OSError:
+                pass
+
+
+def download_input(job_id: str, url: str, dest: str):
+    with open_input(url) as resp, open(dest, "wb") as f:
+        for chunk in input_chunks(resp):
+            check_cancelled(job_id)
+            f.write(chunk)
+
+
+def intake_job(job_id: str):
+    """'validating' stage: fetch and pre-scan the input, predict its cost, queue it."""
+    job = JOBS[job_id]
+    spec = job["input"]
+    input_type = spec.get("type", "iv")
+    if input_type not in ("iv", "zip", "mesh"):
+        fail_job(job_id, f"Unsupported input type: {input_type}")
+        return
+    texture_format = job["options"].get("textureFormat") or TEXTURE_FORMAT
+    if texture_format not in TEXTURE_FORMATS:
+        fail_job(job_id, f"Unsupported texture format: {texture_format}")
+        return
+    if input_type == "mesh":
+        intake_mesh(job_id, spec)
+        return
+    if not spec.get("url"):
+        fail_job(job_id, "input.url is required")
+        return
+    try:
+        check_input_url(spec["url"])
+    except ValueError as e:
+        fail_job(job_id, f"Input rejected: {e}")
+        return
+
+    work_dir = os.path.join(WORK_DIR, job_id)
+    os.makedirs(work_dir, exist_ok=True)
+    # A zip's directory is at its end, so archives are always downloaded first.
+    # Multi-file outputs cannot go out on one stdout, so those are not piped.
+    if (
+        input_type == "iv"
+        and single_file_output(job["options"])
+        and (job["options"].get("streaming") or STREAMING_MIN_BYTES)
+    ):
+        try:
+            size, prefix = probe_input(spec["url"])
+        except Exception as e:
+            shutil.rmtree(work_dir, ignore_errors=True)
+            fail_job(job_id, f"Failed to fetch input: {e}")
+            return
+        if job["options"].get("streaming") or size is None or size >= STREAMING_MIN_BYTES:
+            intake_streaming(job_id, work_dir, size, prefix)
+            return
+
+    in_path = os.path.join(work_dir, f"input.{input_type}")
+    try:
+        download_input(job_id, spec["url"], in_path)
+    except JobCancelled:
+        shutil.rmtree(work_dir, ignore_errors=True)
+        return
+    except Exception as e:
+        shutil.rmtree(work_dir, ignore_errors=True)
+        fail_job(job_id, f"Failed to download input: {e}")
+        return
+
+    try:
+        scan = scan_input(in_path)
+    except ValueError as e:
+        shutil.rmtree(work_dir, ignore_errors=True)
+        fail_job(job_id, f"Input rejected: {e}")
+        return
+
+    kind = scan["kind"]
+    features = scan_features(scan)
+    prediction = PREDICTOR.predict(features, kind)
+    update_job(
+        job_id,
+        stage="queued",
+        progress=10,
+        workDir=work_dir,
+        inputPath=in_path,
+        inputKind=kind,
+        scan=scan,
+        features=features,
+        prediction=prediction,
+        predictedCost=prediction["seconds"],
+        queuedAt=time.time(),
+    )
+    enqueue(job_id, work_dir)
+
+
+def mesh_store_path(job_id: str) -> str:
+    return os.path.join(MESH_STORE_DIR, f"{job_id}.ivmesh")
+
+
+def intake_mesh(job_id: str, spec: dict):
+    """Validating stage for re-exports of a stored mesh: nothing to fetch or scan."""
+    if not MESH_STORE_DIR:
+        fail_job(job_id, "Mesh inputs are not enabled on this worker")
+        return
+    try:
+        source = str(uuid.UUID(str(spec.get("jobId"))))
+    except ValueError:
+        fail_job(job_id, "input.jobId must be a worker job id")
+        return
+    in_path = mesh_store_path(source)
+    try:
+        size = os.path.getsize(in_path)
+    except OSError:
+        fail_job(job_id, f"No stored mesh for job {source} (never saved or evicted)")
+        return
+
+    work_dir = os.path.join(WORK_DIR, job_id)
+    os.makedirs(work_dir, exist_ok=True)
+    features = {"inputBytes": size}
+    prediction = PREDICTOR.predict(features, "mesh")
+    update_job(
+        job_id,
+        stage="queued",
+        progress=10,
+        workDir=work_dir,
+        inputPath=in_path,
+        inputKind="mesh",
+        features=features,
+        prediction=prediction,
+        predictedCost=prediction["seconds"],
+        queuedAt=time.time(),
+    )
+    enqueue(job_id, work_dir)
+
+
+def intake_streaming(job_id: str, work_dir: str, size: int | None, prefix: bytes):
+    """Validating stage for pipelined jobs: header check and size limit only."""
+    kind = sniff_header(prefix)
+    if kind == "unknown":
+        shutil.rmtree(work_dir, ignore_errors=True)
+        fail_job(job_id, "Input rejected: not an Inventor or VRML file (bad header)")
+        return
+    if MAX_INPUT_BYTES and size is not None and size > MAX_INPUT_BYTES:
+        shutil.rmtree(work_dir, ignore_errors=True)
+        fail_job(job_id, f"Input rejected: input size {size} exceeds limit {MAX_INPUT_BYTES}")
+        return
+    features = {"inputBytes": size or 0}
+    prediction = PREDICTOR.predict(features, kind)
+    update_job(
+        job_id,
+        stage="queued",
+        progress=10,
+        workDir=work_dir,
+        streaming=True,
+        inputKind=kind,
+        features=features,
+        prediction=prediction,
+        predictedCost=prediction["seconds"],
+        queuedAt=time.time(),
+    )
+    enqueue(job_id, work_dir)
+
+
+def enqueue(job_id: str, work_dir: str):
+    with JOBS_LOCK:
+        if JOBS[job_id]["cancelEvent"].is_set():
+            shutil.rmtree(work_dir, ignore_errors=True)
+            return
+        job = JOBS[job_id]
+        SCHEDULER.submit(job_id, job["queuedAt"], job["predictedCost"], job["tenant"])
+
+
+def read_stats(path: str) -> dict | None:
+    try:
+        with open(path) as f:
+            return json.load(f)
+    except (OSError, ValueError):
+        return None
+
+
+def native_seconds(stats: dict) -> float:
+    """iv2glb's own time from its stats, for the cost predictor: wall time
+    would include streaming the output to the store. fastParseMs is part
+    of parseMs."""
+    return (
+        sum(
+            stats.get(k) or 0.0
+            for k in ("parseMs", "traverseMs", "atlasMs", "writeMs", "thumbnailMs", "saveMeshMs", "cacheMs", "previewMs")
+        )
+        / 1000.0
+    )
+
+
+def output_url(job_id: str, name: str) -> str:
+    return f"{PUBLIC_BASE_URL}/v1/jobs/{job_id}/files/{name}"
+
+
+def job_budget_args(options: dict) -> list:
+    limit = JOB_TIME_LIMIT_SEC
+    if options.get("timeLimitSec"):
+        limit = min(limit, float(options["timeLimitSec"])) if limit else float(options["timeLimitSec"])
+    rss = JOB_MAX_RSS_MB
+    if options.get("maxMemoryMb"):
+        rss = min(rss, int(options["maxMemoryMb"])) if rss else int(options["maxMemoryMb"])
+    tris = MAX_OUTPUT_TRIANGLES
+    if options.get("maxTriangles"):
+        tris = min(tris, int(options["maxTriangles"])) if tris else int(options["maxTriangles"])
+    args = []
+    if limit:
+        args += ["--deadline-ms", str(int(limit * 1000))]
+    if rss:
+        args += ["--max-rss-mb", str(rss)]
+    if tris:
+        args += ["--max-triangles", str(tris)]
+    if DEGRADE_ON_BUDGET and options.get("degrade", True):
+        args.append("--degrade")
+    if PARSE_CACHE_DIR and options.get("parseCache", True):
+        args += ["--cache-dir", PARSE_CACHE_DIR]
+    if CONVERTER_IO:
+        args += ["--io", CONVERTER_IO]
+    return args
+
+
+def single_file_output(options: dict) -> bool:
+    """True if the output is one GLB, which iv2glb can write to stdout."""
+    return (
+        options.get("layout") != "gltf"
+        and not options.get("splitAssemblies")
+        and not options.get("metadataOnly")
+    )
+
+
+def layout_args(options: dict) -> list:
+    """Output layout: options.chunkTriangles splits meshes into spatial chunks;
+    options.textureMaxSize lowers the texture size limit,
+    options.textureFormat picks how textures are encoded and
+    options.textureAtlas=false keeps textures out of atlases."""
+    args = []
+    if options.get("chunkTriangles"):
+        args += ["--chunk-triangles", str(int(options["chunkTriangles"]))]
+    texture_max = TEXTURE_MAX_SIZE
+    if options.get("textureMaxSize"):
+        requested = int(options["textureMaxSize"])
+        texture_max = min(texture_max, requested) if texture_max else requested
+    if texture_max > 0:
+        args += ["--texture-max-size", str(texture_max)]
+    texture_format = options.get("textureFormat") or TEXTURE_FORMAT
+    if texture_format != "png":
+        args += ["--texture-format", texture_format]
+    if TEXTURE_ATLAS and options.get("textureAtlas", True):
+        args.append("--texture-atlas")
+    return args
+
+
+def save_mesh_args(job_id: str, kind: str) -> list:
+    """Keep the job's geometry for later mesh inputs (not for zips or meshes)."""
+    if not MESH_STORE_DIR or kind in ("zip", "mesh"):
+        return []
+    return ["--save-mesh", mesh_store_path(job_id)]
+
+
+def preview_args(job: dict) -> list:
+    """options.preview: a box-per-part GLB written before the full traversal."""
+    if not job["options"].get("preview") or job["inputKind"] in ("zip", "mesh"):
+        return []
+    return ["--preview", os.path.join(job["workDir"], "preview.glb")]
+
+
+def thumbnail_path(job: dict) -> str:
+    return os.path.join(job["workDir"], "thumbnail.png")
+
+
+def thumbnail_args(job: dict) -> list:
+    if not THUMBNAIL_SIZE or not job["options"].get("thumbnail", True):
+        return []
+    return ["--thumbnail", thumbnail_path(job), "--thumbnail-size", str(THUMBNAIL_SIZE)]
+
+
+def upload_thumbnail(job_id: str, job: dict) -> str | None:
+    """Publish the thumbnail iv2glb rendered, if any. A failure costs only the thumbnail."""
+    path = thumbnail_path(job)
+    if not os.path.exists(path):
+        return None
+    try:
+        return OUTPUT_STORE.put_file(job_id, "thumbnail.png", path, "image/png")
+    except Exception as e:
+        job["warnings"].append(f"Thumbnail upload failed: {e}")
+        return None
+
+
+def metadata_only(job: dict) -> bool:
+    """options.metadataOnly: report the scene metadata without writing a GLB (not for zips)."""
+    return bool(job["options"].get("metadataOnly")) and job["inputKind"] != "zip"
+
+
+def proxy_depth(job: dict) -> int | None:
+    """options.proxyBoxes: only bounding boxes, as instances of one cube, per
+    shape (0 or true) or per node at that depth. None if not requested."""
+    depth = job["options"].get("proxyBoxes")
+    if depth is None or depth is False or job["inputKind"] in ("zip", "mesh"):
+        return None
+    return 0 if depth is True else int(depth)
+
+
+def output_args(job_id: str, job: dict) -> list:
+    """A box proxy, or the mesh with its preview, thumbnail and stored copy."""
+    depth = proxy_depth(job)
+    if depth is not None:
+        return ["--proxy-boxes", str(depth)]
+    return [*preview_args(job), *thumbnail_args(job), *save_mesh_args(job_id, job["inputKind"])]
+
+
+def publish_preview(job_id: str, path: str, done: threading.Event):
+    """Preview thread: upload the --preview GLB once iv2glb has renamed it into place."""
+    while not done.wait(PREVIEW_POLL_SEC):
+        if not os.path.exists(path):
+            continue
+        try:
+            url = OUTPUT_STORE.put_file(job_id, "preview.glb", path, "model/gltf-binary")
+        except Exception as e:
+            JOBS[job_id]["warnings"].append(f"Preview upload failed: {e}")
+            return
+        update_job(job_id, previewUrl=url)
+        return
+
+
+def watch_preview(job_id: str, args: list):
+    """Publish the preview named in iv2glb `args`, if any; returns a function that stops it.
+
+    A preview not yet uploaded when the converter exits is dropped: the
+    final output is about to be published instead.
+    """
+    if "--preview" not in args:
+        return lambda: None
+    done = threading.Event()
+    path = args[args.index("--preview") + 1]
+    thread = threading.Thread(target=publish_preview, args=(job_id, path, done), daemon=True)
+    thread.start()
+
+    def stop():
+        done.set()
+        thread.join()
+
+    return stop
+
+
+def prune_cache_dir(directory: str, max_mb: int):
+    """Evict least recently used cache entries (iv2glb refreshes mtime on a hit)."""
+    with CACHE_PRUNE_LOCK:
+        entries = []
+        now = time.time()
+        for entry in os.scandir(directory):
+            try:
+                st = entry.stat()
+            except OSError:
+                continue
+            if ".tmp" in entry.name:
+                if now - st.st_mtime > 3600:  # left by a killed conversion
+                    os.unlink(entry.path)
+                continue
+            entries.append((st.st_mtime, st.st_size, entry.path))
+        total = sum(size for _, size, _ in entries)
+        for _, size, path in sorted(entries):
+            if total <= max_mb * 1024 * 1024:
+                break
+            try:
+                os.unlink(path)
+            except OSError:
+                pass
+            total -= size
+
+
+def start_converter(job_id: str, args: list, binary: bool = False, stdin: bool = False) -> subprocess.Popen:
+    """Start iv2glb for a job, registered so DELETE can terminate it.
+
+    `binary`: stdout carries the GLB (output path "-"), so pipes stay bytes.
+    `stdin`: the input is written to a pipe on stdin (input path "-").
+    """
+    with JOBS_LOCK:
+        check_cancelled(job_id)
+        proc = subprocess.Popen(
+            args,
+            stdin=subprocess.PIPE if stdin else subprocess.DEVNULL,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.PIPE,
+            text=not binary,
+        )
+        JOBS[job_id]["proc"] = proc
+    return proc
+
+
+def run_converter(job_id: str, args: list) -> subprocess.CompletedProcess:
+    proc = start_converter(job_id, args)
+    stop_preview = watch_preview(job_id, args)
+    try:
+        out, err = proc.communicate()
+    finally:
+        stop_preview()
+        with JOBS_LOCK:
+            JOBS[job_id]["proc"] = None
+    check_cancelled(job_id)
+    return subprocess.CompletedProcess(args, proc.returncode, out, err)
+
+
+def upload_stdout(job_id: str, stream, result: dict):
+    """Upload thread: stream the GLB iv2glb writes to stdout to the output store."""
+    try:
+        result["glbUrl"] = OUTPUT_STORE.put_stream(job_id, "model.glb", stream, "model/gltf-binary")
+    except Exception as e:
+        JOBS[job_id]["pipelineError"] = f"upload failed: {e}"
+    finally:
+        stream.close()  # iv2glb's next write then fails instead of blocking
+
+
+def feed_stdin(job_id: str, url: str, stream):
+    """Download thread: stream the input into iv2glb's stdin."""
+    try:
+        with open_input(url) as resp:
+            for chunk in input_chunks(resp):
+                if JOBS[job_id]["cancelEvent"].is_set():
+                    return
+                stream.write(chunk)
+    except BrokenPipeError:
+        pass  # iv2glb stopped reading; its exit status says why
+    except Exception as e:
+        JOBS[job_id]["pipelineError"] = f"download failed: {e}"
+    finally:
+        try:
+            stream.close()  # EOF for iv2glb
+        except BrokenPipeError:
+            pass
+
+
+def run_converter_to_store(
+    job_id: str, args: list, result: dict, input_url: str | None = None
+) -> subprocess.CompletedProcess:
+    """Run iv2glb with the GLB on stdout, uploading it while it is written.
+
+    With `input_url` the input is downloaded into iv2glb's stdin as it
+    parses; `args` then end before the input path. Nothing touches the work
+    directory; result["glbUrl"] is set once the upload completes.
+    """
+    if input_url is not None:
+        args = [*args, "-"]
+    proc = start_converter(job_id, [*args, "-"], binary=True, stdin=input_url is not None)
+    stop_preview = watch_preview(job_id, args)
+    threads = [threading.Thread(target=upload_stdout, args=(job_id, proc.stdout, result), daemon=True)]
+    if input_url is not None:
+        threads.append(threading.Thread(target=feed_stdin, args=(job_id, input_url, proc.stdin), daemon=True))
+    for thread in threads:
+        thread.start()
+    try:
+        with proc.stderr:
+            err = proc.stderr.read().decode(errors="replace")
+        proc.wait()
+    finally:
+        stop_preview()
+        with JOBS_LOCK:
+            JOBS[job_id]["proc"] = None
+    for thread in threads:
+        thread.join()
+    return subprocess.CompletedProcess(proc.args, proc.returncode, "", err)
+
+
+def stdout_upload_failed(job_id: str, proc: subprocess.CompletedProcess, stats: dict | None, result: dict) -> bool:
+    """Fail the job if iv2glb or the upload of its output failed; True if so."""
+    job = JOBS[job_id]
+    if proc.returncode != 0:
+        if job.get("pipelineError"):
+            proc.stderr = f"{job['pipelineError']}; {proc.stderr.strip()}"
+        converter_failed(job_id, proc, stats)
+        return True
+    if job.get("pipelineError") or "glbUrl" not in result:
+        OUTPUT_STORE.delete(job_id)
+        fail_job(job_id, job.get("pipelineError") or "upload did not complete")
+        return True
+    return False
+
+
+def converter_failed(job_id: str, proc: subprocess.CompletedProcess, stats: dict | None):
+    job = JOBS[job_id]
+    OUTPUT_STORE.delete(job_id)
+    message = IV2GLB_EXIT_MESSAGES.get(proc.returncode, f"iv2glb exited with code {proc.returncode}")
+    detail = proc.stderr.strip()
+    if stats and stats.get("aborted"):
+        job["warnings"].append(
+            f"Stopped during {stats['abortStage']} after {stats['triangleCount']} triangles "
+            f"({stats['peakRssKb'] // 1024} MiB peak)."
+        )
+    fail_job(job_id, f"{message}: {detail}" if detail else message)
+
+
+def complete_job(
+    job_id: str,
+    glb_url: str | None,
+    files: list | None = None,
+    manifest_url: str | None = None,
+    thumbnail_url: str | None = None,
+    metadata: dict | None = None,
+):
+    output = {
+        "glbUrl": glb_url,
+        "thumbnailUrl": thumbnail_url,
+        "metadata": metadata or {},
+    }
+    if files:
+        output["files"] = files
+    if manifest_url:
+        output["manifestUrl"] = manifest_url
+    update_job(
+        job_id,
+        status="completed",
+        stage="completed",
+        progress=100,
+        finishedAt=time.time(),
+        output=output,
+    )
+
+
+def run_job(job_id: str):
+    check_cancelled(job_id)
+    if JOBS[job_id].get("streaming"):
+        run_streaming_job(job_id)
+        return
+    job = update_job(job_id, stage="converting", progress=20, startedAt=time.time())
+    # Every output carries the scene metadata iv2glb gathers on the way;
+    # options.metadataOnly returns only that, without a GLB.
+    if metadata_only(job):
+        run_metadata_job(job_id, job)
+        return
+    # Zip inputs convert into one GLB with a node per model entry, or with
+    # options.zipOutput="separate" into one GLB per entry. options.layout="gltf"
+    # writes model.gltf + model.bin, each mesh one aligned range of the .bin
+    # for HTTP Range requests. A single GLB goes from iv2glb's stdout straight
+    # to the output store. options.splitAssemblies=N writes one GLB per node N
+    # levels below the root plus manifest.json, for viewers that load
+    # assemblies on demand. options.proxyBoxes takes precedence over both.
+    assemblies = 0
+    if job["inputKind"] not in ("zip", "mesh") and proxy_depth(job) is None:
+        assemblies = int(job["options"].get("splitAssemblies") or 0)
+    split = assemblies > 0 or (job["inputKind"] == "zip" and job["options"].get("zipOutput") == "separate")
+    gltf = not split and job["options"].get("layout") == "gltf"
+    out_dir = os.path.join(job["workDir"], "outputs")
+    stats_path = os.path.join(job["workDir"], "stats.json")
+    args = [
+        IV2GLB_BIN,
+        "--stats",
+        stats_path,
+        *job_budget_args(job["options"]),
+        *layout_args(job["options"]),
+    ]
+    if assemblies:
+        args += ["--split-assemblies", str(assemblies), *preview_args(job), *thumbnail_args(job)]
+    else:
+        args += output_args(job_id, job)
+    if split and not assemblies:
+        args.append("--split-files")
+
+    files = None
+    manifest_url = None
+    result = {}
+    try:
+        if split:
+            proc = run_converter(job_id, [*args, job["inputPath"], out_dir])
+        elif gltf:
+            os.makedirs(out_dir, exist_ok=True)
+            proc = run_converter(job_id, [*args, job["inputPath"], os.path.join(out_dir, "model.gltf")])
+        else:
+            proc = run_converter_to_store(job_id, [*args, job["inputPath"]], result)
+            check_cancelled(job_id)
+        stats = read_stats(stats_path)
+        if not split and not gltf:
+            if stdout_upload_failed(job_id, proc, stats, result):
+                return
+            glb_url = result["glbUrl"]
+        elif proc.returncode != 0:
+            converter_failed(job_id, proc, stats)
+            return
+        elif gltf:
+            update_job(job_id, stage="uploading", progress=90)
+            # The .bin first, so the .gltf never points at a missing buffer.
+            bin_url = OUTPUT_STORE.put_file(
+                job_id, "model.bin", os.path.join(out_dir, "model.bin"), "application/octet-stream"
+            )
+            glb_url = OUTPUT_STORE.put_file(
+                job_id, "model.gltf", os.path.join(out_dir, "model.gltf"), "model/gltf+json"
+            )
+            files = [{"name": "model.gltf", "url": glb_url}, {"name": "model.bin", "url": bin_url}]
+        else:
+            update_job(job_id, stage="uploading", progress=90)
+            files = [
+                {
+                    "name": out["name"],
+                    "entry": out["entry"],
+                    "triangleCount": out["triangleCount"],
+                    "url": OUTPUT_STORE.put_file(
+                        job_id, out["name"], os.path.join(out_dir, out["name"]), "model/gltf-binary"
+                    ),
+                }
+                for out in stats["outputs"]
+            ]
+            glb_url = files[0]["url"]
+            if assemblies:
+                # Last, so every GLB it lists is already in place.
+                manifest_url = OUTPUT_STORE.put_file(
+                    job_id, "manifest.json", os.path.join(out_dir, "manifest.json"), "application/json"
+                )
+        thumbnail_url = upload_thumbnail(job_id, job)
+    finally:
+        shutil.rmtree(job["workDir"], ignore_errors=True)
+
+    if stats:
+        job["warnings"].extend(stats.get("warnings", []))
+        if stats.get("cache") == "stored":
+            prune_cache_dir(PARSE_CACHE_DIR, PARSE_CACHE_MAX_MB)
+        if MESH_STORE_DIR and stats.get("saveMeshMs"):
+            prune_cache_dir(MESH_STORE_DIR, MESH_STORE_MAX_MB)
+        # Cache hits and stored meshes skip the parse the predictor is modelling;
+        # box proxies skip the triangulation and mesh writing.
+        if stats.get("cache") != "hit" and job["inputKind"] != "mesh" and proxy_depth(job) is None:
+            PREDICTOR.record(
+                job["features"],
+                job["inputKind"],
+                native_seconds(stats),
+                stats.get("peakRssKb", 0) / 1024.0,
+                job["prediction"],
+            )
+    complete_job(job_id, glb_url, files, manifest_url, thumbnail_url, stats and stats.get("metadata"))
+
+
+def run_metadata_job(job_id: str, job: dict):
+    """options.metadataOnly: iv2glb parses and walks the scene without
+    generating triangles; the output has the metadata and no GLB."""
+    stats_path = os.path.join(job["workDir"], "stats.json")
+    try:
+        proc = run_converter(
+            job_id,
+            [
+                IV2GLB_BIN,
+                "--stats",
+                stats_path,
+                *job_budget_args(job["options"]),
+                "--metadata-only",
+                job["inputPath"],
+            ],
+        )
+        stats = read_stats(stats_path)
+    finally:
+        shutil.rmtree(job["workDir"], ignore_errors=True)
+    if proc.returncode != 0:
+        converter_failed(job_id, proc, stats)
+        return
+    try:
+        metadata = json.loads(proc.stdout)
+    except ValueError:
+        fail_job(job_id, "iv2glb printed no metadata")
+        return
+    if stats:
+        job["warnings"].extend(stats.get("warnings", []))
+    complete_job(job_id, None, metadata=metadata)
+
+
+def run_streaming_job(job_id: str):
+    """Download, conversion and upload overlapped through iv2glb's stdin and stdout.
+
+    The converter is not recorded in the predictor history: its wall time
+    here includes the network transfers.
+    """
+    job = update_job(job_id, stage="converting", progress=20, startedAt=time.time())
+    work_dir = job["workDir"]
+    stats_path = os.path.join(work_dir, "stats.json")
+
+    result = {}
+    try:
+        done = run_converter_to_store(
+            job_id,
+            [
+                IV2GLB_BIN,
+                "--stats",
+                stats_path,
+                *job_budget_args(job["options"]),
+                *layout_args(job["options"]),
+                *output_args(job_id, job),
+            ],
+            result,
+            input_url=job["input"]["url"],
+        )
+        check_cancelled(job_id)
+        stats = read_stats(stats_path)
+        if stdout_upload_failed(job_id, done, stats, result):
+            return
+        thumbnail_url = upload_thumbnail(job_id, job)
+    finally:
+        shutil.rmtree(work_dir, ignore_errors=True)
+
+    if stats:
+        job["warnings"].extend(stats.get("warnings", []))
+        if MESH_STORE_DIR and stats.get("saveMeshMs"):
+            prune_cache_dir(MESH_STORE_DIR, MESH_STORE_MAX_MB)
+    complete_job(
+        job_id, result["glbUrl"], thumbnail_url=thumbnail_url, metadata=stats and stats.get("metadata")
+    )
+
+
+def cancel_job(job_id: str) -> bool:
+    """Cancel a job in any stage and release what it holds. False if already finished."""
+    with JOBS_LOCK:
+        job = JOBS[job_id]
+        if job["status"] != "running":
+            return False
+        job["cancelEvent"].set()
+        job.update(status="cancelled", stage="cancelled", finishedAt=time.time())
+        proc = job.get("proc")
+    SCHEDULER.remove(job_id)
+    if proc is not None:
+        proc.send_signal(signal.SIGTERM)  # iv2glb stops at its next budget check
+        try:
+            proc.wait(timeout=CANCEL_GRACE_SEC)
+        except subprocess.TimeoutExpired:
+            proc.kill()
+    if job.get("workDir"):
+        shutil.rmtree(job["workDir"], ignore_errors=True)
+    OUTPUT_STORE.delete(job_id)
+    return True
+
+
+for cache_dir in (PARSE_CACHE_DIR, MESH_STORE_DIR):
+    if cache_dir:
+        os.makedirs(cache_dir, exist_ok=True)
+OUTPUT_STORE = HttpOutputStore(OUTPUT_PUT_URL, OUTPUT_PUBLIC_URL) if OUTPUT_PUT_URL else LocalOutputStore()
+PREDICTOR = CostPredictor(COST_HISTORY_PATH)
+SCHEDULER = Scheduler(MAX_CONCURRENT_JOBS)
+
+
 @app.get("/health")
 def health():
     return {"ok": True}
@@ -35,17 +1392,26 @@ def health():
 def start_job(req: StartJobRequest, authorization: str | None = Header(default=None)):
     require_auth(authorization)
 
+    options = req.options or {}
     worker_job_id = str(uuid.uuid4())
     now = time.time()
-    JOBS[worker_job_id] = {
-        "status": "running",
-        "stage": "validating",
-        "progress": 5,
-        "createdAt": now,
-        "appJobId": req.jobId,
-        "warnings": [],
-        "output": None,
-    }
+    with JOBS_LOCK:
+        JOBS[worker_job_id] = {
+            "status": "running",
+            "stage": "validating",
+            "progress": 5,
+            "createdAt": now,
+            "appJobId": req.jobId,
+            "tenant": str(options.get("tenantId") or req.jobId),
+            "input": req.input,
+            "options": options,
+            "warnings": [],
+            "error": None,
+            "output": None,
+            "cancelEvent": threading.Event(),
+            "proc": None,
+        }
+    threading.Thread(target=intake_job, args=(worker_job_id,), daemon=True).start()
     return {"workerJobId": worker_job_id, "jobId": req.jobId}
 
 
@@ -57,27 +1423,65 @@ def get_job(workerJobId: str, authorization: str | None = Header(default=None)):
     if not job:
         raise HTTPException(status_code=404, detail="Job not found")
 
-    # Demo progress simulation:
-    age = time.time() - job["createdAt"]
-    if job["status"] == "running":
-        if age > 2:
-            job["stage"] = "exporting"
-            job["progress"] = 80
-        if age > 4:
-            job["status"] = "completed"
-            job["stage"] = "completed"
-            job["progress"] = 100
-            job["warnings"].append("Demo worker: conversion is stubbed; no real GLB generated yet.")
-            job["output"] = {
-                "glbUrl": None,
-                "thumbnailUrl": None,
-                "metadata": {},
-            }
-
-    return {
+    resp = {
         "status": job["status"],
         "stage": job["stage"],
         "progress": job["progress"],
         "warnings": job["warnings"],
+        "error": job["error"],
         "output": job["output"],
     }
+    if job.get("prediction"):
+        resp["prediction"] = job["prediction"]
+    # A failed or cancelled job's files, the preview included, are deleted.
+    if job.get("previewUrl") and job["status"] not in ("failed", "cancelled"):
+        resp["previewUrl"] = job["previewUrl"]
+    if job["stage"] == "queued":
+        resp["queuePosition"] = SCHEDULER.queue_position(workerJobId)
+    return resp
+
+
+@app.get("/v1/predictor")
+def get_predictor(authorization: str | None = Header(default=None)):
+    require_auth(authorization)
+    return PREDICTOR.report()
+
+
+@app.delete("/v1/jobs/{workerJobId}")
+def delete_job(workerJobId: str, authorization: str | None = Header(default=None)):
+    require_auth(authorization)
+
+    if workerJobId not in JOBS:
+        raise HTTPException(status_code=404, detail="Job not found")
+    if not cancel_job(workerJobId):
+        raise HTTPException(status_code=409, detail=f"Job already {JOBS[workerJobId]['status']}")
+    return {"workerJobId": workerJobId, "status": "cancelled"}
+
+
+OUTPUT_MEDIA_TYPES = {
+    ".glb": "model/gltf-binary",
+    ".gltf": "model/gltf+json",
+    ".bin": "application/octet-stream",
+    ".json": "application/json",
+    ".png": "image/png",
+}
+
+
+@app.get("/v1/jobs/{workerJobId}/files/{name}")
+def get_job_file(workerJobId: str, name: str, authorization: str | None = Header(default=None)):
+    require_auth(authorization)
+
+    # Running jobs serve what the store has already put (the preview);
+    # files still being written carry PART_SUFFIX until they are complete.
+    job = JOBS.get(workerJobId)
+    if (
+        not job
+        or job["status"] not in ("running", "completed")
+        or os.path.basename(name) != name
+        or name.endswith(PART_SUFFIX)
+    ):
+        raise HTTPException(status_code=404, detail="File not found")
+    path = os.path.join(OUTPUT_DIR, workerJobId, name)
+    if not os.path.isfile(path):
+        raise HTTPException(status_code=404, detail="File not found")
+    return FileResponse(path, media_type=OUTPUT_MEDIA_TYPES.get(os.path.splitext(name)[1]))
@@ -0,0 +1,543 @@
+// Read-ahead and write-behind for large sequential file I/O.
+//
+// The parser and the GLB serializer otherwise stop on every read()/write().
+// Here kAsyncBlocks buffers of kAsyncBlockBytes are kept in flight (double
+// buffering), so the kernel fills or drains one block while the caller works
+// on the other. Requests go through io_uring on regular files when the
+// kernel allows it (raw syscalls, no liburing; container seccomp profiles
+// often refuse io_uring_setup), and otherwise through one helper thread
+// doing plain read/write, which also serves FIFOs and pipes.
+//
+// Build with -DIV2GLB_HAVE_IO_URING=0 to leave io_uring out entirely.
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "input_stream.h"
+#include "partial_files.h"
+
+#ifndef IV2GLB_HAVE_IO_URING
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define IV2GLB_HAVE_IO_URING 1
+#else
+#define IV2GLB_HAVE_IO_URING 0
+#endif
+#endif
+
+#if IV2GLB_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+static constexpr size_t kAsyncBlocks = 2;
+static constexpr size_t kAsyncBlockBytes = 4 << 20;
+
+// --io: io_uring where possible (else the thread), the thread only, or no
+// asynchronous I/O at all (SoInput reads the file itself; output is written
+// with plain blocking writes). Sync is the default until the overlap is
+// measured to pay off on the storage at hand.
+enum class IoMode { kUring, kThread, kSync };
+static IoMode g_ioMode = IoMode::kSync;
+
+namespace asyncio {
+
+struct Request {
+  bool write = false;
+  char *buf = nullptr;
+  size_t len = 0;
+  int64_t offset = -1;  // -1: at the descriptor's position (pipes)
+  size_t tag = 0;
+  size_t done = 0;      // bytes transferred so far
+};
+
+// Completes a request synchronously: the whole length, or up to EOF for a
+// positional read; a read from a pipe returns what one read() gave, so data
+// is passed on as it arrives. Returns bytes transferred or -errno.
+inline ssize_t transfer(int fd, Request &r) {
+  while (r.done < r.len) {
+    char *p = r.buf + r.done;
+    const size_t n = r.len - r.done;
+    ssize_t got;
+    if (r.offset >= 0) {
+      const off_t at = static_cast<off_t>(r.offset + r.done);
+      got = r.write ? ::pwrite(fd, p, n, at) : ::pread(fd, p, n, at);
+    } else {
+      got = r.write ? ::write(fd, p, n) : ::read(fd, p, n);
+    }
+    if (got < 0) {
+      if (errno == EINTR) continue;
+      return -errno;
+    }
+    if (got == 0) break;  // EOF (reads only)
+    r.done += static_cast<size_t>(got);
+    if (!r.write && r.offset < 0) break;
+  }
+  return static_cast<ssize_t>(r.done);
+}
+
+#if IV2GLB_HAVE_IO_URING
+// One submission/completion ring pair, driven with io_uring_enter.
+class Ring {
+public:
+  ~Ring() {
+    if (sqes_) ::munmap(sqes_, sqesBytes_);
+    if (cqMap_ && cqMap_ != sqMap_) ::munmap(cqMap_, cqBytes_);
+    if (sqMap_) ::munmap(sqMap_, sqBytes_);
+    if (fd_ >= 0) ::close(fd_);
+  }
+
+  bool init(unsigned entries) {
+    io_uring_params p;
+    std::memset(&p, 0, sizeof(p));
+    fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p));
+    if (fd_ < 0) return false;
+    sqBytes_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqBytes_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    const bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) sqBytes_ = cqBytes_ = std::max(sqBytes_, cqBytes_);
+    sqMap_ = map(sqBytes_, IORING_OFF_SQ_RING);
+    cqMap_ = single ? sqMap_ : map(cqBytes_, IORING_OFF_CQ_RING);
+    sqesBytes_ = p.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe *>(map(sqesBytes_, IORING_OFF_SQES));
+    if (!sqMap_ || !cqMap_ || !sqes_) return false;
+    char *sq = static_cast<char *>(sqMap_);
+    char *cq = static_cast<char *>(cqMap_);
+    sqTail_ = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+    cqHead_ = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+    return true;
+  }
+
+  // Queues readv/writev of `iov` and submits it; `id` comes back in wait().
+  bool submit(bool write, int fd, const iovec *iov, uint64_t offset, uint64_t id) {
+    const unsigned tail = *sqTail_;
+    const unsigned index = tail & sqMask_;
+    io_uring_sqe &sqe = sqes_[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uint64_t>(iov);
+    sqe.len = 1;
+    sqe.off = offset;
+    sqe.user_data = id;
+    sqArray_[index] = index;
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+    for (;;) {
+      const long n = ::syscall(__NR_io_uring_enter, fd_, 1, 0, 0, nullptr, 0);
+      if (n >= 0) return n == 1;
+      if (errno != EINTR) return false;
+    }
+  }
+
+  // Blocks for the next completion.
+  bool wait(uint64_t &id, int32_t &res) {
+    for (;;) {
+      const unsigned head = *cqHead_;
+      if (head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+        const io_uring_cqe &cqe = cqes_[head & cqMask_];
+        id = cqe.user_data;
+        res = cqe.res;
+        __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+        return true;
+      }
+      if (::syscall(__NR_io_uring_enter, fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 &&
+          errno != EINTR) {
+        return false;
+      }
+    }
+  }
+
+private:
+  void *map(size_t bytes, off_t what) {
+    void *p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, what);
+    return p == MAP_FAILED ? nullptr : p;
+  }
+
+  int fd_ = -1;
+  void *sqMap_ = nullptr, *cqMap_ = nullptr;
+  size_t sqBytes_ = 0, cqBytes_ = 0, sqesBytes_ = 0;
+  io_uring_sqe *sqes_ = nullptr;
+  unsigned *sqTail_ = nullptr, *sqArray_ = nullptr, *cqHead_ = nullptr, *cqTail_ = nullptr;
+  unsigned sqMask_ = 0, cqMask_ = 0;
+  io_uring_cqe *cqes_ = nullptr;
+};
+#endif
+
+// Asynchronous requests against one descriptor, completed like transfer().
+// io_uring may complete them in any order; the thread runs them in order,
+// which is what keeps pipe data sequential.
+class Queue {
+public:
+  // `positional`: requests carry offsets (regular files), which io_uring
+  // needs; otherwise the helper thread is used.
+  Queue(int fd, bool positional) : fd_(fd) {
+#if IV2GLB_HAVE_IO_URING
+    if (positional && g_ioMode == IoMode::kUring && ring_.init(kAsyncBlocks)) {
+      uring_ = true;
+      return;
+    }
+#endif
+    (void)positional;
+    worker_ = std::thread([this] { work(); });
+  }
+  ~Queue() {
+    if (worker_.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+      }
+      cv_.notify_all();
+      worker_.join();
+    }
+  }
+
+  const char *backend() const { return uring_ ? "io_uring" : "thread"; }
+
+  bool submit(const Request &r) {
+#if IV2GLB_HAVE_IO_URING
+    if (uring_) {
+      Slot &s = slots_[r.tag];
+      s.req = r;
+      return submitSlot(s);
+    }
+#endif
+    std::lock_guard<std::mutex> lock(mu_);
+    pending_.push_back(r);
+    cv_.notify_all();
+    return true;
+  }
+
+  // Next completion: its tag and bytes transferred, or -errno.
+  bool wait(size_t &tag, ssize_t &res) {
+#if IV2GLB_HAVE_IO_URING
+    if (uring_) {
+      for (;;) {
+        uint64_t id;
+        int32_t got;
+        if (!ring_.wait(id, got)) return false;
+        Slot &s = slots_[id];
+        if (got > 0) s.req.done += static_cast<size_t>(got);
+        // Short transfer not at EOF: continue where it stopped.
+        if (got > 0 && s.req.done < s.req.len) {
+          if (!submitSlot(s)) return false;
+          continue;
+        }
+        tag = s.req.tag;
+        res = got < 0 ? got : static_cast<ssize_t>(s.req.done);
+        return true;
+      }
+    }
+#endif
+    std::unique_lock<std::mutex> lock(mu_);
+    cv_.wait(lock, [this] { return !completed_.empty(); });
+    tag = completed_.front().first;
+    res = completed_.front().second;
+    completed_.pop_front();
+    return true;
+  }
+
+private:
+#if IV2GLB_HAVE_IO_URING
+  struct Slot {
+    Request req;
+    iovec iov;
+  };
+  bool submitSlot(Slot &s) {
+    s.iov.iov_base = s.req.buf + s.req.done;
+    s.iov.iov_len = s.req.len - s.req.done;
+    return ring_.submit(s.req.write, fd_, &s.iov, static_cast<uint64_t>(s.req.offset) + s.req.done,
+                        s.req.tag);
+  }
+  Ring ring_;
+  Slot slots_[kAsyncBlocks];
+#endif
+
+  void work() {
+    for (;;) {
+      Request r;
+      {
+        std::unique_lock<std::mutex> lock(mu_);
+        cv_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+        if (pending_.empty()) return;
+        r = pending_.front();
+        pending_.pop_front();
+      }
+      const ssize_t res = transfer(fd_, r);
+      std::lock_guard<std::mutex> lock(mu_);
+      completed_.emplace_back(r.tag, res);
+      cv_.notify_all();
+    }
+  }
+
+  int fd_;
+  bool uring_ = false;
+  std::thread worker_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<Request> pending_;
+  std::deque<std::pair<size_t, ssize_t>> completed_;
+  bool stop_ = false;
+};
+
+inline bool isRegularFd(int fd) {
+  struct stat st;
+  return ::fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+}  // namespace asyncio
+
+// Sequential reader (owns `fd`) that keeps the next blocks being read while
+// the caller consumes the current one. Meant for regular files: on a pipe
+// the destructor would wait for reads still outstanding.
+class ReadAheadSource : public ByteSource {
+public:
+  explicit ReadAheadSource(int fd)
+      : fd_(fd), positional_(asyncio::isRegularFd(fd)), queue_(fd, positional_) {
+    for (size_t i = 0; i < kAsyncBlocks; ++i) {
+      blocks_[i].data.resize(kAsyncBlockBytes);
+      issue(i);
+    }
+  }
+  ~ReadAheadSource() override {
+    size_t tag;
+    ssize_t res;
+    while (inFlight_ && queue_.wait(tag, res)) --inFlight_;  // buffers must outlive the I/O
+    ::close(fd_);
+  }
+
+  const char *backend() const { return queue_.backend(); }
+
+  // Copies up to `size` bytes from the front without consuming them (at most
+  // one block, which is plenty to sniff a format).
+  size_t peek(char *buf, size_t size) {
+    Block *b = current();
+    if (!b) return 0;
+    const size_t n = std::min(size, b->len - b->pos);
+    std::memcpy(buf, b->data.data() + b->pos, n);
+    return n;
+  }
+
+  ssize_t read(char *buf, size_t size) override {
+    Block *b = current();
+    if (!b) {
+      if (error_) {
+        errno = error_;
+        return -1;
+      }
+      return 0;
+    }
+    const size_t n = std::min(size, b->len - b->pos);
+    std::memcpy(buf, b->data.data() + b->pos, n);
+    b->pos += n;
+    if (b->pos == b->len) {
+      // A short block from a file is its end; otherwise refill the block.
+      b->issued = false;
+      if (b->len < kAsyncBlockBytes && positional_) eof_ = true;
+      else issue(cur_);
+      cur_ = (cur_ + 1) % kAsyncBlocks;
+    }
+    return static_cast<ssize_t>(n);
+  }
+
+private:
+  struct Block {
+    std::vector<char> data;
+    size_t len = 0, pos = 0;
+    bool ready = false, issued = false;
+  };
+
+  void issue(size_t i) {
+    Block &b = blocks_[i];
+    if (b.issued || eof_ || error_) return;
+    asyncio::Request r;
+    r.buf = b.data.data();
+    r.len = b.data.size();
+    r.offset = positional_ ? static_cast<int64_t>(nextOffset_) : -1;
+    r.tag = i;
+    nextOffset_ += b.data.size();
+    b.ready = false;
+    b.issued = true;
+    b.len = b.pos = 0;
+    if (queue_.submit(r)) ++inFlight_;
+    else error_ = EIO;
+  }
+
+  // The block being consumed, waiting for it if needed; nullptr at EOF or
+  // after an error.
+  Block *current() {
+    Block &b = blocks_[cur_];
+    while (b.issued && !b.ready && !error_) {
+      size_t tag;
+      ssize_t res;
+      if (!queue_.wait(tag, res)) {
+        error_ = EIO;
+        break;
+      }
+      --inFlight_;
+      Block &done = blocks_[tag];
+      done.ready = true;
+      if (res < 0) error_ = static_cast<int>(-res);
+      else done.len = static_cast<size_t>(res);
+    }
+    if (error_ || !b.ready || b.len == 0 || b.pos == b.len) {
+      if (b.ready && b.len == 0) eof_ = true;
+      return nullptr;
+    }
+    return &b;
+  }
+
+  int fd_;
+  bool positional_;
+  asyncio::Queue queue_;
+  Block blocks_[kAsyncBlocks];
+  size_t cur_ = 0;
+  uint64_t nextOffset_ = 0;
+  size_t inFlight_ = 0;
+  bool eof_ = false;
+  int error_ = 0;
+};
+
+// Output file written behind the caller: write() copies into the current
+// block and hands full blocks to the kernel while the next one fills.
+class WriteBehindFile {
+public:
+  WriteBehindFile() = default;
+  WriteBehindFile(const WriteBehindFile &) = delete;
+  WriteBehindFile &operator=(const WriteBehindFile &) = delete;
+  ~WriteBehindFile() {
+    if (fd_ >= 0) close();
+  }
+
+  // Creates or truncates `path` (a FIFO is opened for writing as is); "-"
+  // writes to a duplicate of stdout, at its current position. With --io
+  // sync blocks are written inline as they fill.
+  bool open(const std::string &path) {
+    const bool toStdout = path == "-";
+    fd_ = toStdout ? ::fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0)
+                   : ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+      error_ = errno;
+      return false;
+    }
+    positional_ = !toStdout && asyncio::isRegularFd(fd_);
+    if (positional_) partial_.reset(new PartialFile(path));
+    if (g_ioMode != IoMode::kSync) queue_.reset(new asyncio::Queue(fd_, positional_));
+    backend_ = queue_ ? queue_->backend() : "sync";
+    for (size_t i = 0; i < (queue_ ? kAsyncBlocks : 1); ++i) blocks_[i].data.resize(kAsyncBlockBytes);
+    return true;
+  }
+
+  const char *backend() const { return backend_; }
+  int error() const { return error_; }
+  // Records an error found by the caller; later writes are dropped.
+  void fail(int err) {
+    if (!error_) error_ = err;
+  }
+
+  bool write(const void *data, size_t size) {
+    const char *p = static_cast<const char *>(data);
+    while (size && !error_) {
+      Block &b = blocks_[cur_];
+      const size_t n = std::min(size, b.data.size() - b.fill);
+      std::memcpy(b.data.data() + b.fill, p, n);
+      b.fill += n;
+      p += n;
+      size -= n;
+      if (b.fill == b.data.size()) flushBlock();
+    }
+    return !error_;
+  }
+
+  // Writes what is buffered, waits for the kernel and closes. False if any
+  // write failed (see error()).
+  bool close() {
+    if (fd_ < 0) return false;
+    if (!error_ && blocks_[cur_].fill) flushBlock();
+    while (inFlight_) reap();
+    queue_.reset();
+    if (::close(fd_) != 0 && !error_) error_ = errno;
+    fd_ = -1;
+    partial_.reset();
+    return !error_;
+  }
+
+private:
+  struct Block {
+    std::vector<char> data;
+    size_t fill = 0;
+    bool busy = false;
+  };
+
+  // Hands the current block to the queue and moves to the next free one.
+  void flushBlock() {
+    Block &b = blocks_[cur_];
+    asyncio::Request r;
+    r.write = true;
+    r.buf = b.data.data();
+    r.len = b.fill;
+    r.offset = positional_ ? static_cast<int64_t>(offset_) : -1;
+    r.tag = cur_;
+    offset_ += b.fill;
+    if (!queue_) {
+      const ssize_t res = asyncio::transfer(fd_, r);
+      if (res < 0) error_ = static_cast<int>(-res);
+      b.fill = 0;
+      return;
+    }
+    b.busy = true;
+    if (!queue_->submit(r)) {
+      error_ = EIO;
+      b.busy = false;
+      return;
+    }
+    ++inFlight_;
+    cur_ = (cur_ + 1) % kAsyncBlocks;
+    while (inFlight_ && blocks_[cur_].busy && !error_) reap();
+  }
+
+  void reap() {
+    size_t tag;
+    ssize_t res;
+    if (!queue_->wait(tag, res)) {
+      error_ = EIO;
+      inFlight_ = 0;
+      return;
+    }
+    --inFlight_;
+    Block &b = blocks_[tag];
+    if (res < 0) error_ = static_cast<int>(-res);
+    else if (static_cast<size_t>(res) != b.fill) error_ = EIO;
+    b.busy = false;
+    b.fill = 0;
+  }
+
+  int fd_ = -1;
+  bool positional_ = false;
+  std::unique_ptr<asyncio::Queue> queue_;
+  std::unique_ptr<PartialFile> partial_;  // regular files, until closed
+  const char *backend_ = "none";
+  Block blocks_[kAsyncBlocks];
+  size_t cur_ = 0;
+  uint64_t offset_ = 0;
+  size_t inFlight_ = 0;
+  int error_ = 0;
+};
@@ -0,0 +1,157 @@
+// Box geometry for --preview and --proxy-boxes: boxes as triangles in one
+// mesh, or as instances of a unit cube (EXT_mesh_gpu_instancing TRS).
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mesh_out.h"
+
+// Appends the box [lo, hi] as 8 vertices and 12 outward-wound triangles,
+// one part.
+static void appendBox(MeshOut &m, const float *lo, const float *hi) {
+  const uint32_t base = static_cast<uint32_t>(m.vertexCount());
+  for (int c = 0; c < 8; ++c) {
+    const float x = (c & 1) ? hi[0] : lo[0];
+    const float y = (c & 2) ? hi[1] : lo[1];
+    const float z = (c & 4) ? hi[2] : lo[2];
+    m.positions.push_back(x);
+    m.positions.push_back(y);
+    m.positions.push_back(z);
+    updateMinMax(m, x, y, z);
+  }
+  // Two triangles per face; corner bit k set = max on axis k.
+  static const uint8_t kFaces[12][3] = {
+      {0, 2, 1}, {1, 2, 3}, {4, 5, 6}, {5, 7, 6},   // -z, +z
+      {0, 1, 4}, {1, 5, 4}, {2, 6, 3}, {3, 6, 7},   // -y, +y
+      {0, 4, 2}, {2, 4, 6}, {1, 3, 5}, {3, 7, 5}};  // -x, +x
+  PartRange part;
+  part.firstIndex = static_cast<uint32_t>(m.indices.size());
+  part.indexCount = 36;
+  for (const auto &f : kFaces) {
+    for (const uint8_t c : f) m.indices.push_back(base + c);
+  }
+  for (int k = 0; k < 3; ++k) {
+    part.bmin[k] = lo[k];
+    part.bmax[k] = hi[k];
+  }
+  m.parts.push_back(part);
+}
+
+// One instance of the unit cube [-0.5, 0.5]^3, as glTF applies it:
+// scale, then rotation (quaternion x, y, z, w), then translation.
+struct BoxInstance {
+  float t[3];
+  float r[4];
+  float s[3];
+};
+
+// Instances of one mesh, as the TRANSLATION / ROTATION / SCALE accessors of
+// EXT_mesh_gpu_instancing, plus a name per instance for picking.
+struct InstanceSet {
+  std::vector<float> translation;  // xyz per instance
+  std::vector<float> rotation;     // xyzw
+  std::vector<float> scale;        // xyz
+  std::vector<std::string> names;
+
+  void add(const BoxInstance &b, const std::string &name) {
+    translation.insert(translation.end(), b.t, b.t + 3);
+    rotation.insert(rotation.end(), b.r, b.r + 4);
+    scale.insert(scale.end(), b.s, b.s + 3);
+    names.push_back(name);
+  }
+  size_t count() const { return names.size(); }
+};
+
+namespace proxy {
+
+// Quaternion of the rotation that maps p to p * R (row vectors, as SbMatrix).
+inline void quatFromRows(const float R[3][3], float *q) {
+  // Column-vector form m = R^T.
+  auto m = [&](int i, int j) { return R[j][i]; };
+  const float trace = m(0, 0) + m(1, 1) + m(2, 2);
+  if (trace > 0.0f) {
+    const float s = 0.5f / std::sqrt(trace + 1.0f);
+    q[3] = 0.25f / s;
+    q[0] = (m(2, 1) - m(1, 2)) * s;
+    q[1] = (m(0, 2) - m(2, 0)) * s;
+    q[2] = (m(1, 0) - m(0, 1)) * s;
+  } else if (m(0, 0) > m(1, 1) && m(0, 0) > m(2, 2)) {
+    const float s = 2.0f * std::sqrt(1.0f + m(0, 0) - m(1, 1) - m(2, 2));
+    q[3] = (m(2, 1) - m(1, 2)) / s;
+    q[0] = 0.25f * s;
+    q[1] = (m(0, 1) + m(1, 0)) / s;
+    q[2] = (m(0, 2) + m(2, 0)) / s;
+  } else if (m(1, 1) > m(2, 2)) {
+    const float s = 2.0f * std::sqrt(1.0f + m(1, 1) - m(0, 0) - m(2, 2));
+    q[3] = (m(0, 2) - m(2, 0)) / s;
+    q[0] = (m(0, 1) + m(1, 0)) / s;
+    q[1] = 0.25f * s;
+    q[2] = (m(1, 2) + m(2, 1)) / s;
+  } else {
+    const float s = 2.0f * std::sqrt(1.0f + m(2, 2) - m(0, 0) - m(1, 1));
+    q[3] = (m(1, 0) - m(0, 1)) / s;
+    q[0] = (m(0, 2) + m(2, 0)) / s;
+    q[1] = (m(1, 2) + m(2, 1)) / s;
+    q[2] = 0.25f * s;
+  }
+  const float n = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+  for (int k = 0; k < 4; ++k) q[k] /= n;
+}
+
+}  // namespace proxy
+
+// The instance for box [lo, hi] given in a frame whose row-vector matrix
+// (frame -> world; `frame[i]` is row i, translation in row 3) is `frame`.
+// The box stays oriented when the frame's axes are orthogonal (any scale per
+// axis, mirroring included); under shear it falls back to the world-aligned
+// box around it. Zero extents are kept: a flat part gives a flat box.
+template <typename Matrix>
+static BoxInstance boxInstance(const Matrix &frame, const float *lo, const float *hi) {
+  BoxInstance b;
+  float c[3], size[3];
+  for (int k = 0; k < 3; ++k) {
+    c[k] = 0.5f * (lo[k] + hi[k]);
+    size[k] = hi[k] - lo[k];
+  }
+  for (int j = 0; j < 3; ++j) {
+    b.t[j] = c[0] * frame[0][j] + c[1] * frame[1][j] + c[2] * frame[2][j] + frame[3][j];
+  }
+
+  float R[3][3], len[3];
+  bool oriented = true;
+  for (int i = 0; i < 3; ++i) {
+    len[i] = std::sqrt(frame[i][0] * frame[i][0] + frame[i][1] * frame[i][1] + frame[i][2] * frame[i][2]);
+    if (!(len[i] > 0.0f)) oriented = false;
+    for (int j = 0; j < 3 && oriented; ++j) R[i][j] = frame[i][j] / len[i];
+  }
+  for (int i = 0; i < 3 && oriented; ++i) {
+    for (int j = i + 1; j < 3; ++j) {
+      if (std::fabs(R[i][0] * R[j][0] + R[i][1] * R[j][1] + R[i][2] * R[j][2]) > 1e-4f) oriented = false;
+    }
+  }
+  if (oriented) {
+    const float det = R[0][0] * (R[1][1] * R[2][2] - R[1][2] * R[2][1]) -
+                      R[0][1] * (R[1][0] * R[2][2] - R[1][2] * R[2][0]) +
+                      R[0][2] * (R[1][0] * R[2][1] - R[1][1] * R[2][0]);
+    if (det < 0.0f) {
+      // A mirror: a proper rotation with the x scale negated.
+      for (int j = 0; j < 3; ++j) R[0][j] = -R[0][j];
+      len[0] = -len[0];
+    }
+    proxy::quatFromRows(R, b.r);
+    for (int k = 0; k < 3; ++k) b.s[k] = size[k] * len[k];
+    return b;
+  }
+
+  // World-aligned extent of the transformed box.
+  for (int j = 0; j < 3; ++j) {
+    b.s[j] = std::fabs(frame[0][j]) * size[0] + std::fabs(frame[1][j]) * size[1] +
+             std::fabs(frame[2][j]) * size[2];
+  }
+  b.r[0] = b.r[1] = b.r[2] = 0.0f;
+  b.r[3] = 1.0f;
+  return b;
+}
@@ -0,0 +1,303 @@
+// Budget-driven simplification for --degrade: drop small parts, weld and
+// vertex-cluster the collected geometry until it fits a triangle budget.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "mesh_out.h"
+
+static inline float boundsDiagonal(const float *bmin, const float *bmax) {
+  const float dx = bmax[0] - bmin[0], dy = bmax[1] - bmin[1], dz = bmax[2] - bmin[2];
+  return (dx >= 0.0f) ? std::sqrt(dx * dx + dy * dy + dz * dz) : 0.0f;
+}
+
+namespace decimate {
+
+constexpr uint32_t kUnmapped = 0xFFFFFFFFu;
+constexpr int64_t kAxisCells = (int64_t(1) << 21) - 1;
+
+inline uint64_t cellKey(const float *p, const float *origin, float inv) {
+  auto axis = [&](int k) -> uint64_t {
+    int64_t c = static_cast<int64_t>(std::floor((p[k] - origin[k]) * inv));
+    return static_cast<uint64_t>(std::min<int64_t>(std::max<int64_t>(c, 0), kAxisCells));
+  };
+  return axis(0) | (axis(1) << 21) | (axis(2) << 42);
+}
+
+// A grid cell, split by vertex colour, texture and uv where those must
+// stay apart.
+struct CellColor {
+  uint64_t cell;
+  uint32_t color;
+  int32_t texture;
+  uint64_t uv;
+  bool operator==(const CellColor &o) const {
+    return cell == o.cell && color == o.color && texture == o.texture && uv == o.uv;
+  }
+};
+
+struct CellColorHash {
+  size_t operator()(const CellColor &k) const {
+    return std::hash<uint64_t>()(k.cell ^ (uint64_t(k.color) * 0x9E3779B97F4A7C15ull) ^
+                                 (k.uv * 0xC2B2AE3D27D4EB4Full) ^ (uint64_t(uint32_t(k.texture)) << 29));
+  }
+};
+
+// A triangle's output vertices, rotated to start at the smallest index (the
+// winding kept), so the same triangle emitted twice compares equal.
+struct Triangle {
+  uint32_t a, b, c;
+  bool operator==(const Triangle &o) const { return a == o.a && b == o.b && c == o.c; }
+};
+
+struct TriangleHash {
+  size_t operator()(const Triangle &t) const {
+    return std::hash<uint64_t>()((uint64_t(t.a) << 32 | t.b) ^ (uint64_t(t.c) * 0x9E3779B97F4A7C15ull));
+  }
+};
+
+inline Triangle rotated(uint32_t a, uint32_t b, uint32_t c) {
+  if (b < a && b < c) return {b, c, a};
+  if (c < a && c < b) return {c, a, b};
+  return {a, b, c};
+}
+
+inline uint64_t uvBits(const float *uv) {
+  uint64_t bits;
+  std::memcpy(&bits, uv, 8);
+  return bits;
+}
+
+// Texture coordinates merge within uv squares that are the same fraction of
+// the mesh's uv extent as `cell` is of its diagonal, so neighbours average
+// while vertices on either side of a seam stay apart. Returns 1 / the square
+// side, or 0 without texture coordinates.
+inline float uvCellInverse(const MeshOut &m, float cell) {
+  if (m.texcoords.empty()) return 0.0f;
+  float lo[2] = {m.texcoords[0], m.texcoords[1]}, hi[2] = {lo[0], lo[1]};
+  for (size_t i = 0; i < m.texcoords.size(); ++i) {
+    lo[i & 1] = std::min(lo[i & 1], m.texcoords[i]);
+    hi[i & 1] = std::max(hi[i & 1], m.texcoords[i]);
+  }
+  const float extent = std::max(std::max(hi[0] - lo[0], hi[1] - lo[1]), 1e-6f);
+  const float diag = boundsDiagonal(m.posMin, m.posMax);
+  return diag > 0.0f ? diag / (extent * cell) : 0.0f;
+}
+
+inline uint64_t uvCell(const float *uv, float uvInv) {
+  auto axis = [&](float t) {
+    const double c = std::floor(double(t) * uvInv);
+    return uint64_t(uint32_t(static_cast<int32_t>(std::min(std::max(c, -2147483648.0), 2147483647.0))));
+  };
+  return axis(uv[0]) | axis(uv[1]) << 32;
+}
+
+// The texture of each vertex (its part's material's), or an empty vector if
+// the mesh has no texture coordinates.
+inline std::vector<int32_t> vertexTextures(const MeshOut &m) {
+  std::vector<int32_t> texture;
+  if (m.texcoords.empty()) return texture;
+  texture.assign(m.vertexCount(), -1);
+  if (m.materials.empty()) return texture;
+  for (const PartRange &p : m.parts) {
+    const int32_t t = m.materials[p.material].texture;
+    for (uint32_t i = p.firstIndex; i < p.firstIndex + p.indexCount; ++i) texture[m.indices[i]] = t;
+  }
+  return texture;
+}
+
+// Which cell vertex `idx` clusters into. Textured vertices only merge with
+// vertices of the same texture in the same uv square (uvCellInverse); with
+// `exact`, only with the same colour and uv.
+inline CellColor vertexKey(const MeshOut &m, uint32_t idx, float inv, float uvInv,
+                           const std::vector<int32_t> &textures, bool exact) {
+  const bool textured = !textures.empty();
+  const float *uv = textured ? &m.texcoords[size_t(idx) * 2] : nullptr;
+  return {cellKey(&m.positions[size_t(idx) * 3], m.posMin, inv),
+          exact && !m.colors.empty() ? m.colors[idx] : 0u, textured ? textures[idx] : -1,
+          !textured ? 0u : exact ? uvBits(uv) : uvCell(uv, uvInv)};
+}
+
+// Number of triangles that survive clustering at `cell` (no mesh changes).
+inline size_t countSurvivors(const MeshOut &m, float cell, const std::vector<int32_t> &textures) {
+  const float inv = 1.0f / cell, uvInv = uvCellInverse(m, cell);
+  size_t n = 0;
+  for (size_t t = 0; t + 2 < m.indices.size(); t += 3) {
+    const CellColor a = vertexKey(m, m.indices[t], inv, uvInv, textures, false);
+    const CellColor b = vertexKey(m, m.indices[t + 1], inv, uvInv, textures, false);
+    const CellColor c = vertexKey(m, m.indices[t + 2], inv, uvInv, textures, false);
+    if (!(a == b) && !(b == c) && !(a == c)) ++n;
+  }
+  return n;
+}
+
+}  // namespace decimate
+
+// Vertex clustering on a uniform grid of `cell` metres: the referenced
+// vertices of each cell collapse to their average; triangles that lose an
+// edge or their area, or repeat another of their part, are removed and
+// unreferenced vertices are dropped. Parts keep their order and stay
+// contiguous; parts that lose every triangle are removed. Vertex colours are
+// averaged too, and uvs within a texture and uv square (decimate::vertexKey),
+// or with `splitColors` only vertices of the same colour and uv are merged.
+static void clusterVertices(MeshOut &m, float cell, bool splitColors = false) {
+  using namespace decimate;
+  const float inv = 1.0f / cell;
+  const bool colored = !m.colors.empty();
+  const bool textured = !m.texcoords.empty();
+  const std::vector<int32_t> textures = vertexTextures(m);
+  const float uvInv = splitColors ? 0.0f : uvCellInverse(m, cell);
+  std::unordered_map<CellColor, uint32_t, CellColorHash> cellToVertex;
+  cellToVertex.reserve(m.vertexCount() / 4 + 16);
+  std::vector<uint32_t> remap(m.vertexCount(), kUnmapped);
+  std::vector<double> accum;      // x, y, z, count per output vertex
+  std::vector<uint64_t> rgbaSum;  // r, g, b, a per output vertex, if colored
+  std::vector<double> uvSum;      // u, v per output vertex, if textured
+
+  for (const uint32_t idx : m.indices) {
+    if (remap[idx] != kUnmapped) continue;
+    const float *p = &m.positions[size_t(idx) * 3];
+    const CellColor key = vertexKey(m, idx, inv, uvInv, textures, splitColors);
+    auto ins = cellToVertex.emplace(key, static_cast<uint32_t>(accum.size() / 4));
+    if (ins.second) {
+      accum.insert(accum.end(), {0.0, 0.0, 0.0, 0.0});
+      if (colored) rgbaSum.insert(rgbaSum.end(), {0, 0, 0, 0});
+      if (textured) uvSum.insert(uvSum.end(), {0.0, 0.0});
+    }
+    const uint32_t out = ins.first->second;
+    remap[idx] = out;
+    double *a = &accum[size_t(out) * 4];
+    a[0] += p[0];
+    a[1] += p[1];
+    a[2] += p[2];
+    a[3] += 1.0;
+    if (colored) {
+      for (int k = 0; k < 4; ++k) rgbaSum[size_t(out) * 4 + k] += m.colors[idx] >> (8 * k) & 0xFF;
+    }
+    if (textured) {
+      uvSum[size_t(out) * 2] += m.texcoords[size_t(idx) * 2];
+      uvSum[size_t(out) * 2 + 1] += m.texcoords[size_t(idx) * 2 + 1];
+    }
+  }
+
+  std::vector<float> positions(accum.size() / 4 * 3);
+  std::vector<uint32_t> colors(colored ? accum.size() / 4 : 0);
+  std::vector<float> texcoords(textured ? accum.size() / 4 * 2 : 0);
+  for (size_t v = 0; v < accum.size() / 4; ++v) {
+    for (int k = 0; k < 3; ++k) {
+      positions[v * 3 + k] = static_cast<float>(accum[v * 4 + k] / accum[v * 4 + 3]);
+    }
+    if (colored) {
+      const uint64_t n = static_cast<uint64_t>(accum[v * 4 + 3]);
+      for (int k = 0; k < 4; ++k) colors[v] |= uint32_t((rgbaSum[v * 4 + k] + n / 2) / n) << (8 * k);
+    }
+    if (textured) {
+      for (int k = 0; k < 2; ++k) texcoords[v * 2 + k] = static_cast<float>(uvSum[v * 2 + k] / accum[v * 4 + 3]);
+    }
+  }
+
+  std::vector<uint32_t> indices;
+  indices.reserve(m.indices.size());
+  std::vector<PartRange> parts;
+  parts.reserve(m.parts.size());
+  auto samePosition = [&](uint32_t a, uint32_t b) {
+    return std::memcmp(&positions[size_t(a) * 3], &positions[size_t(b) * 3], 3 * sizeof(float)) == 0;
+  };
+  std::unordered_set<Triangle, TriangleHash> seen;  // this part's triangles so far
+  for (const PartRange &src : m.parts) {
+    PartRange dst = src;
+    dst.firstIndex = static_cast<uint32_t>(indices.size());
+    seen.clear();
+    for (uint32_t t = src.firstIndex; t + 2 < src.firstIndex + src.indexCount; t += 3) {
+      const uint32_t a = remap[m.indices[t]], b = remap[m.indices[t + 1]], c = remap[m.indices[t + 2]];
+      if (a == b || b == c || a == c) continue;
+      if (samePosition(a, b) || samePosition(b, c) || samePosition(a, c)) continue;
+      if (!seen.insert(rotated(a, b, c)).second) continue;
+      indices.push_back(a);
+      indices.push_back(b);
+      indices.push_back(c);
+    }
+    dst.indexCount = static_cast<uint32_t>(indices.size()) - dst.firstIndex;
+    if (dst.indexCount) parts.push_back(dst);
+  }
+
+  m.positions.swap(positions);
+  m.colors.swap(colors);
+  m.texcoords.swap(texcoords);
+  m.indices.swap(indices);
+  m.parts.swap(parts);
+  recomputeBounds(m);
+}
+
+// Merges vertices that coincide to within a millionth of the scene size
+// and have the same colour and uv. Traversal emits three fresh vertices per
+// triangle, so this alone usually shrinks vertex storage several times
+// without visible change.
+static void weldVertices(MeshOut &m) {
+  const float diag = boundsDiagonal(m.posMin, m.posMax);
+  if (diag > 0.0f) clusterVertices(m, diag * 1e-6f, true);
+}
+
+// Removes parts whose bounding-box diagonal is below `minFraction` of the
+// scene diagonal, smallest first, until the mesh fits `maxTriangles`.
+// Returns the number of parts dropped.
+static size_t dropSmallParts(MeshOut &m, size_t maxTriangles, float minFraction) {
+  const float limit = boundsDiagonal(m.posMin, m.posMax) * minFraction;
+  std::vector<size_t> order(m.parts.size());
+  for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return boundsDiagonal(m.parts[a].bmin, m.parts[a].bmax) <
+           boundsDiagonal(m.parts[b].bmin, m.parts[b].bmax);
+  });
+
+  std::vector<bool> drop(m.parts.size(), false);
+  size_t tris = m.triangleCount(), dropped = 0;
+  for (const size_t i : order) {
+    if (tris <= maxTriangles) break;
+    if (boundsDiagonal(m.parts[i].bmin, m.parts[i].bmax) >= limit) break;
+    drop[i] = true;
+    tris -= m.parts[i].indexCount / 3;
+    ++dropped;
+  }
+  if (!dropped) return 0;
+
+  std::vector<uint32_t> indices;
+  indices.reserve(tris * 3);
+  std::vector<PartRange> parts;
+  for (size_t i = 0; i < m.parts.size(); ++i) {
+    if (drop[i]) continue;
+    PartRange p = m.parts[i];
+    const uint32_t first = p.firstIndex;
+    p.firstIndex = static_cast<uint32_t>(indices.size());
+    indices.insert(indices.end(), m.indices.begin() + first, m.indices.begin() + first + p.indexCount);
+    parts.push_back(p);
+  }
+  m.indices.swap(indices);
+  m.parts.swap(parts);
+  return dropped;
+}
+
+// Clusters with the finest grid that brings the mesh to `maxTriangles`
+// (bisection on a log scale over the cell size). Returns the cell size used,
+// or 0 if the mesh already fit.
+static float clusterToBudget(MeshOut &m, size_t maxTriangles) {
+  if (m.triangleCount() <= maxTriangles) return 0.0f;
+  const float diag = boundsDiagonal(m.posMin, m.posMax);
+  if (diag <= 0.0f) return 0.0f;
+  float lo = diag * 1e-6f;  // too fine: over budget
+  float hi = diag * 0.5f;   // coarse enough for almost anything
+  const std::vector<int32_t> textures = decimate::vertexTextures(m);
+  for (int iter = 0; iter < 12; ++iter) {
+    const float mid = std::sqrt(lo * hi);
+    if (decimate::countSurvivors(m, mid, textures) > maxTriangles) lo = mid;
+    else hi = mid;
+  }
+  clusterVertices(m, hi);
+  return hi;
+}
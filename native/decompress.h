@@ -0,0 +1,249 @@
+// Streaming decompression of .iv.gz / .iv.zst input.
+//
+// Compressed input is recognised by its magic bytes and decoded on the fly
+// into the stream SoInput reads, so the decompressed text never touches
+// disk. gzip is inflated inline as the parser pulls; zstd is decoded on its
+// own thread into a small queue of blocks, so decompression overlaps parsing.
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <fcntl.h>
+#include <zlib.h>
+#include <zstd.h>
+
+#include "async_io.h"
+#include "input_stream.h"
+
+enum class Compression { kNone, kGzip, kZstd };
+
+static inline const char *compressionName(Compression c) {
+  switch (c) {
+    case Compression::kGzip: return "gzip";
+    case Compression::kZstd: return "zstd";
+    default:                 return "none";
+  }
+}
+
+static inline Compression detectCompression(const unsigned char *magic, size_t n) {
+  if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) return Compression::kGzip;
+  if (n >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+    return Compression::kZstd;
+  }
+  return Compression::kNone;
+}
+
+// gzip (including concatenated members), inflated as the reader asks.
+class GzipSource : public ByteSource {
+public:
+  explicit GzipSource(std::unique_ptr<ByteSource> in) : in_(std::move(in)), buf_(1 << 16) {
+    std::memset(&zs_, 0, sizeof(zs_));
+    ok_ = inflateInit2(&zs_, 16 + MAX_WBITS) == Z_OK;
+  }
+  ~GzipSource() override {
+    if (ok_) inflateEnd(&zs_);
+  }
+
+  ssize_t read(char *out, size_t size) override {
+    if (!ok_) return fail();
+    const uInt want = static_cast<uInt>(std::min<size_t>(size, 1u << 30));
+    zs_.next_out = reinterpret_cast<Bytef *>(out);
+    zs_.avail_out = want;
+    while (zs_.avail_out == want) {
+      if (zs_.avail_in == 0) {
+        if (inEof_) {
+          if (midStream_) return fail();  // truncated
+          break;
+        }
+        const ssize_t n = in_->read(reinterpret_cast<char *>(buf_.data()), buf_.size());
+        if (n < 0) return -1;
+        if (n == 0) {
+          inEof_ = true;
+          continue;
+        }
+        zs_.next_in = buf_.data();
+        zs_.avail_in = static_cast<uInt>(n);
+      }
+      midStream_ = true;
+      const int rc = inflate(&zs_, Z_NO_FLUSH);
+      if (rc == Z_STREAM_END) {
+        midStream_ = false;
+        inflateReset(&zs_);  // another member may follow
+      } else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+        return fail();
+      }
+    }
+    return static_cast<ssize_t>(want - zs_.avail_out);
+  }
+
+private:
+  static ssize_t fail() {
+    errno = EIO;
+    return -1;
+  }
+
+  std::unique_ptr<ByteSource> in_;
+  std::vector<Bytef> buf_;
+  z_stream zs_;
+  bool ok_ = false;
+  bool inEof_ = false;
+  bool midStream_ = false;
+};
+
+// zstd, decoded by a producer thread into at most kQueueBlocks blocks ahead
+// of the reader (double-buffering with some slack for uneven parse speed).
+class ZstdSource : public ByteSource {
+public:
+  explicit ZstdSource(std::unique_ptr<ByteSource> in) : in_(std::move(in)) {
+    worker_ = std::thread([this] { produce(); });
+  }
+  ~ZstdSource() override {
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    worker_.join();
+  }
+
+  ssize_t read(char *out, size_t size) override {
+    std::unique_lock<std::mutex> lock(mu_);
+    cv_.wait(lock, [this] { return !queue_.empty() || done_; });
+    if (queue_.empty()) {
+      if (error_) {
+        errno = EIO;
+        return -1;
+      }
+      return 0;
+    }
+    std::vector<char> &block = queue_.front();
+    const size_t n = std::min(size, block.size() - frontPos_);
+    std::memcpy(out, block.data() + frontPos_, n);
+    frontPos_ += n;
+    if (frontPos_ == block.size()) {
+      queue_.pop_front();
+      frontPos_ = 0;
+      cv_.notify_all();
+    }
+    return static_cast<ssize_t>(n);
+  }
+
+private:
+  static constexpr size_t kQueueBlocks = 4;
+  static constexpr size_t kBlockBytes = 1 << 20;
+
+  void produce() {
+    ZSTD_DStream *ds = ZSTD_createDStream();
+    bool ok = ds && !ZSTD_isError(ZSTD_initDStream(ds));
+    std::vector<char> inBuf(ZSTD_DStreamInSize());
+    ZSTD_inBuffer in = {inBuf.data(), 0, 0};
+    size_t hint = 0;  // from ZSTD_decompressStream; 0 once a frame is complete
+    bool inEof = false;
+    while (ok) {
+      std::vector<char> block(kBlockBytes);
+      ZSTD_outBuffer out = {block.data(), block.size(), 0};
+      bool drained = false;
+      while (out.pos < out.size) {
+        if (in.pos == in.size && !inEof) {
+          const ssize_t n = in_->read(inBuf.data(), inBuf.size());
+          if (n < 0) {
+            ok = false;
+            break;
+          }
+          inEof = (n == 0);
+          in.size = static_cast<size_t>(n);
+          in.pos = 0;
+        }
+        const size_t outBefore = out.pos, inBefore = in.pos;
+        const size_t rc = ZSTD_decompressStream(ds, &out, &in);
+        if (ZSTD_isError(rc)) {
+          ok = false;
+          break;
+        }
+        // At end of input, keep calling until the decoder has nothing left.
+        // A call that made no progress does not change the frame state.
+        if (out.pos == outBefore && in.pos == inBefore) {
+          if (inEof) {
+            drained = true;
+            break;
+          }
+        } else {
+          hint = rc;
+        }
+      }
+      if (ok && out.pos) {
+        block.resize(out.pos);
+        std::unique_lock<std::mutex> lock(mu_);
+        cv_.wait(lock, [this] { return queue_.size() < kQueueBlocks || stop_; });
+        if (stop_) break;
+        queue_.push_back(std::move(block));
+        cv_.notify_all();
+      }
+      if (drained) {
+        ok = (hint == 0);  // otherwise the last frame is truncated
+        break;
+      }
+    }
+    if (ds) ZSTD_freeDStream(ds);
+    std::lock_guard<std::mutex> lock(mu_);
+    error_ = !ok && !stop_;
+    done_ = true;
+    cv_.notify_all();
+  }
+
+  std::unique_ptr<ByteSource> in_;
+  std::thread worker_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<std::vector<char>> queue_;
+  size_t frontPos_ = 0;
+  bool done_ = false;
+  bool error_ = false;
+  bool stop_ = false;
+};
+
+// True if `path` is a regular file starting with a gzip or zstd magic.
+static inline bool isCompressedFile(const std::string &path) {
+  unsigned char magic[4];
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  const ssize_t n = ::read(fd, magic, sizeof(magic));
+  ::close(fd);
+  return n > 0 && detectCompression(magic, static_cast<size_t>(n)) != Compression::kNone;
+}
+
+// Opens `path` (file, FIFO or pipe; "-" = stdin) as a sequential stdio
+// stream, decoding gzip/zstd on the fly. Regular files are read ahead
+// (async_io.h) unless --io sync. Returns nullptr if it cannot be opened.
+// stdin can be opened once only.
+static inline FILE *openInputStream(const std::string &path, StreamCookie **cookieOut,
+                                    Compression *compressionOut) {
+  const bool fromStdin = path == "-";
+  const int fd = fromStdin ? ::fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 0) : ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return nullptr;
+  ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);  // fails harmlessly on pipes
+  std::unique_ptr<ByteSource> raw;
+  unsigned char magic[4];
+  size_t n;
+  // Read-ahead reads by offset from 0, which a redirected stdin need not be at.
+  if (g_ioMode != IoMode::kSync && !fromStdin && asyncio::isRegularFd(fd)) {
+    ReadAheadSource *file = new ReadAheadSource(fd);
+    raw.reset(file);
+    n = file->peek(reinterpret_cast<char *>(magic), sizeof(magic));
+  } else {
+    FdSource *pipe = new FdSource(fd);
+    raw.reset(pipe);
+    n = pipe->peek(reinterpret_cast<char *>(magic), sizeof(magic));
+  }
+  const Compression c = detectCompression(magic, n);
+  if (compressionOut) *compressionOut = c;
+  std::unique_ptr<ByteSource> src;
+  switch (c) {
+    case Compression::kGzip: src.reset(new GzipSource(std::move(raw))); break;
+    case Compression::kZstd: src.reset(new ZstdSource(std::move(raw))); break;
+    default:                 src = std::move(raw); break;
+  }
+  return openStreamInput(std::move(src), cookieOut);
+}
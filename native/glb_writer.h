@@ -0,0 +1,499 @@
+// Single-pass GLB serializer for the subset of tinygltf::Model iv2glb builds.
+//
+// tinygltf writes a GLB from model.buffers[0].data, so every mesh had to be
+// copied into one buffer first, and it needs a seekable file or a full
+// in-memory copy to know the chunk lengths. Here the JSON chunk is built
+// from the model, the BIN chunk is a list of segments pointing at the
+// caller's arrays, and all lengths are known before the first byte goes out;
+// header, JSON and BIN are then written front to back, which also works on
+// stdout or a pipe.
+//
+// The same JSON and BIN data can be written as a .gltf with an external
+// .bin (writeBin) instead.
+//
+// Include after tiny_gltf.h (iv2glb.cpp defines its implementation).
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "async_io.h"
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "GLB is little-endian");
+
+// BIN chunk contents: caller-owned arrays, each starting 4-byte aligned.
+// The arrays must outlive writeGlb() / writeBin().
+struct GlbBin {
+  struct Segment {
+    const void *data;  // nullptr: zero padding
+    size_t bytes;
+  };
+  std::vector<Segment> segments;
+  size_t bytes = 0;
+
+  // Appends `n` bytes at `data`; returns their offset in the chunk.
+  size_t add(const void *data, size_t n) {
+    align();
+    const size_t at = bytes;
+    if (n) segments.push_back({data, n});
+    bytes += n;
+    return at;
+  }
+  // Pads to a multiple of `to` (a power of two); returns the new size.
+  size_t align(size_t to = 4) {
+    const size_t pad = (to - bytes % to) % to;
+    if (pad) segments.push_back({nullptr, pad});
+    bytes += pad;
+    return bytes;
+  }
+};
+
+namespace glb {
+
+constexpr uint32_t kMagic = 0x46546C67;      // "glTF"
+constexpr uint32_t kChunkJson = 0x4E4F534A;  // "JSON"
+constexpr uint32_t kChunkBin = 0x004E4942;   // "BIN\0"
+
+inline void str(std::string &o, const std::string &s) {
+  o += '"';
+  for (const char c : s) {
+    switch (c) {
+      case '"': o += "\\\""; break;
+      case '\\': o += "\\\\"; break;
+      case '\n': o += "\\n"; break;
+      case '\r': o += "\\r"; break;
+      case '\t': o += "\\t"; break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char buf[8];
+          std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+          o += buf;
+        } else {
+          o += c;
+        }
+    }
+  }
+  o += '"';
+}
+
+// Percent-encodes everything but RFC 3986 unreserved characters.
+inline std::string uriEscape(const std::string &s) {
+  std::string o;
+  for (const char c : s) {
+    if (std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '.' || c == '_' || c == '~') {
+      o += c;
+    } else {
+      char buf[4];
+      std::snprintf(buf, sizeof(buf), "%%%02X", static_cast<unsigned char>(c));
+      o += buf;
+    }
+  }
+  return o;
+}
+
+inline void num(std::string &o, double v) {
+  char buf[32];
+  // %.17g round-trips doubles (and the floats stored in them); JSON has no
+  // NaN or infinity.
+  std::snprintf(buf, sizeof(buf), "%.17g", std::isfinite(v) ? v : 0.0);
+  o += buf;
+}
+
+inline void num(std::string &o, uint64_t v) { o += std::to_string(v); }
+inline void num(std::string &o, int v) { o += std::to_string(v); }
+
+// `"key":` preceded by a comma unless it opens the object.
+inline void key(std::string &o, const std::string &k) {
+  if (o.back() != '{') o += ',';
+  str(o, k);
+  o += ':';
+}
+
+inline void value(std::string &o, const tinygltf::Value &v) {
+  if (v.IsBool()) {
+    o += v.Get<bool>() ? "true" : "false";
+  } else if (v.IsInt()) {
+    num(o, v.Get<int>());
+  } else if (v.IsNumber()) {
+    num(o, v.GetNumberAsDouble());
+  } else if (v.IsString()) {
+    str(o, v.Get<std::string>());
+  } else if (v.IsArray()) {
+    o += '[';
+    for (size_t i = 0; i < v.ArrayLen(); ++i) {
+      if (i) o += ',';
+      value(o, v.Get(static_cast<int>(i)));
+    }
+    o += ']';
+  } else if (v.IsObject()) {
+    o += '{';
+    for (const std::string &k : v.Keys()) {
+      key(o, k);
+      value(o, v.Get(k));
+    }
+    o += '}';
+  } else {
+    o += "null";
+  }
+}
+
+// "extras", if `v` is a non-empty object (the only kind iv2glb sets).
+inline void extras(std::string &o, const tinygltf::Value &v) {
+  if (!v.IsObject() || v.Keys().empty()) return;
+  key(o, "extras");
+  value(o, v);
+}
+
+// "extensions", if any are set.
+inline void extensions(std::string &o, const tinygltf::ExtensionMap &ext) {
+  if (ext.empty()) return;
+  key(o, "extensions");
+  o += '{';
+  for (const auto &e : ext) {
+    key(o, e.first);
+    value(o, e.second);
+  }
+  o += '}';
+}
+
+inline void strArray(std::string &o, const std::vector<std::string> &v) {
+  o += '[';
+  for (size_t i = 0; i < v.size(); ++i) {
+    if (i) o += ',';
+    str(o, v[i]);
+  }
+  o += ']';
+}
+
+template <typename T>
+inline void numArray(std::string &o, const std::vector<T> &v) {
+  o += '[';
+  for (size_t i = 0; i < v.size(); ++i) {
+    if (i) o += ',';
+    num(o, v[i]);
+  }
+  o += ']';
+}
+
+inline const char *accessorType(int type) {
+  switch (type) {
+    case TINYGLTF_TYPE_SCALAR: return "SCALAR";
+    case TINYGLTF_TYPE_VEC2: return "VEC2";
+    case TINYGLTF_TYPE_VEC3: return "VEC3";
+    case TINYGLTF_TYPE_VEC4: return "VEC4";
+    case TINYGLTF_TYPE_MAT4: return "MAT4";
+    default: return "SCALAR";
+  }
+}
+
+// Writes `items` as a top-level array property, `each` emitting one object
+// body (between the braces). Empty arrays are left out, as glTF requires.
+template <typename T, typename F>
+inline void objects(std::string &o, const char *k, const std::vector<T> &items, F each) {
+  if (items.empty()) return;
+  key(o, k);
+  o += '[';
+  for (size_t i = 0; i < items.size(); ++i) {
+    o += i ? ",{" : "{";
+    each(items[i]);
+    o += '}';
+  }
+  o += ']';
+}
+
+}  // namespace glb
+
+// The glTF JSON for `m`, with a single buffer of `binBytes` (model.buffers
+// is ignored; the BIN data is supplied separately): the GLB BIN chunk, or
+// the file `binFile` (a name relative to the .gltf) for a .gltf.
+static std::string gltfJson(const tinygltf::Model &m, size_t binBytes,
+                            const std::string &binFile = std::string()) {
+  using namespace glb;
+  std::string o = "{";
+  key(o, "asset");
+  o += '{';
+  key(o, "version");
+  str(o, m.asset.version);
+  if (!m.asset.generator.empty()) {
+    key(o, "generator");
+    str(o, m.asset.generator);
+  }
+  o += '}';
+  if (!m.extensionsUsed.empty()) {
+    key(o, "extensionsUsed");
+    strArray(o, m.extensionsUsed);
+  }
+  if (!m.extensionsRequired.empty()) {
+    key(o, "extensionsRequired");
+    strArray(o, m.extensionsRequired);
+  }
+
+  if (m.defaultScene >= 0) {
+    key(o, "scene");
+    num(o, m.defaultScene);
+  }
+  objects(o, "scenes", m.scenes, [&](const tinygltf::Scene &s) {
+    if (!s.name.empty()) {
+      key(o, "name");
+      str(o, s.name);
+    }
+    if (!s.nodes.empty()) {
+      key(o, "nodes");
+      numArray(o, s.nodes);
+    }
+    extras(o, s.extras);
+  });
+  objects(o, "nodes", m.nodes, [&](const tinygltf::Node &n) {
+    if (!n.name.empty()) {
+      key(o, "name");
+      str(o, n.name);
+    }
+    if (n.mesh >= 0) {
+      key(o, "mesh");
+      num(o, n.mesh);
+    }
+    if (!n.children.empty()) {
+      key(o, "children");
+      numArray(o, n.children);
+    }
+    if (!n.matrix.empty()) {
+      key(o, "matrix");
+      numArray(o, n.matrix);
+    }
+    if (!n.translation.empty()) {
+      key(o, "translation");
+      numArray(o, n.translation);
+    }
+    if (!n.rotation.empty()) {
+      key(o, "rotation");
+      numArray(o, n.rotation);
+    }
+    if (!n.scale.empty()) {
+      key(o, "scale");
+      numArray(o, n.scale);
+    }
+    extensions(o, n.extensions);
+    extras(o, n.extras);
+  });
+  objects(o, "meshes", m.meshes, [&](const tinygltf::Mesh &mesh) {
+    if (!mesh.name.empty()) {
+      key(o, "name");
+      str(o, mesh.name);
+    }
+    key(o, "primitives");
+    o += '[';
+    for (size_t i = 0; i < mesh.primitives.size(); ++i) {
+      const tinygltf::Primitive &p = mesh.primitives[i];
+      o += i ? ",{" : "{";
+      key(o, "attributes");
+      o += '{';
+      for (const auto &a : p.attributes) {
+        key(o, a.first);
+        num(o, a.second);
+      }
+      o += '}';
+      if (p.indices >= 0) {
+        key(o, "indices");
+        num(o, p.indices);
+      }
+      if (p.material >= 0) {
+        key(o, "material");
+        num(o, p.material);
+      }
+      if (p.mode >= 0) {
+        key(o, "mode");
+        num(o, p.mode);
+      }
+      o += '}';
+    }
+    o += ']';
+    extras(o, mesh.extras);
+  });
+  objects(o, "materials", m.materials, [&](const tinygltf::Material &mat) {
+    if (!mat.name.empty()) {
+      key(o, "name");
+      str(o, mat.name);
+    }
+    const tinygltf::PbrMetallicRoughness &pbr = mat.pbrMetallicRoughness;
+    key(o, "pbrMetallicRoughness");
+    o += '{';
+    key(o, "baseColorFactor");
+    numArray(o, pbr.baseColorFactor);
+    if (pbr.baseColorTexture.index >= 0) {
+      key(o, "baseColorTexture");
+      o += '{';
+      key(o, "index");
+      num(o, pbr.baseColorTexture.index);
+      if (pbr.baseColorTexture.texCoord) {
+        key(o, "texCoord");
+        num(o, pbr.baseColorTexture.texCoord);
+      }
+      o += '}';
+    }
+    key(o, "metallicFactor");
+    num(o, pbr.metallicFactor);
+    key(o, "roughnessFactor");
+    num(o, pbr.roughnessFactor);
+    o += '}';
+    if (mat.emissiveFactor.size() == 3 &&
+        (mat.emissiveFactor[0] != 0.0 || mat.emissiveFactor[1] != 0.0 || mat.emissiveFactor[2] != 0.0)) {
+      key(o, "emissiveFactor");
+      numArray(o, mat.emissiveFactor);
+    }
+    if (mat.alphaMode != "OPAQUE") {
+      key(o, "alphaMode");
+      str(o, mat.alphaMode);
+    }
+    if (mat.doubleSided) {
+      key(o, "doubleSided");
+      o += "true";
+    }
+  });
+  objects(o, "textures", m.textures, [&](const tinygltf::Texture &t) {
+    if (t.sampler >= 0) {
+      key(o, "sampler");
+      num(o, t.sampler);
+    }
+    if (t.source >= 0) {
+      key(o, "source");
+      num(o, t.source);
+    }
+    extensions(o, t.extensions);
+  });
+  objects(o, "samplers", m.samplers, [&](const tinygltf::Sampler &s) {
+    if (s.magFilter >= 0) {
+      key(o, "magFilter");
+      num(o, s.magFilter);
+    }
+    if (s.minFilter >= 0) {
+      key(o, "minFilter");
+      num(o, s.minFilter);
+    }
+    key(o, "wrapS");
+    num(o, s.wrapS);
+    key(o, "wrapT");
+    num(o, s.wrapT);
+  });
+  objects(o, "images", m.images, [&](const tinygltf::Image &img) {
+    if (!img.name.empty()) {
+      key(o, "name");
+      str(o, img.name);
+    }
+    if (img.bufferView >= 0) {
+      key(o, "bufferView");
+      num(o, img.bufferView);
+    }
+    if (!img.mimeType.empty()) {
+      key(o, "mimeType");
+      str(o, img.mimeType);
+    }
+    if (!img.uri.empty()) {
+      key(o, "uri");
+      str(o, uriEscape(img.uri));
+    }
+  });
+  objects(o, "accessors", m.accessors, [&](const tinygltf::Accessor &a) {
+    if (a.bufferView >= 0) {
+      key(o, "bufferView");
+      num(o, a.bufferView);
+    }
+    if (a.byteOffset) {
+      key(o, "byteOffset");
+      num(o, uint64_t(a.byteOffset));
+    }
+    key(o, "componentType");
+    num(o, a.componentType);
+    if (a.normalized) {
+      key(o, "normalized");
+      o += "true";
+    }
+    key(o, "count");
+    num(o, uint64_t(a.count));
+    key(o, "type");
+    str(o, accessorType(a.type));
+    if (!a.minValues.empty()) {
+      key(o, "min");
+      numArray(o, a.minValues);
+    }
+    if (!a.maxValues.empty()) {
+      key(o, "max");
+      numArray(o, a.maxValues);
+    }
+  });
+  objects(o, "bufferViews", m.bufferViews, [&](const tinygltf::BufferView &v) {
+    key(o, "buffer");
+    num(o, v.buffer);
+    if (v.byteOffset) {
+      key(o, "byteOffset");
+      num(o, uint64_t(v.byteOffset));
+    }
+    key(o, "byteLength");
+    num(o, uint64_t(v.byteLength));
+    if (v.byteStride) {
+      key(o, "byteStride");
+      num(o, uint64_t(v.byteStride));
+    }
+    if (v.target) {
+      key(o, "target");
+      num(o, v.target);
+    }
+  });
+  if (binBytes) {
+    key(o, "buffers");
+    o += "[{";
+    if (!binFile.empty()) {
+      key(o, "uri");
+      str(o, uriEscape(binFile));
+    }
+    key(o, "byteLength");
+    num(o, uint64_t(binBytes));
+    o += "}]";
+  }
+  o += '}';
+  return o;
+}
+
+// Writes the segments of `bin` to `out`, zero-filling the padding.
+static bool writeBin(const GlbBin &bin, WriteBehindFile &out) {
+  static const char zeros[4096] = {};
+  bool ok = true;
+  for (size_t i = 0; ok && i < bin.segments.size(); ++i) {
+    const GlbBin::Segment &s = bin.segments[i];
+    if (s.data) {
+      ok = out.write(s.data, s.bytes);
+      continue;
+    }
+    for (size_t left = s.bytes; ok && left; left -= std::min(left, sizeof(zeros))) {
+      ok = out.write(zeros, std::min(left, sizeof(zeros)));
+    }
+  }
+  return ok;
+}
+
+// Writes `m` with `bin` as its BIN chunk to `out`, front to back.
+static bool writeGlb(const tinygltf::Model &m, const GlbBin &bin, WriteBehindFile &out) {
+  using namespace glb;
+  std::string json = gltfJson(m, bin.bytes);
+  json.append((4 - json.size() % 4) % 4, ' ');
+  const size_t binPadded = (bin.bytes + 3) & ~size_t(3);
+  const uint64_t total = 12 + 8 + json.size() + (bin.bytes ? 8 + binPadded : 0);
+  if (total > UINT32_MAX) {
+    out.fail(EFBIG);
+    return false;
+  }
+
+  const uint32_t header[5] = {kMagic, 2, uint32_t(total), uint32_t(json.size()), kChunkJson};
+  bool ok = out.write(header, sizeof(header)) && out.write(json.data(), json.size());
+  if (ok && bin.bytes) {
+    const uint32_t chunk[2] = {uint32_t(binPadded), kChunkBin};
+    static const char zeros[4] = {};
+    ok = out.write(chunk, sizeof(chunk)) && writeBin(bin, out) &&
+         out.write(zeros, binPadded - bin.bytes);
+  }
+  return ok;
+}
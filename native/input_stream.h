@@ -0,0 +1,178 @@
+// Non-seekable inputs (FIFOs, pipes, decompressors) for SoInput.
+//
+// SoInput::setFilePointer() peeks at the first bytes to detect compression
+// and then seeks back, which fails on a pipe. openStreamInput() wraps a
+// ByteSource in a stdio stream (glibc fopencookie) that keeps the first
+// kStreamHeadBytes it has read, so rewinds inside that window succeed and the
+// rest of the data is consumed strictly sequentially as it arrives.
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+static constexpr size_t kStreamHeadBytes = 64 * 1024;
+
+namespace streamio {
+
+inline ssize_t readFd(int fd, char *buf, size_t size) {
+  ssize_t n;
+  do {
+    n = ::read(fd, buf, size);
+  } while (n < 0 && errno == EINTR);
+  return n;
+}
+
+}  // namespace streamio
+
+// Sequential producer of input bytes. read() returns 0 at EOF and -1 with
+// errno set on error.
+class ByteSource {
+public:
+  virtual ~ByteSource() = default;
+  virtual ssize_t read(char *buf, size_t size) = 0;
+};
+
+// A file descriptor (owned). Bytes already taken off it to sniff the format
+// are pushed back and returned first.
+class FdSource : public ByteSource {
+public:
+  explicit FdSource(int fd) : fd_(fd) {}
+  ~FdSource() override { ::close(fd_); }
+
+  // Reads up to `size` bytes from the front without consuming them.
+  size_t peek(char *buf, size_t size) {
+    while (pushback_.size() < size) {
+      char tmp[64];
+      const ssize_t n = streamio::readFd(fd_, tmp, std::min(sizeof(tmp), size - pushback_.size()));
+      if (n <= 0) break;
+      pushback_.insert(pushback_.end(), tmp, tmp + n);
+    }
+    const size_t n = std::min(size, pushback_.size());
+    std::memcpy(buf, pushback_.data(), n);
+    return n;
+  }
+
+  ssize_t read(char *buf, size_t size) override {
+    if (pbPos_ < pushback_.size()) {
+      const size_t n = std::min(size, pushback_.size() - pbPos_);
+      std::memcpy(buf, pushback_.data() + pbPos_, n);
+      pbPos_ += n;
+      return static_cast<ssize_t>(n);
+    }
+    return streamio::readFd(fd_, buf, size);
+  }
+
+private:
+  int fd_;
+  std::vector<char> pushback_;
+  size_t pbPos_ = 0;
+};
+
+struct StreamCookie {
+  std::unique_ptr<ByteSource> src;
+  std::vector<char> head;  // first bytes of the stream, kept for rewinds
+  uint64_t pos = 0;        // logical read position
+  uint64_t filled = 0;     // bytes pulled from src so far
+};
+
+namespace streamio {
+
+inline ssize_t cookieRead(void *c, char *buf, size_t size) {
+  StreamCookie *s = static_cast<StreamCookie *>(c);
+  if (s->pos < s->filled) {  // replaying the retained head after a rewind
+    const size_t n = static_cast<size_t>(std::min<uint64_t>(size, s->filled - s->pos));
+    std::memcpy(buf, s->head.data() + s->pos, n);
+    s->pos += n;
+    return static_cast<ssize_t>(n);
+  }
+  const ssize_t n = s->src->read(buf, size);
+  if (n <= 0) return n;
+  if (s->filled < kStreamHeadBytes) {
+    const size_t keep = static_cast<size_t>(std::min<uint64_t>(n, kStreamHeadBytes - s->filled));
+    s->head.insert(s->head.end(), buf, buf + keep);
+  }
+  s->filled += static_cast<uint64_t>(n);
+  s->pos = s->filled;
+  return n;
+}
+
+inline int cookieSeek(void *c, off64_t *offset, int whence) {
+  StreamCookie *s = static_cast<StreamCookie *>(c);
+  int64_t target;
+  switch (whence) {
+    case SEEK_SET: target = *offset; break;
+    case SEEK_CUR: target = static_cast<int64_t>(s->pos) + *offset; break;
+    default: errno = ESPIPE; return -1;
+  }
+  if (target < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  const uint64_t t = static_cast<uint64_t>(target);
+  if (t < s->pos) {
+    // Backwards only works while everything read so far is retained.
+    if (s->filled > s->head.size()) {
+      errno = ESPIPE;
+      return -1;
+    }
+    s->pos = t;
+  } else {
+    char skip[4096];
+    while (s->pos < t) {
+      const size_t want = static_cast<size_t>(std::min<uint64_t>(sizeof(skip), t - s->pos));
+      const ssize_t n = cookieRead(s, skip, want);
+      if (n <= 0) break;
+    }
+  }
+  *offset = static_cast<off64_t>(s->pos);
+  return 0;
+}
+
+inline int cookieClose(void *c) {
+  delete static_cast<StreamCookie *>(c);
+  return 0;
+}
+
+}  // namespace streamio
+
+// True if `path` names something that must be read sequentially: "-"
+// (stdin, whatever it is), a FIFO or pipe (also as /dev/fd/N), a character
+// device or a socket.
+static inline bool isStreamPath(const std::string &path) {
+  if (path == "-") return true;
+  struct stat st;
+  return ::stat(path.c_str(), &st) == 0 && (S_ISFIFO(st.st_mode) || S_ISCHR(st.st_mode) ||
+                                            S_ISSOCK(st.st_mode));
+}
+
+// Wraps a source (ownership moves to the stream). If `cookieOut` is given it
+// receives the cookie, e.g. to read the byte count afterwards; it is valid
+// until the stream is closed.
+static inline FILE *openStreamInput(std::unique_ptr<ByteSource> src,
+                                    StreamCookie **cookieOut = nullptr) {
+  StreamCookie *cookie = new StreamCookie;
+  cookie->src = std::move(src);
+  cookie->head.reserve(kStreamHeadBytes);
+  cookie_io_functions_t io;
+  io.read = streamio::cookieRead;
+  io.write = nullptr;
+  io.seek = streamio::cookieSeek;
+  io.close = streamio::cookieClose;
+  FILE *f = ::fopencookie(cookie, "r", io);
+  if (!f) {
+    delete cookie;
+    return nullptr;
+  }
+  if (cookieOut) *cookieOut = cookie;
+  return f;
+}
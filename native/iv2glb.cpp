@@ -1,19 +1,53 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cstdint>
+#include <cstring>
+#include <deque>
 #include <vector>
 #include <string>
 #include <limits>
+#include <map>
+#include <mutex>
 #include <stdexcept>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 // Coin3D / Open Inventor
 #include <Inventor/SoDB.h>
 #include <Inventor/SoInput.h>
+#include <Inventor/SbBox3f.h>
+#include <Inventor/SbImage.h>
 #include <Inventor/SbVec3f.h>
 #include <Inventor/SbMatrix.h>
+#include <Inventor/SbVec2s.h>
+#include <Inventor/SbVec4f.h>
+#include <Inventor/SoPath.h>
 #include <Inventor/actions/SoCallbackAction.h>
+#include <Inventor/actions/SoGetMatrixAction.h>
+#include <Inventor/actions/SoGetPrimitiveCountAction.h>
+#include <Inventor/actions/SoSearchAction.h>
+#include <Inventor/nodes/SoFile.h>
+#include <Inventor/nodes/SoGroup.h>
+#include <Inventor/nodes/SoMatrixTransform.h>
+#include <Inventor/nodes/SoResetTransform.h>
 #include <Inventor/nodes/SoShape.h>
+#include <Inventor/nodes/SoTexture2.h>
 #include <Inventor/nodes/SoUnits.h>
+#include <Inventor/misc/SoChildList.h>
+#include <Inventor/VRMLnodes/SoVRMLInline.h>
 
 // tinygltf (you must add this file to your repo, see notes below)
 #define TINYGLTF_IMPLEMENTATION
@@ -23,24 +57,162 @@
 #define TINYGLTF_NOEXCEPTION
 #include "tiny_gltf.h"
 
-struct MeshOut {
-  std::vector<float> positions;   // xyz xyz xyz ...
-  std::vector<uint32_t> indices;  // 0..N-1
-  float posMin[3] = { +std::numeric_limits<float>::infinity(),
-                      +std::numeric_limits<float>::infinity(),
-                      +std::numeric_limits<float>::infinity() };
-  float posMax[3] = { -std::numeric_limits<float>::infinity(),
-                      -std::numeric_limits<float>::infinity(),
-                      -std::numeric_limits<float>::infinity() };
+#include "box_proxy.h"
+#include "decimate.h"
+#include "decompress.h"
+#include "glb_writer.h"
+#include "input_stream.h"
+#include "iv_fastparse.h"
+#include "iv_scan.h"
+#include "mesh_file.h"
+#include "mesh_out.h"
+#include "parse_cache.h"
+#include "spatial_chunks.h"
+#include "texture_atlas.h"
+#include "textures.h"
+#include "thumbnail.h"
+#include "zip_archive.h"
+
+// What the job output reports about the scene ("metadata" in the stats,
+// --metadata-only), gathered by the passes that run anyway: the shape
+// callbacks note each shape instance, the exports what they wrote.
+struct SceneMetadata {
+  std::unordered_map<const SoNode *, uint32_t> shapeUses;  // shape node -> instances
+  // Shapes folded out of shapeUses once freed (one top-level node at a time).
+  uint64_t retiredShapes = 0;
+  uint64_t retiredInstanced = 0;
+  uint32_t retiredMaxUses = 0;
+  std::map<int, uint64_t> units;           // SoUnits::Units -> shape instances
+  std::map<uint32_t, uint64_t> materials;  // diffuse RGB + opacity, 8 bits each -> shape instances
+  std::vector<std::string> topLevelParts;  // DEF names of the parts below the root
+  // World-space bounds in metres: of the written geometry, or with
+  // --metadata-only of the shapes' own bounding boxes.
+  float bmin[3] = {+std::numeric_limits<float>::infinity(), +std::numeric_limits<float>::infinity(),
+                   +std::numeric_limits<float>::infinity()};
+  float bmax[3] = {-std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+                   -std::numeric_limits<float>::infinity()};
+  uint64_t outputTriangles = 0;
+  uint64_t outputVertices = 0;
+  bool written = false;  // an export filled the output counts
+};
+
+// Per-run measurements written with --stats. main.py records these next to
+// the measured wall time to train its cost predictor.
+struct ConvertStats {
+  uint64_t inputBytes = 0;
+  uint64_t nodeCount = 0;     // unique nodes in the scene graph
+  uint64_t nodeRefCount = 0;  // child references, so a USE counts again
+  uint64_t shapeCount = 0;    // shape instances visited by the traversal
+  uint64_t triangleCount = 0;
+  double parseMs = 0.0;
+  double traverseMs = 0.0;
+  double writeMs = 0.0;
+  double saveMeshMs = 0.0;    // --save-mesh
+  long peakRssKb = 0;
+  const char *aborted = nullptr;     // "deadline" | "memory" | "cancelled" | "triangles"
+  const char *abortStage = nullptr;  // stage that was running when it tripped
+  const char *cache = nullptr;       // --cache-dir: "hit" | "stored" | "miss"
+  double cacheMs = 0.0;              // hashing the input + writing the cache entry
+  uint64_t fastArrays = 0;           // arrays read by iv_fastparse.h instead of SoInput
+  double fastParseMs = 0.0;          // locating and parsing them (within parseMs)
+  const char *ioBackend = nullptr;   // GLB writer: "io_uring" | "thread" | "sync"
+  double previewMs = 0.0;            // --preview: box pass and write, before the traversal
+  double thumbnailMs = 0.0;          // --thumbnail: render + PNG, alongside the GLB write
+  uint64_t atlasTextures = 0;        // --texture-atlas: textures packed into atlases
+  double atlasMs = 0.0;              // packing them and rewriting texture coordinates
+  std::vector<std::string> warnings; // degradations applied; surfaced by main.py
+  // --split-files / --split-assemblies: the GLBs written into the output
+  // directory.
+  struct OutputFile {
+    std::string name;   // file name in the output directory
+    std::string entry;  // archive entry, or assembly path, it was converted from
+    size_t triangleCount = 0;
+  };
+  std::vector<OutputFile> outputs;
+  SceneMetadata meta;
+};
+
+// Exit codes for runs cut short by a budget or a cancellation request. The
+// stats file (if requested) is still written, with the partial counts.
+static constexpr int kExitDeadline = 6;
+static constexpr int kExitMemory = 7;
+static constexpr int kExitCancelled = 8;
+static constexpr int kExitTriangles = 9;
+
+// kStageReduce: after traversal, saving the mesh file and --degrade's
+// reduction to the triangle budget.
+enum RunStage { kStageParse, kStageTraverse, kStageReduce, kStageWrite };
+
+// Budgets for the current run. A watchdog thread polls the clock and RSS and
+// publishes the first budget that trips in abortCode; hot paths only read that
+// atomic. SoDB::readAll and the GLB writer cannot be interrupted, so a trip in
+// those stages exits from the watchdog; traversal aborts cooperatively.
+struct RunControl {
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+  long maxRssKb = 0;  // 0 = unlimited
+  bool degrade = false;
+  std::atomic<int> stage{kStageParse};
+  std::atomic<int> abortCode{0};
+  // --degrade: set by the watchdog when RSS passes kPressureFraction of the
+  // cap during traversal; the triangle callback then compacts the geometry.
+  std::atomic<bool> memoryPressure{false};
 };
 
-static inline void updateMinMax(MeshOut &m, float x, float y, float z) {
-  if (x < m.posMin[0]) m.posMin[0] = x;
-  if (y < m.posMin[1]) m.posMin[1] = y;
-  if (z < m.posMin[2]) m.posMin[2] = z;
-  if (x > m.posMax[0]) m.posMax[0] = x;
-  if (y > m.posMax[1]) m.posMax[1] = y;
-  if (z > m.posMax[2]) m.posMax[2] = z;
+static constexpr double kPressureFraction = 0.85;
+
+static RunControl g_run;
+static std::atomic<bool> g_cancelRequested{false};
+// Texture images met during traversal, shared by every mesh of the run;
+// maxSize is --texture-max-size.
+static TextureSet g_textures;
+// The stats as of the start of the current stage. The watchdog writes these
+// when it ends the run itself: the live ones may be changing meanwhile.
+static std::mutex g_statsSnapshotMutex;
+static ConvertStats g_statsSnapshot;
+
+// Moves the run to `stage`, publishing the stats first for the stages the
+// watchdog ends itself (all but traversal, which stops cooperatively).
+static void enterStage(RunStage stage, const ConvertStats &stats) {
+  if (stage != kStageTraverse) {
+    std::lock_guard<std::mutex> lock(g_statsSnapshotMutex);
+    g_statsSnapshot = stats;
+  }
+  g_run.stage.store(stage);
+}
+
+static void onTerminateSignal(int) { g_cancelRequested.store(true); }
+
+static long currentRssKb() {
+  long pages = 0, resident = 0;
+  FILE *f = std::fopen("/proc/self/statm", "r");
+  if (!f) return 0;
+  if (std::fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+  std::fclose(f);
+  return resident * (::sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static const char *abortName(int code) {
+  switch (code) {
+    case kExitDeadline:  return "deadline";
+    case kExitMemory:    return "memory";
+    case kExitCancelled: return "cancelled";
+    case kExitTriangles: return "triangles";
+    default:             return nullptr;
+  }
+}
+
+static const char *stageName(int stage) {
+  switch (stage) {
+    case kStageParse:    return "parse";
+    case kStageTraverse: return "traverse";
+    case kStageReduce:   return "reduce";
+    default:             return "write";
+  }
+}
+
+static inline double msSince(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - t0).count();
 }
 
 static double unitsScaleToMeters(SoUnits::Units u) {
@@ -59,13 +231,174 @@ static double unitsScaleToMeters(SoUnits::Units u) {
   }
 }
 
+// Coin colours are display values, as fixed-function OpenGL shows them
+// (sRGB-encoded); glTF colour factors and COLOR_0 are linear.
+static float srgbToLinear(float c) {
+  c = std::min(std::max(c, 0.0f), 1.0f);
+  return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+// The material at `index` of the current material state, as glTF values.
+static MeshMaterial materialAt(SoCallbackAction *action, int index) {
+  SbColor ambient, diffuse, specular, emissive;
+  float shininess, transparency;
+  action->getMaterial(ambient, diffuse, specular, emissive, shininess, transparency, index);
+  MeshMaterial m;
+  for (int k = 0; k < 3; ++k) {
+    m.diffuse[k] = srgbToLinear(diffuse[k]);
+    m.emissive[k] = srgbToLinear(emissive[k]);
+  }
+  m.opacity = 1.0f - std::min(std::max(transparency, 0.0f), 1.0f);
+  return m;
+}
+
+// Quantizes linear RGB + alpha to a COLOR_0 unorm8 RGBA value.
+static uint32_t packRGBA(const float *rgb, float alpha) {
+  auto q = [](float v) { return static_cast<uint32_t>(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f); };
+  return q(rgb[0]) | q(rgb[1]) << 8 | q(rgb[2]) << 16 | q(alpha) << 24;
+}
+
+static const char *unitsName(int u) {
+  switch (u) {
+    case SoUnits::METERS:         return "METERS";
+    case SoUnits::CENTIMETERS:    return "CENTIMETERS";
+    case SoUnits::MILLIMETERS:    return "MILLIMETERS";
+    case SoUnits::MICROMETERS:    return "MICROMETERS";
+    case SoUnits::MICRONS:        return "MICRONS";
+    case SoUnits::NANOMETERS:     return "NANOMETERS";
+    case SoUnits::ANGSTROMS:      return "ANGSTROMS";
+    case SoUnits::KILOMETERS:     return "KILOMETERS";
+    case SoUnits::FEET:           return "FEET";
+    case SoUnits::INCHES:         return "INCHES";
+    case SoUnits::POINTS:         return "POINTS";
+    case SoUnits::YARDS:          return "YARDS";
+    case SoUnits::MILES:          return "MILES";
+    case SoUnits::NAUTICAL_MILES: return "NAUTICAL_MILES";
+    default:                      return "UNKNOWN";
+  }
+}
+
+// Records a shape instance for the metadata: its node (instancing), the
+// units in effect and its first material, as traversal state already holds.
+static void noteShape(SceneMetadata &meta, SoCallbackAction *action, const SoNode *node) {
+  ++meta.shapeUses[node];
+  ++meta.units[action->getUnits()];
+  SbColor ambient, diffuse, specular, emissive;
+  float shininess, transparency;
+  action->getMaterial(ambient, diffuse, specular, emissive, shininess, transparency);
+  auto q = [](float v) { return static_cast<uint32_t>(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f); };
+  ++meta.materials[q(diffuse[0]) << 24 | q(diffuse[1]) << 16 | q(diffuse[2]) << 8 | q(1.0f - transparency)];
+}
+
+// Folds the shapes not in `alive` out of shapeUses, before they are freed
+// and another node can take their address.
+static void retireShapes(SceneMetadata &meta, const std::unordered_set<const SoNode *> &alive) {
+  for (auto it = meta.shapeUses.begin(); it != meta.shapeUses.end();) {
+    if (alive.count(it->first)) {
+      ++it;
+      continue;
+    }
+    ++meta.retiredShapes;
+    if (it->second > 1) ++meta.retiredInstanced;
+    meta.retiredMaxUses = std::max(meta.retiredMaxUses, it->second);
+    it = meta.shapeUses.erase(it);
+  }
+}
+
+// Records geometry that was written; `toWorld` places it if it is kept in
+// a frame of its own (assemblies).
+static void noteWritten(SceneMetadata &meta, const MeshOut &m, const SbMatrix *toWorld = nullptr) {
+  meta.written = true;
+  meta.outputTriangles += m.triangleCount();
+  meta.outputVertices += m.vertexCount();
+  if (!m.triangleCount()) return;
+  for (int c = 0; c < 8; ++c) {
+    SbVec3f p(c & 1 ? m.posMax[0] : m.posMin[0], c & 2 ? m.posMax[1] : m.posMin[1],
+              c & 4 ? m.posMax[2] : m.posMin[2]);
+    if (toWorld) toWorld->multVecMatrix(SbVec3f(p), p);
+    extendBounds(meta.bmin, meta.bmax, p[0], p[1], p[2]);
+  }
+}
+
+// State shared by the traversal callbacks.
+struct TraverseCtx {
+  MeshOut *mesh = nullptr;
+  ConvertStats *stats = nullptr;
+  size_t maxTriangles = 0;  // 0 = unlimited
+  size_t priorTriangles = 0;  // already collected into other meshes (zip input, assemblies)
+  int compactions = 0;      // --degrade memory-pressure compactions
+  const SbMatrix *toLocal = nullptr;  // --split-assemblies: world -> current assembly frame
+  // The current part's colour (its material's diffuse + opacity, packed),
+  // whether it has switched to vertex colours, and the last material index
+  // looked up with its colour.
+  uint32_t partColor = kWhiteRGBA;
+  bool partColored = false;
+  int colorIndex = -1;
+  uint32_t color = kWhiteRGBA;
+  // The current part's base colour texture (-1: none) and the texture
+  // matrix its coordinates go through.
+  int32_t partTexture = -1;
+  SbMatrix textureMatrix;
+};
+
+// Shrinks what has been collected so far when RSS nears the cap: weld the
+// per-triangle vertices, then cluster towards the triangle budget (or half
+// the current count when there is none).
+static void relieveMemoryPressure(TraverseCtx &ctx) {
+  MeshOut &m = *ctx.mesh;
+  const uint32_t material = m.parts.empty() ? 0 : m.parts.back().material;
+  weldVertices(m);
+  const size_t target = ctx.maxTriangles > ctx.priorTriangles ? ctx.maxTriangles - ctx.priorTriangles
+                                                              : m.triangleCount() / 2;
+  clusterToBudget(m, target);
+  m.parts.emplace_back();  // the current shape continues in a fresh range
+  m.parts.back().firstIndex = static_cast<uint32_t>(m.indices.size());
+  m.parts.back().material = material;
+  ++ctx.compactions;
+}
+
+// Colour of a vertex with material index `index` (PER_FACE / PER_VERTEX
+// bindings, SoVertexProperty colours).
+static uint32_t vertexColor(TraverseCtx &ctx, SoCallbackAction *action, int index) {
+  if (index != ctx.colorIndex) {
+    const MeshMaterial m = materialAt(action, index);
+    ctx.color = packRGBA(m.diffuse, m.opacity);
+    ctx.colorIndex = index;
+  }
+  return ctx.color;
+}
+
+// Moves the current part to vertex colours: its vertices so far get the
+// part colour, every other vertex white, and its material takes diffuse
+// and opacity from COLOR_0.
+static void startVertexColors(TraverseCtx &ctx, PartRange &part) {
+  MeshOut &m = *ctx.mesh;
+  if (m.colors.empty()) m.colors.assign(m.vertexCount(), kWhiteRGBA);
+  for (uint32_t i = part.firstIndex; i < part.firstIndex + part.indexCount; ++i) {
+    m.colors[m.indices[i]] = ctx.partColor;
+  }
+  MeshMaterial mat = m.materials.empty() ? MeshMaterial() : m.materials[part.material];
+  for (int k = 0; k < 3; ++k) mat.diffuse[k] = 1.0f;
+  mat.opacity = 1.0f;
+  mat.vertexColors = true;
+  part.material = addMaterial(m, mat);
+  ctx.partColored = true;
+}
+
 // Triangle callback: called as shapes generate primitives. [web:248]
 static void triangleCB(void *userdata,
                        SoCallbackAction *action,
                        const SoPrimitiveVertex *v1,
                        const SoPrimitiveVertex *v2,
                        const SoPrimitiveVertex *v3) {
-  MeshOut *out = reinterpret_cast<MeshOut *>(userdata);
+  if (g_run.abortCode.load(std::memory_order_relaxed)) return;
+  TraverseCtx *ctx = reinterpret_cast<TraverseCtx *>(userdata);
+  if (g_run.memoryPressure.exchange(false, std::memory_order_relaxed)) {
+    relieveMemoryPressure(*ctx);
+  }
+  MeshOut *out = ctx->mesh;
+  if (out->parts.empty()) out->parts.emplace_back();
+  PartRange &part = out->parts.back();
 
   // World/model transform at this point in the scene graph. [web:248]
   const SbMatrix &model = action->getModelMatrix();
@@ -73,189 +406,2317 @@ static void triangleCB(void *userdata,
   // Unit scale from current traversal state. [web:248]
   const double scale = unitsScaleToMeters(action->getUnits());
 
-  auto pushVertex = [&](const SoPrimitiveVertex *v) -> uint32_t {
+  // A part keeps one material while its vertices share a colour: the first
+  // triangle's, which may come from state set up by the shape itself
+  // (SoVertexProperty). Colours that vary within the part (PER_FACE /
+  // PER_VERTEX bindings) go to COLOR_0 instead of one material per face.
+  const uint32_t rgba[3] = {vertexColor(*ctx, action, v1->getMaterialIndex()),
+                            vertexColor(*ctx, action, v2->getMaterialIndex()),
+                            vertexColor(*ctx, action, v3->getMaterialIndex())};
+  if (!ctx->partColored && part.indexCount == 0 && rgba[0] != ctx->partColor) {
+    MeshMaterial mat = materialAt(action, v1->getMaterialIndex());
+    mat.texture = ctx->partTexture;
+    part.material = addMaterial(*out, mat);
+    ctx->partColor = rgba[0];
+  }
+  if (!ctx->partColored && (rgba[0] != ctx->partColor || rgba[1] != ctx->partColor ||
+                            rgba[2] != ctx->partColor)) {
+    startVertexColors(*ctx, part);
+  }
+
+  auto pushVertex = [&](const SoPrimitiveVertex *v, uint32_t color) -> uint32_t {
     SbVec3f p = v->getPoint();
     SbVec3f wp;
     model.multVecMatrix(p, wp);
 
-    const float x = static_cast<float>(wp[0] * scale);
-    const float y = static_cast<float>(wp[1] * scale);
-    const float z = static_cast<float>(wp[2] * scale);
+    float x = static_cast<float>(wp[0] * scale);
+    float y = static_cast<float>(wp[1] * scale);
+    float z = static_cast<float>(wp[2] * scale);
+    if (ctx->toLocal) {
+      SbVec3f lp;
+      ctx->toLocal->multVecMatrix(SbVec3f(x, y, z), lp);
+      x = lp[0];
+      y = lp[1];
+      z = lp[2];
+    }
 
     uint32_t idx = static_cast<uint32_t>(out->positions.size() / 3);
     out->positions.push_back(x);
     out->positions.push_back(y);
     out->positions.push_back(z);
+    if (!out->colors.empty()) out->colors.push_back(ctx->partColored ? color : kWhiteRGBA);
+    if (!out->texcoords.empty()) {
+      float u = 0.0f, t = 0.0f;
+      if (ctx->partTexture >= 0) {
+        const SbVec4f &tc = v->getTextureCoords();
+        SbVec3f st;
+        ctx->textureMatrix.multVecMatrix(SbVec3f(tc[0], tc[1], tc[2]), st);
+        u = st[0];
+        t = st[1];
+      }
+      out->texcoords.push_back(u);
+      out->texcoords.push_back(1.0f - t);  // Inventor's t runs up the image, glTF's v down
+    }
     updateMinMax(*out, x, y, z);
+    extendBounds(part.bmin, part.bmax, x, y, z);
     return idx;
   };
 
-  const uint32_t i1 = pushVertex(v1);
-  const uint32_t i2 = pushVertex(v2);
-  const uint32_t i3 = pushVertex(v3);
+  const uint32_t i1 = pushVertex(v1, rgba[0]);
+  const uint32_t i2 = pushVertex(v2, rgba[1]);
+  const uint32_t i3 = pushVertex(v3, rgba[2]);
 
   out->indices.push_back(i1);
   out->indices.push_back(i2);
   out->indices.push_back(i3);
+  part.indexCount += 3;
+
+  if (ctx->maxTriangles && !g_run.degrade &&
+      ctx->priorTriangles + out->triangleCount() > ctx->maxTriangles) {
+    g_run.abortCode.store(kExitTriangles);
+  }
+}
+
+// The texture in the current state as an index into g_textures, or -1.
+// Only the image and wrap modes carry over; every texture model is taken as
+// MODULATE, the default, which is what glTF's base colour texture does.
+static int32_t currentTexture(SoCallbackAction *action) {
+  SbVec2s size;
+  int components = 0;
+  const unsigned char *data = action->getTextureImage(size, components);
+  if (!data || size[0] <= 0 || size[1] <= 0 || components < 1 || components > 4) return -1;
+  return static_cast<int32_t>(addTexture(g_textures, data, size[0], size[1], components,
+                                         action->getTextureWrapS() == SoTexture2::CLAMP,
+                                         action->getTextureWrapT() == SoTexture2::CLAMP));
+}
+
+// Shape pre-callback: counts shape instances (a USEd shape counts once per
+// use), notes them for the metadata and opens the part range its triangles
+// will go to, with the shape's material and texture.
+static SoCallbackAction::Response shapePreCB(void *userdata,
+                                             SoCallbackAction *action,
+                                             const SoNode *node) {
+  TraverseCtx *ctx = reinterpret_cast<TraverseCtx *>(userdata);
+  ++ctx->stats->shapeCount;
+  noteShape(ctx->stats->meta, action, node);
+  std::vector<PartRange> &parts = ctx->mesh->parts;
+  if (parts.empty() || parts.back().indexCount != 0) parts.emplace_back();
+  parts.back() = PartRange();
+  parts.back().firstIndex = static_cast<uint32_t>(ctx->mesh->indices.size());
+  MeshMaterial base = materialAt(action, 0);
+  base.texture = currentTexture(action);
+  if (base.texture >= 0) {
+    ctx->textureMatrix = action->getTextureMatrix();
+    if (ctx->mesh->texcoords.empty()) ctx->mesh->texcoords.assign(ctx->mesh->vertexCount() * 2, 0.0f);
+  }
+  ctx->partTexture = base.texture;
+  parts.back().material = addMaterial(*ctx->mesh, base);
+  ctx->partColor = packRGBA(base.diffuse, base.opacity);
+  ctx->partColored = false;
+  ctx->colorIndex = -1;
+  return SoCallbackAction::CONTINUE;
+}
+
+// Node pre-callback: stops the traversal once a budget has tripped.
+static SoCallbackAction::Response budgetPreCB(void *, SoCallbackAction *, const SoNode *) {
+  return g_run.abortCode.load(std::memory_order_relaxed) ? SoCallbackAction::ABORT
+                                                         : SoCallbackAction::CONTINUE;
+}
+
+// --split-assemblies: every node at a given depth below the root is an
+// assembly with its own mesh, kept in the frame the node is placed in;
+// shapes outside any assembly go to the main mesh, in world space.
+struct Assembly {
+  std::string name;  // DEF name, else type name and child index
+  std::string path;  // labels from below the root down to this node, '/'-joined
+  SbMatrix toWorld;  // assembly frame -> world, in metres
+  SbMatrix toLocal;
+  MeshOut mesh;
+};
+
+struct AssemblyTraversal {
+  TraverseCtx *ctx = nullptr;
+  MeshOut *rest = nullptr;
+  int pathLength = 0;               // getCurPath() length at an assembly node
+  std::deque<Assembly> assemblies;  // stable addresses for ctx->mesh
+};
+
+static std::string nodeLabel(const SoNode *node, int childIndex) {
+  const char *name = node->getName().getString();
+  if (name && *name) return name;
+  return std::string(node->getTypeId().getName().getString()) + "_" + std::to_string(childIndex);
+}
+
+// Model matrix at the current node followed by the unit scale: that node's
+// frame -> world space in metres.
+static SbMatrix metreModelMatrix(SoCallbackAction *action) {
+  SbMatrix units;
+  units.setScale(static_cast<float>(unitsScaleToMeters(action->getUnits())));
+  SbMatrix m = action->getModelMatrix();
+  m.multRight(units);
+  return m;
+}
+
+// Moves triangle collection to `to`, keeping the budget count right.
+static void switchMesh(TraverseCtx &ctx, MeshOut *to) {
+  ctx.priorTriangles = ctx.priorTriangles + ctx.mesh->triangleCount() - to->triangleCount();
+  ctx.mesh = to;
+}
+
+// Registered before shapePreCB, so a shape that is an assembly opens its
+// part in the assembly's mesh.
+static SoCallbackAction::Response assemblyPreCB(void *userdata, SoCallbackAction *action,
+                                                const SoNode *node) {
+  AssemblyTraversal *t = static_cast<AssemblyTraversal *>(userdata);
+  const SoPath *path = action->getCurPath();
+  if (path->getLength() != t->pathLength) return SoCallbackAction::CONTINUE;
+  t->assemblies.emplace_back();
+  Assembly &a = t->assemblies.back();
+  for (int i = 1; i < path->getLength() - 1; ++i) {
+    a.path += nodeLabel(path->getNode(i), path->getIndex(i)) + "/";
+  }
+  a.name = nodeLabel(node, path->getIndex(path->getLength() - 1));
+  a.path += a.name;
+  a.toWorld = metreModelMatrix(action);
+  a.toLocal = a.toWorld.inverse();
+  t->ctx->toLocal = &a.toLocal;
+  switchMesh(*t->ctx, &a.mesh);
+  return SoCallbackAction::CONTINUE;
+}
+
+static SoCallbackAction::Response assemblyPostCB(void *userdata, SoCallbackAction *action,
+                                                 const SoNode *) {
+  AssemblyTraversal *t = static_cast<AssemblyTraversal *>(userdata);
+  if (action->getCurPath()->getLength() != t->pathLength) return SoCallbackAction::CONTINUE;
+  t->ctx->toLocal = nullptr;
+  switchMesh(*t->ctx, t->rest);
+  return SoCallbackAction::CONTINUE;
+}
+
+// --preview: one box per shape instance, in world space and metres. The box
+// comes from the shape's own bounding-box computation (coordinates or
+// analytic extents), so no triangles are generated.
+static SbBox3f worldShapeBox(SoCallbackAction *action, const SoNode *node) {
+  SbBox3f box;
+  SbVec3f center;
+  const_cast<SoShape *>(static_cast<const SoShape *>(node))->computeBBox(action, box, center);
+  if (!box.isEmpty()) box.transform(metreModelMatrix(action));
+  return box;
+}
+
+// Collects the box only (min xyz, max xyz); writePreview picks which become
+// geometry.
+static SoCallbackAction::Response previewShapeCB(void *userdata, SoCallbackAction *action,
+                                                 const SoNode *node) {
+  const SbBox3f box = worldShapeBox(action, node);
+  if (!box.isEmpty()) {
+    const float *lo = box.getMin().getValue(), *hi = box.getMax().getValue();
+    static_cast<std::vector<std::array<float, 6>> *>(userdata)->push_back(
+        {lo[0], lo[1], lo[2], hi[0], hi[1], hi[2]});
+  }
+  return SoCallbackAction::PRUNE;
+}
+
+// --metadata-only: notes each shape instance and its world bounds the way
+// --preview gets them, without generating triangles.
+static SoCallbackAction::Response metadataShapeCB(void *userdata, SoCallbackAction *action,
+                                                  const SoNode *node) {
+  ConvertStats *stats = static_cast<ConvertStats *>(userdata);
+  ++stats->shapeCount;
+  noteShape(stats->meta, action, node);
+  const SbBox3f box = worldShapeBox(action, node);
+  if (!box.isEmpty()) {
+    const SbVec3f &lo = box.getMin(), &hi = box.getMax();
+    extendBounds(stats->meta.bmin, stats->meta.bmax, lo[0], lo[1], lo[2]);
+    extendBounds(stats->meta.bmin, stats->meta.bmax, hi[0], hi[1], hi[2]);
+  }
+  return SoCallbackAction::PRUNE;
+}
+
+// --proxy-boxes: one box per shape instance, or per node at a given depth
+// below the root (shapes outside such nodes keep a box each). A box is kept
+// in the frame its node is placed in, so it can be written oriented.
+struct ProxyBox {
+  std::string name;  // nodeLabel() of the shape or group node
+  SbMatrix frame;    // box frame -> world, in metres
+  SbMatrix toFrame;  // inverse, for shapes collected into a group box
+  SbBox3f box;
+};
+
+struct ProxyTraversal {
+  ConvertStats *stats = nullptr;
+  int pathLength = 0;  // getCurPath() length at a group node; 0 = per shape
+  std::vector<ProxyBox> boxes;
+  int open = -1;       // group box being collected into
+};
+
+static SoCallbackAction::Response proxyGroupPreCB(void *userdata, SoCallbackAction *action,
+                                                  const SoNode *node) {
+  ProxyTraversal *t = static_cast<ProxyTraversal *>(userdata);
+  const SoPath *path = action->getCurPath();
+  if (path->getLength() != t->pathLength) return SoCallbackAction::CONTINUE;
+  t->boxes.emplace_back();
+  ProxyBox &b = t->boxes.back();
+  b.name = nodeLabel(node, path->getIndex(path->getLength() - 1));
+  b.frame = metreModelMatrix(action);
+  b.toFrame = b.frame.inverse();
+  t->open = static_cast<int>(t->boxes.size() - 1);
+  return SoCallbackAction::CONTINUE;
+}
+
+static SoCallbackAction::Response proxyGroupPostCB(void *userdata, SoCallbackAction *action,
+                                                   const SoNode *) {
+  ProxyTraversal *t = static_cast<ProxyTraversal *>(userdata);
+  if (action->getCurPath()->getLength() != t->pathLength) return SoCallbackAction::CONTINUE;
+  if (t->open >= 0 && t->boxes[t->open].box.isEmpty()) t->boxes.pop_back();
+  t->open = -1;
+  return SoCallbackAction::CONTINUE;
+}
+
+// Registered after proxyGroupPreCB, so a shape that is a group node goes
+// into its own group box.
+static SoCallbackAction::Response proxyShapeCB(void *userdata, SoCallbackAction *action,
+                                               const SoNode *node) {
+  ProxyTraversal *t = static_cast<ProxyTraversal *>(userdata);
+  ++t->stats->shapeCount;
+  noteShape(t->stats->meta, action, node);
+  SbBox3f box;
+  SbVec3f center;
+  const_cast<SoShape *>(static_cast<const SoShape *>(node))->computeBBox(action, box, center);
+  if (box.isEmpty()) return SoCallbackAction::PRUNE;
+  SbMatrix frame = metreModelMatrix(action);
+  if (t->open >= 0) {
+    ProxyBox &g = t->boxes[t->open];
+    frame.multRight(g.toFrame);
+    box.transform(frame);
+    g.box.extendBy(box);
+  } else {
+    const SoPath *path = action->getCurPath();
+    t->boxes.emplace_back();
+    ProxyBox &b = t->boxes.back();
+    b.name = nodeLabel(node, path->getIndex(path->getLength() - 1));
+    b.frame = frame;
+    b.box = box;
+  }
+  return SoCallbackAction::PRUNE;
+}
+
+// Walks the graph once, counting unique nodes and references to them.
+// nodeRefCount / nodeCount is the DEF/USE (instancing) ratio. If `named` is
+// given, nodes carrying a DEF name are appended to it.
+static void countNodes(SoNode *root, ConvertStats &stats,
+                       std::vector<SoNode *> *named = nullptr) {
+  std::unordered_set<const SoNode *> seen;
+  std::vector<SoNode *> stack{root};
+  while (!stack.empty()) {
+    SoNode *n = stack.back();
+    stack.pop_back();
+    ++stats.nodeRefCount;
+    if (!seen.insert(n).second) continue;
+    ++stats.nodeCount;
+    if (named && n->getName().getLength() > 0) named->push_back(n);
+    if (SoChildList *kids = n->getChildren()) {
+      for (int i = 0; i < kids->getLength(); ++i) stack.push_back((*kids)[i]);
+    }
+  }
+}
+
+// Named top-level parts for the metadata: the DEF'd children of the root,
+// looking through the single-group wrappers most files (and readAll) add.
+static constexpr size_t kMaxTopLevelParts = 1000;
+
+static void collectTopLevelParts(SoNode *root, std::vector<std::string> &names) {
+  SoNode *n = root;
+  while (n->getChildren() && n->getChildren()->getLength() == 1 &&
+         (*n->getChildren())[0]->getChildren()) {
+    n = (*n->getChildren())[0];
+  }
+  SoChildList *kids = n->getChildren();
+  for (int i = 0; kids && i < kids->getLength() && names.size() < kMaxTopLevelParts; ++i) {
+    const SbName &name = (*kids)[i]->getName();
+    if (name.getLength() > 0) names.push_back(name.getString());
+  }
+}
+
+static std::string jsonEscape(const std::string &s) {
+  std::string out;
+  out.reserve(s.size() + 2);
+  for (const char ch : s) {
+    const unsigned char c = static_cast<unsigned char>(ch);
+    switch (c) {
+      case '"':  out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        if (c < 0x20) {
+          char buf[8];
+          std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+          out += buf;
+        } else {
+          out.push_back(ch);
+        }
+    }
+  }
+  return out;
+}
+
+static void writeScanJson(const ScanResult &r, double scanMs, FILE *f) {
+  std::fprintf(f,
+               "{\"valid\":%s,\"kind\":\"%s\",\"format\":\"%s\",\"header\":\"%s\",\"error\":%s,"
+               "\"bytes\":%llu,\"compressedBytes\":%llu,\"nodes\":%llu,\"defs\":%llu,\"uses\":%llu,"
+               "\"shapes\":%llu,\"coordinates\":%llu,\"faceIndices\":%llu,"
+               "\"faces\":%llu,\"triangleEstimate\":%llu,\"largestArray\":%llu,"
+               "\"maxDepth\":%d,\"entries\":%llu,\"scanMs\":%.3f}\n",
+               r.valid ? "true" : "false", r.kind.c_str(), r.format.c_str(),
+               jsonEscape(r.header).c_str(),
+               r.error.empty() ? "null" : ("\"" + jsonEscape(r.error) + "\"").c_str(),
+               static_cast<unsigned long long>(r.bytes),
+               static_cast<unsigned long long>(r.compressedBytes),
+               static_cast<unsigned long long>(r.nodes),
+               static_cast<unsigned long long>(r.defs),
+               static_cast<unsigned long long>(r.uses),
+               static_cast<unsigned long long>(r.shapes),
+               static_cast<unsigned long long>(r.coordinates),
+               static_cast<unsigned long long>(r.faceIndices),
+               static_cast<unsigned long long>(r.faces),
+               static_cast<unsigned long long>(r.triangleEstimate),
+               static_cast<unsigned long long>(r.largestArray),
+               r.maxDepth, static_cast<unsigned long long>(r.entries), scanMs);
+}
+
+// --scan of a zip: only the central directory is read. `bytes` is the
+// inflated size of the model entries, so size limits apply to what would
+// actually be parsed rather than to the compressed upload.
+static int runZipScan(const std::string &inPath) {
+  const auto t0 = std::chrono::steady_clock::now();
+  ScanResult res;
+  res.kind = "zip";
+  ZipArchive zip;
+  if (zip.open(inPath, res.error)) {
+    for (const ZipEntry &e : zip.entries()) {
+      if (!isZipModelEntry(e)) continue;
+      ++res.entries;
+      res.bytes += e.size;
+    }
+    res.valid = res.entries > 0;
+    if (!res.valid) res.error = "zip archive contains no .iv/.wrl entries";
+  }
+  writeScanJson(res, msSince(t0), stdout);
+  return res.valid ? 0 : 4;
+}
+
+// --scan: header check and structural counts without SoDB. Exit code 4
+// (same as a failed readAll) when the input is malformed.
+static int runScan(const std::string &inPath) {
+  const bool fromStdin = inPath == "-";
+  if (!fromStdin && isZipFile(inPath)) return runZipScan(inPath);
+  // gzip / zstd: scanned through the same streaming decoder the conversion
+  // uses, so counts and `bytes` describe the decompressed content. stdin
+  // goes the same way, as it is only known to be compressed once read.
+  if (fromStdin || isCompressedFile(inPath)) {
+    const auto t0 = std::chrono::steady_clock::now();
+    Compression compression = Compression::kNone;
+    FILE *fp = openInputStream(inPath, nullptr, &compression);
+    if (!fp) {
+      std::fprintf(stderr, "Failed to open input file: %s\n", inPath.c_str());
+      return 3;
+    }
+    ScanResult res;
+    ScanReader r(fp);
+    bool ok = scanInventor(r, res);
+    if (std::ferror(fp)) {
+      res.error = std::string("truncated or corrupt ") +
+                  (compression == Compression::kNone ? "input" : compressionName(compression)) + " data";
+      res.valid = ok = false;
+    }
+    std::fclose(fp);
+    if (compression != Compression::kNone) {
+      struct stat st;
+      if (!fromStdin && ::stat(inPath.c_str(), &st) == 0) {
+        res.compressedBytes = static_cast<uint64_t>(st.st_size);
+      }
+      res.kind = compressionName(compression);
+    }
+    writeScanJson(res, msSince(t0), stdout);
+    return ok ? 0 : 4;
+  }
+  const int fd = ::open(inPath.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::fprintf(stderr, "Failed to open input file: %s\n", inPath.c_str());
+    return 3;
+  }
+  ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  const auto t0 = std::chrono::steady_clock::now();
+  ScanResult res;
+  const bool ok = scanInventor(fd, res);
+  ::close(fd);
+  writeScanJson(res, msSince(t0), stdout);
+  return ok ? 0 : 4;
+}
+
+// Materials listed in the metadata, most used first; materialCount has them all.
+static constexpr size_t kMaxMetadataMaterials = 256;
+
+// The "metadata" object of the job output; also what --metadata-only prints.
+static std::string metadataJson(const ConvertStats &st) {
+  const SceneMetadata &m = st.meta;
+  char buf[512];
+  std::string out = "{\"bounds\":";
+  if (m.bmin[0] <= m.bmax[0]) {
+    std::snprintf(buf, sizeof(buf), "{\"min\":[%.9g,%.9g,%.9g],\"max\":[%.9g,%.9g,%.9g]}", m.bmin[0],
+                  m.bmin[1], m.bmin[2], m.bmax[0], m.bmax[1], m.bmax[2]);
+    out += buf;
+  } else {
+    out += "null";
+  }
+  uint64_t instanced = m.retiredInstanced;
+  uint32_t maxUses = m.retiredMaxUses;
+  for (const auto &e : m.shapeUses) {
+    if (e.second > 1) ++instanced;
+    maxUses = std::max(maxUses, e.second);
+  }
+  std::snprintf(buf, sizeof(buf),
+                ",\"triangleCount\":%llu,\"shapeCount\":%llu,\"uniqueShapeCount\":%llu,"
+                "\"instancedShapeCount\":%llu,\"maxShapeUses\":%u,\"nodeCount\":%llu,"
+                "\"nodeRefCount\":%llu,\"defUseRatio\":%.4f",
+                static_cast<unsigned long long>(st.triangleCount),
+                static_cast<unsigned long long>(st.shapeCount),
+                static_cast<unsigned long long>(m.retiredShapes + m.shapeUses.size()),
+                static_cast<unsigned long long>(instanced), maxUses,
+                static_cast<unsigned long long>(st.nodeCount),
+                static_cast<unsigned long long>(st.nodeRefCount),
+                st.nodeCount ? static_cast<double>(st.nodeRefCount) / st.nodeCount : 0.0);
+  out += buf;
+  if (m.written) {
+    std::snprintf(buf, sizeof(buf), ",\"outputTriangleCount\":%llu,\"outputVertexCount\":%llu",
+                  static_cast<unsigned long long>(m.outputTriangles),
+                  static_cast<unsigned long long>(m.outputVertices));
+    out += buf;
+  } else {
+    out += ",\"outputTriangleCount\":null,\"outputVertexCount\":null";
+  }
+  out += ",\"units\":{";
+  for (const auto &u : m.units) {
+    if (out.back() != '{') out += ",";
+    out += "\"" + std::string(unitsName(u.first)) + "\":" + std::to_string(u.second);
+  }
+  std::vector<std::pair<uint32_t, uint64_t>> materials(m.materials.begin(), m.materials.end());
+  std::stable_sort(materials.begin(), materials.end(),
+                   [](const auto &a, const auto &b) { return a.second > b.second; });
+  if (materials.size() > kMaxMetadataMaterials) materials.resize(kMaxMetadataMaterials);
+  out += "},\"materials\":[";
+  for (const auto &mat : materials) {
+    const uint32_t c = mat.first;
+    std::snprintf(buf, sizeof(buf), "%s{\"diffuse\":[%.4g,%.4g,%.4g],\"opacity\":%.4g,\"shapeCount\":%llu}",
+                  out.back() == '[' ? "" : ",", (c >> 24) / 255.0, (c >> 16 & 0xff) / 255.0,
+                  (c >> 8 & 0xff) / 255.0, (c & 0xff) / 255.0, static_cast<unsigned long long>(mat.second));
+    out += buf;
+  }
+  out += "],\"materialCount\":" + std::to_string(m.materials.size()) + ",\"topLevelParts\":[";
+  for (size_t i = 0; i < m.topLevelParts.size(); ++i) {
+    out += (i ? ",\"" : "\"") + jsonEscape(m.topLevelParts[i]) + "\"";
+  }
+  return out + "]}";
+}
+
+static bool writeStatsJson(const ConvertStats &st, const std::string &path) {
+  FILE *f = std::fopen(path.c_str(), "w");
+  if (!f) return false;
+  const double defUseRatio =
+      st.nodeCount ? static_cast<double>(st.nodeRefCount) / st.nodeCount : 0.0;
+  std::string warnings;
+  for (const std::string &w : st.warnings) {
+    if (!warnings.empty()) warnings += ",";
+    warnings += "\"" + jsonEscape(w) + "\"";
+  }
+  std::string outputs;
+  for (const ConvertStats::OutputFile &o : st.outputs) {
+    if (!outputs.empty()) outputs += ",";
+    outputs += "{\"name\":\"" + jsonEscape(o.name) + "\",\"entry\":\"" + jsonEscape(o.entry) +
+               "\",\"triangleCount\":" + std::to_string(o.triangleCount) + "}";
+  }
+  std::fprintf(f,
+               "{\"inputBytes\":%llu,\"nodeCount\":%llu,\"nodeRefCount\":%llu,"
+               "\"defUseRatio\":%.4f,\"shapeCount\":%llu,\"triangleCount\":%llu,"
+               "\"parseMs\":%.3f,\"traverseMs\":%.3f,\"writeMs\":%.3f,\"saveMeshMs\":%.3f,"
+               "\"peakRssKb\":%ld,\"aborted\":%s%s%s,\"abortStage\":%s%s%s,"
+               "\"cache\":%s%s%s,\"cacheMs\":%.3f,\"fastArrays\":%llu,\"fastParseMs\":%.3f,"
+               "\"ioBackend\":%s%s%s,\"previewMs\":%.3f,\"thumbnailMs\":%.3f,"
+               "\"atlasTextures\":%llu,\"atlasMs\":%.3f,\"warnings\":[%s],\"outputs\":[%s],\"metadata\":%s}\n",
+               static_cast<unsigned long long>(st.inputBytes),
+               static_cast<unsigned long long>(st.nodeCount),
+               static_cast<unsigned long long>(st.nodeRefCount),
+               defUseRatio,
+               static_cast<unsigned long long>(st.shapeCount),
+               static_cast<unsigned long long>(st.triangleCount),
+               st.parseMs, st.traverseMs, st.writeMs, st.saveMeshMs, st.peakRssKb,
+               st.aborted ? "\"" : "", st.aborted ? st.aborted : "null", st.aborted ? "\"" : "",
+               st.abortStage ? "\"" : "", st.abortStage ? st.abortStage : "null",
+               st.abortStage ? "\"" : "",
+               st.cache ? "\"" : "", st.cache ? st.cache : "null", st.cache ? "\"" : "", st.cacheMs,
+               static_cast<unsigned long long>(st.fastArrays), st.fastParseMs,
+               st.ioBackend ? "\"" : "", st.ioBackend ? st.ioBackend : "null", st.ioBackend ? "\"" : "",
+               st.previewMs, st.thumbnailMs, static_cast<unsigned long long>(st.atlasTextures),
+               st.atlasMs, warnings.c_str(), outputs.c_str(), metadataJson(st).c_str());
+  return std::fclose(f) == 0;
 }
 
-static bool writeGLB(const MeshOut &mesh, const std::string &outPath, std::string &err) {
-  if (mesh.positions.empty() || mesh.indices.empty()) {
+static void finishStats(ConvertStats &stats, const std::string &statsPath) {
+  if (statsPath.empty()) return;
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) == 0) stats.peakRssKb = ru.ru_maxrss;  // KiB on Linux
+  if (!writeStatsJson(stats, statsPath)) {
+    std::fprintf(stderr, "Warning: could not write stats to %s\n", statsPath.c_str());
+  }
+}
+
+// Records why the run was cut short, writes partial stats and returns the
+// exit code to use.
+static int abortRun(ConvertStats &stats, const std::string &statsPath, int code) {
+  stats.aborted = abortName(code);
+  stats.abortStage = stageName(g_run.stage.load());
+  finishStats(stats, statsPath);
+  if (code == kExitCancelled) {
+    std::fprintf(stderr, "Cancelled during %s\n", stats.abortStage);
+  } else {
+    std::fprintf(stderr, "Aborted during %s: %s budget exceeded\n", stats.abortStage, stats.aborted);
+  }
+  return code;
+}
+
+// Ends the run from the watchdog: removes partial outputs and writes the
+// stats published at the start of the current stage.
+[[noreturn]] static void exitFromWatchdog(const std::string &statsPath, int code) {
+  ConvertStats snapshot;
+  {
+    std::lock_guard<std::mutex> lock(g_statsSnapshotMutex);
+    snapshot = g_statsSnapshot;
+  }
+  removePartialFiles();
+  std::_Exit(abortRun(snapshot, statsPath, code));
+}
+
+// Polls budgets every 20 ms until `done`. Parse/reduce/write trips exit the
+// process from here, with the stats as of the stage's start (enterStage);
+// traversal trips are left to the pre-callback, with a hard exit if it does
+// not get there within a grace period (e.g. one huge shape still emitting
+// triangles).
+static void watchdogLoop(std::string statsPath, std::atomic<bool> *done) {
+  using clock = std::chrono::steady_clock;
+  clock::time_point trippedAt;
+  clock::time_point lastPressure;
+  while (!done->load()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    int code = g_run.abortCode.load();
+    if (!code && g_run.degrade && g_run.maxRssKb && g_run.stage.load() == kStageTraverse &&
+        clock::now() - lastPressure > std::chrono::seconds(1) &&
+        currentRssKb() > static_cast<long>(g_run.maxRssKb * kPressureFraction)) {
+      g_run.memoryPressure.store(true);
+      lastPressure = clock::now();
+    }
+    if (!code) {
+      if (g_cancelRequested.load()) code = kExitCancelled;
+      else if (clock::now() > g_run.deadline) code = kExitDeadline;
+      else if (g_run.maxRssKb && currentRssKb() > g_run.maxRssKb) code = kExitMemory;
+      if (!code) continue;
+      g_run.abortCode.store(code);
+      trippedAt = clock::now();
+    }
+    if (done->load()) return;
+    if (g_run.stage.load() != kStageTraverse) exitFromWatchdog(statsPath, code);
+    if (clock::now() - trippedAt > std::chrono::seconds(2)) {
+      std::fprintf(stderr, "Aborted during traverse: budget exceeded (forced)\n");
+      exitFromWatchdog(statsPath, code);
+    }
+  }
+}
+
+// One glTF mesh + node in the written scene.
+struct SceneMesh {
+  std::string name;  // node/mesh name; empty = unnamed
+  const MeshOut *mesh = nullptr;
+  const InstanceSet *instances = nullptr;  // drawn once per instance (EXT_mesh_gpu_instancing)
+};
+
+// Where the "OK: wrote" line goes: stderr when the GLB itself is on stdout.
+static FILE *reportStream(const std::string &outPath) { return outPath == "-" ? stderr : stdout; }
+
+// --chunk-triangles: meshes above this many triangles are split into
+// spatial chunks (spatial_chunks.h), one glTF mesh and node each. 0 = off.
+static size_t g_chunkTriangles = 0;
+
+// .gltf output: each mesh's data starts on this boundary of the .bin, so one
+// HTTP Range request returns exactly that mesh and no two meshes share a page.
+static constexpr size_t kRangeAlign = 4096;
+
+static bool isGltfPath(const std::string &path) {
+  return path.size() > 5 && path.compare(path.size() - 5, 5, ".gltf") == 0;
+}
+
+// model.gltf -> model.bin
+static std::string gltfBinPath(const std::string &gltfPath) {
+  return gltfPath.substr(0, gltfPath.size() - 5) + ".bin";
+}
+
+// --thumbnail: a PNG of what is exported (thumbnail.h), rendered on a thread
+// of its own while the GLB is written. Empty = off.
+static std::string g_thumbnailPath;
+static int g_thumbnailSize = 256;
+
+// One --thumbnail render in flight; joined at the latest on destruction, so
+// an export that fails part-way does not leave it running.
+struct ThumbnailTask {
+  std::thread thread;
+  std::string err;
+  double ms = 0.0;
+
+  ~ThumbnailTask() {
+    if (thread.joinable()) thread.join();
+  }
+  void start(std::vector<ThumbSource> sources) {
+    if (g_thumbnailPath.empty()) return;
+    thread = std::thread([this, sources = std::move(sources)]() {
+      const auto t0 = std::chrono::steady_clock::now();
+      if (renderThumbnail(sources, g_thumbnailSize, g_thumbnailPath, err)) ms = msSince(t0);
+    });
+  }
+  // Joins and reports; a failed thumbnail is a warning, not a failed export.
+  void finish(ConvertStats &stats) {
+    if (!thread.joinable()) return;
+    thread.join();
+    if (!err.empty()) stats.warnings.push_back("Thumbnail not written: " + err);
+    stats.thumbnailMs = ms;
+  }
+};
+
+// --texture-atlas: packs the small textures of everything about to be
+// written into shared atlases (texture_atlas.h), before the writes, which
+// only read g_textures.
+static void atlasTextures(const std::vector<MeshOut *> &meshes, ConvertStats &stats) {
+  if (!g_textures.atlas) return;
+  const auto t0 = std::chrono::steady_clock::now();
+  stats.atlasTextures += packTextureAtlases(meshes, g_textures);
+  stats.atlasMs += msSince(t0);
+}
+
+static std::vector<ThumbSource> thumbSources(const std::vector<SceneMesh> &meshes) {
+  std::vector<ThumbSource> sources(meshes.size());
+  for (size_t i = 0; i < meshes.size(); ++i) sources[i].mesh = meshes[i].mesh;
+  return sources;
+}
+
+// Lists `name` in extensionsUsed and extensionsRequired, once.
+static void requireExtension(tinygltf::Model &model, const char *name) {
+  if (std::find(model.extensionsUsed.begin(), model.extensionsUsed.end(), name) != model.extensionsUsed.end()) return;
+  model.extensionsUsed.push_back(name);
+  model.extensionsRequired.push_back(name);
+}
+
+// Encodes `images` (encodeTexture) on up to `threads` threads, 0 = one per
+// core, one image at a time each.
+static void encodeImages(const std::vector<TextureImage *> &images, unsigned threads) {
+  std::atomic<size_t> next{0};
+  auto encodeAll = [&]() {
+    for (size_t i; (i = next.fetch_add(1)) < images.size();) {
+      encodeTexture(*images[i], g_textures.maxSize, g_textures.format);
+    }
+  };
+  if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+  const size_t workers = std::min<size_t>(images.size(), threads);
+  std::vector<std::thread> pool;
+  for (size_t w = 1; w < workers; ++w) pool.emplace_back(encodeAll);
+  encodeAll();
+  for (std::thread &t : pool) t.join();
+}
+
+// Writes the GLB to `outPath` ("-" = stdout) in one sequential pass
+// (glb_writer.h): the BIN chunk is streamed straight from the meshes rather
+// than packed into a buffer first. Each mesh gets one primitive per material
+// its parts use, over one shared vertex buffer. Textures the materials use
+// are encoded to PNG in parallel and follow the meshes in the BIN chunk. An
+// `outPath` ending in .gltf gets JSON plus one .bin next to it instead, laid
+// out for range requests: per mesh, positions, vertex colours and texture
+// coordinates (if any) then indices, contiguous and kRangeAlign-aligned,
+// with the range in the mesh's extras.byteRange ([offset, length]); the
+// images come after the last mesh. `ioBackend`, if given, receives which
+// I/O path did the writing; `encodeThreads` bounds the texture encoders
+// (0 = one per core).
+static bool writeGLB(const std::vector<SceneMesh> &meshes, const std::string &outPath,
+                     std::string &err, const char **ioBackend = nullptr, unsigned encodeThreads = 0) {
+  size_t totalBytes = 0;
+  for (const SceneMesh &sm : meshes) {
+    totalBytes += sm.mesh->positions.size() * sizeof(float) + sm.mesh->indices.size() * sizeof(uint32_t);
+  }
+  if (totalBytes == 0) {
     err = "No triangles extracted from scene graph.";
     return false;
   }
+  const bool gltf = isGltfPath(outPath);
+
+  std::vector<std::vector<MeshOut>> chunkStore;
+  std::vector<SceneMesh> chunked;
+  if (g_chunkTriangles) {
+    chunkStore.reserve(meshes.size());
+    for (const SceneMesh &sm : meshes) {
+      if (sm.mesh->parts.empty() || sm.mesh->triangleCount() <= g_chunkTriangles) {
+        chunked.push_back(sm);
+        continue;
+      }
+      chunkStore.push_back(splitSpatialChunks(*sm.mesh, g_chunkTriangles));
+      const std::string base = sm.name.empty() ? "chunk" : sm.name + "_chunk";
+      for (size_t k = 0; k < chunkStore.back().size(); ++k) {
+        chunked.push_back({base + std::to_string(k), &chunkStore.back()[k]});
+      }
+    }
+  }
+  const std::vector<SceneMesh> &written = g_chunkTriangles ? chunked : meshes;
 
   tinygltf::Model model;
   model.asset.version = "2.0";
   model.asset.generator = "coin3d-iv2glb-mvp";
 
-  // --- Pack buffers ---
-  const size_t posBytes = mesh.positions.size() * sizeof(float);
-  const size_t idxBytes = mesh.indices.size() * sizeof(uint32_t);
-
-  tinygltf::Buffer buffer;
-  buffer.data.resize(posBytes + idxBytes);
-
-  // positions at offset 0
-  std::memcpy(buffer.data.data(), mesh.positions.data(), posBytes);
-  // indices after positions
-  std::memcpy(buffer.data.data() + posBytes, mesh.indices.data(), idxBytes);
-
-  model.buffers.push_back(std::move(buffer));
-
-  // BufferView: positions
-  tinygltf::BufferView bvPos;
-  bvPos.buffer = 0;
-  bvPos.byteOffset = 0;
-  bvPos.byteLength = posBytes;
-  bvPos.target = TINYGLTF_TARGET_ARRAY_BUFFER;
-  model.bufferViews.push_back(bvPos);
-  const int bvPosIndex = static_cast<int>(model.bufferViews.size() - 1);
-
-  // BufferView: indices
-  tinygltf::BufferView bvIdx;
-  bvIdx.buffer = 0;
-  bvIdx.byteOffset = posBytes;
-  bvIdx.byteLength = idxBytes;
-  bvIdx.target = TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER;
-  model.bufferViews.push_back(bvIdx);
-  const int bvIdxIndex = static_cast<int>(model.bufferViews.size() - 1);
-
-  // Accessor: positions
-  tinygltf::Accessor accPos;
-  accPos.bufferView = bvPosIndex;
-  accPos.byteOffset = 0;
-  accPos.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
-  accPos.count = mesh.positions.size() / 3;
-  accPos.type = TINYGLTF_TYPE_VEC3;
-  accPos.minValues = { mesh.posMin[0], mesh.posMin[1], mesh.posMin[2] };
-  accPos.maxValues = { mesh.posMax[0], mesh.posMax[1], mesh.posMax[2] };
-  model.accessors.push_back(accPos);
-  const int accPosIndex = static_cast<int>(model.accessors.size() - 1);
-
-  // Accessor: indices
-  tinygltf::Accessor accIdx;
-  accIdx.bufferView = bvIdxIndex;
-  accIdx.byteOffset = 0;
-  accIdx.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
-  accIdx.count = mesh.indices.size();
-  accIdx.type = TINYGLTF_TYPE_SCALAR;
-  model.accessors.push_back(accIdx);
-  const int accIdxIndex = static_cast<int>(model.accessors.size() - 1);
-
-  // Default material (plain grey)
-  tinygltf::Material mat;
-  mat.pbrMetallicRoughness.baseColorFactor = {0.8, 0.8, 0.8, 1.0};
-  mat.pbrMetallicRoughness.metallicFactor = 0.0;
-  mat.pbrMetallicRoughness.roughnessFactor = 1.0;
-  model.materials.push_back(mat);
-  const int matIndex = static_cast<int>(model.materials.size() - 1);
-
-  // Primitive
-  tinygltf::Primitive prim;
-  prim.attributes["POSITION"] = accPosIndex;
-  prim.indices = accIdxIndex;
-  prim.material = matIndex;
-  prim.mode = TINYGLTF_MODE_TRIANGLES;
-
-  // Mesh
-  tinygltf::Mesh gltfMesh;
-  gltfMesh.primitives.push_back(prim);
-  model.meshes.push_back(gltfMesh);
-  const int meshIndex = static_cast<int>(model.meshes.size() - 1);
-
-  // Node
-  tinygltf::Node node;
-  node.mesh = meshIndex;
-  model.nodes.push_back(node);
-  const int nodeIndex = static_cast<int>(model.nodes.size() - 1);
+  // --- BIN chunk: per mesh, positions then indices ---
+  GlbBin bin;
+
+  // Textures of the materials written: glTF textures, one sampler per wrap
+  // combination and one image per distinct g_textures image, whose data is
+  // added once the meshes are laid out.
+  std::unordered_map<uint32_t, int> textureIds, imageIds;
+  std::map<std::pair<bool, bool>, int> samplerIds;
+  std::vector<TextureImage *> images;  // per model.images entry
+  auto gltfTexture = [&](uint32_t index) -> int {
+    const auto ins = textureIds.emplace(index, static_cast<int>(model.textures.size()));
+    if (!ins.second) return ins.first->second;
+    const TextureRef &ref = g_textures.textures[index];
+    const auto sampler = samplerIds.emplace(std::make_pair(ref.clampS, ref.clampT),
+                                            static_cast<int>(model.samplers.size()));
+    if (sampler.second) {
+      tinygltf::Sampler smp;
+      smp.magFilter = TINYGLTF_TEXTURE_FILTER_LINEAR;
+      smp.minFilter = TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_LINEAR;
+      smp.wrapS = ref.clampS ? TINYGLTF_TEXTURE_WRAP_CLAMP_TO_EDGE : TINYGLTF_TEXTURE_WRAP_REPEAT;
+      smp.wrapT = ref.clampT ? TINYGLTF_TEXTURE_WRAP_CLAMP_TO_EDGE : TINYGLTF_TEXTURE_WRAP_REPEAT;
+      model.samplers.push_back(smp);
+    }
+    const auto image = imageIds.emplace(ref.image, static_cast<int>(model.images.size()));
+    if (image.second) {
+      model.images.emplace_back();
+      images.push_back(&g_textures.images[ref.image]);
+    }
+    tinygltf::Texture t;
+    t.sampler = sampler.first->second;
+    t.source = image.first->second;
+    model.textures.push_back(t);
+    return ins.first->second;
+  };
+
+  // Materials, shared by all meshes; a mesh without any gets Coin's default
+  // grey. Translucent ones (opacity, COLOR_0 alpha or texture alpha) blend.
+  MeshMaterial grey;
+  for (float &c : grey.diffuse) c = srgbToLinear(0.8f);
+  std::map<std::pair<MaterialKey, bool>, int> materialIds;
+  auto gltfMaterial = [&](const MeshMaterial &mm, bool blend) -> int {
+    const auto ins = materialIds.emplace(std::make_pair(mm.key(), blend), static_cast<int>(model.materials.size()));
+    if (!ins.second) return ins.first->second;
+    tinygltf::Material mat;
+    mat.pbrMetallicRoughness.baseColorFactor = {mm.diffuse[0], mm.diffuse[1], mm.diffuse[2], mm.opacity};
+    mat.pbrMetallicRoughness.metallicFactor = 0.0;
+    mat.pbrMetallicRoughness.roughnessFactor = 1.0;
+    mat.emissiveFactor = {mm.emissive[0], mm.emissive[1], mm.emissive[2]};
+    if (mm.texture >= 0) {
+      mat.pbrMetallicRoughness.baseColorTexture.index = gltfTexture(static_cast<uint32_t>(mm.texture));
+      if (g_textures.images[g_textures.textures[mm.texture].image].alpha) blend = true;
+    }
+    if (blend || mm.opacity < 1.0f) mat.alphaMode = "BLEND";
+    model.materials.push_back(mat);
+    return ins.first->second;
+  };
+  // Index orders grouped by material, for meshes whose parts interleave
+  // materials; they must outlive the write like the meshes themselves.
+  std::deque<std::vector<uint32_t>> groupedIndices;
 
-  // Scene
   tinygltf::Scene scene;
-  scene.nodes.push_back(nodeIndex);
+  for (const SceneMesh &sm : written) {
+    const MeshOut &mesh = *sm.mesh;
+    if (mesh.positions.empty() || mesh.indices.empty()) continue;
+    const size_t posBytes = mesh.positions.size() * sizeof(float);
+    const size_t idxBytes = mesh.indices.size() * sizeof(uint32_t);
+    const size_t start = gltf ? bin.align(kRangeAlign) : bin.bytes;
+
+    // One primitive per material: the parts' triangles grouped by material,
+    // each group a range of the index bufferView.
+    struct Group {
+      uint32_t material;
+      size_t first = 0, count = 0;  // in indices
+    };
+    std::vector<Group> groups;
+    const uint32_t *indexData = mesh.indices.data();
+    size_t covered = 0;
+    for (const PartRange &p : mesh.parts) covered += p.indexCount;
+    if (mesh.materials.empty() || covered != mesh.indices.size()) {
+      groups.push_back({UINT32_MAX, 0, mesh.indices.size()});
+    } else {
+      std::vector<uint32_t> order(mesh.parts.size());
+      for (size_t i = 0; i < order.size(); ++i) order[i] = static_cast<uint32_t>(i);
+      std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return mesh.parts[a].material < mesh.parts[b].material;
+      });
+      bool inPlace = true;
+      size_t at = 0;
+      for (const uint32_t i : order) {
+        const PartRange &p = mesh.parts[i];
+        if (!p.indexCount) continue;
+        if (p.firstIndex != at) inPlace = false;
+        if (groups.empty() || groups.back().material != p.material) groups.push_back({p.material, at, 0});
+        groups.back().count += p.indexCount;
+        at += p.indexCount;
+      }
+      if (!inPlace) {
+        groupedIndices.emplace_back();
+        std::vector<uint32_t> &sorted = groupedIndices.back();
+        sorted.reserve(mesh.indices.size());
+        for (const uint32_t i : order) {
+          const PartRange &p = mesh.parts[i];
+          sorted.insert(sorted.end(), mesh.indices.begin() + p.firstIndex,
+                        mesh.indices.begin() + p.firstIndex + p.indexCount);
+        }
+        indexData = sorted.data();
+      }
+    }
+
+    // BufferView: positions
+    tinygltf::BufferView bvPos;
+    bvPos.buffer = 0;
+    bvPos.byteOffset = bin.add(mesh.positions.data(), posBytes);
+    bvPos.byteLength = posBytes;
+    bvPos.target = TINYGLTF_TARGET_ARRAY_BUFFER;
+    model.bufferViews.push_back(bvPos);
+    const int bvPosIndex = static_cast<int>(model.bufferViews.size() - 1);
+
+    // BufferView + accessor: vertex colours, unorm8 RGBA
+    int accColorIndex = -1;
+    if (!mesh.colors.empty()) {
+      tinygltf::BufferView bvColor;
+      bvColor.buffer = 0;
+      bvColor.byteOffset = bin.add(mesh.colors.data(), mesh.colors.size() * sizeof(uint32_t));
+      bvColor.byteLength = mesh.colors.size() * sizeof(uint32_t);
+      bvColor.target = TINYGLTF_TARGET_ARRAY_BUFFER;
+      model.bufferViews.push_back(bvColor);
+      tinygltf::Accessor accColor;
+      accColor.bufferView = static_cast<int>(model.bufferViews.size() - 1);
+      accColor.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+      accColor.normalized = true;
+      accColor.count = mesh.colors.size();
+      accColor.type = TINYGLTF_TYPE_VEC4;
+      model.accessors.push_back(accColor);
+      accColorIndex = static_cast<int>(model.accessors.size() - 1);
+    }
+
+    // BufferView + accessor: texture coordinates
+    int accUvIndex = -1;
+    if (!mesh.texcoords.empty()) {
+      tinygltf::BufferView bvUv;
+      bvUv.buffer = 0;
+      bvUv.byteOffset = bin.add(mesh.texcoords.data(), mesh.texcoords.size() * sizeof(float));
+      bvUv.byteLength = mesh.texcoords.size() * sizeof(float);
+      bvUv.target = TINYGLTF_TARGET_ARRAY_BUFFER;
+      model.bufferViews.push_back(bvUv);
+      tinygltf::Accessor accUv;
+      accUv.bufferView = static_cast<int>(model.bufferViews.size() - 1);
+      accUv.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+      accUv.count = mesh.texcoords.size() / 2;
+      accUv.type = TINYGLTF_TYPE_VEC2;
+      model.accessors.push_back(accUv);
+      accUvIndex = static_cast<int>(model.accessors.size() - 1);
+    }
+
+    // BufferView: indices
+    tinygltf::BufferView bvIdx;
+    bvIdx.buffer = 0;
+    bvIdx.byteOffset = bin.add(indexData, idxBytes);
+    bvIdx.byteLength = idxBytes;
+    bvIdx.target = TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER;
+    model.bufferViews.push_back(bvIdx);
+    const int bvIdxIndex = static_cast<int>(model.bufferViews.size() - 1);
+
+    // Instance transforms: one bufferView and accessor per TRS attribute
+    tinygltf::Value::Object instanceAttributes;
+    if (sm.instances) {
+      const InstanceSet &inst = *sm.instances;
+      auto addAttribute = [&](const char *name, const std::vector<float> &v, int type) {
+        tinygltf::BufferView bv;
+        bv.buffer = 0;
+        bv.byteOffset = bin.add(v.data(), v.size() * sizeof(float));
+        bv.byteLength = v.size() * sizeof(float);
+        model.bufferViews.push_back(bv);
+        tinygltf::Accessor acc;
+        acc.bufferView = static_cast<int>(model.bufferViews.size() - 1);
+        acc.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+        acc.count = inst.count();
+        acc.type = type;
+        model.accessors.push_back(acc);
+        instanceAttributes[name] = tinygltf::Value(static_cast<int>(model.accessors.size() - 1));
+      };
+      addAttribute("TRANSLATION", inst.translation, TINYGLTF_TYPE_VEC3);
+      addAttribute("ROTATION", inst.rotation, TINYGLTF_TYPE_VEC4);
+      addAttribute("SCALE", inst.scale, TINYGLTF_TYPE_VEC3);
+    }
+
+    // Accessor: positions
+    tinygltf::Accessor accPos;
+    accPos.bufferView = bvPosIndex;
+    accPos.byteOffset = 0;
+    accPos.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+    accPos.count = mesh.positions.size() / 3;
+    accPos.type = TINYGLTF_TYPE_VEC3;
+    accPos.minValues = { mesh.posMin[0], mesh.posMin[1], mesh.posMin[2] };
+    accPos.maxValues = { mesh.posMax[0], mesh.posMax[1], mesh.posMax[2] };
+    model.accessors.push_back(accPos);
+    const int accPosIndex = static_cast<int>(model.accessors.size() - 1);
+
+    // Mesh: per material group, an index accessor and a primitive
+    tinygltf::Mesh gltfMesh;
+    gltfMesh.name = sm.name;
+    for (const Group &g : groups) {
+      tinygltf::Accessor accIdx;
+      accIdx.bufferView = bvIdxIndex;
+      accIdx.byteOffset = g.first * sizeof(uint32_t);
+      accIdx.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+      accIdx.count = g.count;
+      accIdx.type = TINYGLTF_TYPE_SCALAR;
+      model.accessors.push_back(accIdx);
+
+      const MeshMaterial &mm = g.material == UINT32_MAX ? grey : mesh.materials[g.material];
+      bool blend = false;
+      for (size_t i = g.first; mm.vertexColors && accColorIndex >= 0 && !blend && i < g.first + g.count; ++i) {
+        blend = mesh.colors[indexData[i]] >> 24 != 0xFF;
+      }
+      tinygltf::Primitive prim;
+      prim.attributes["POSITION"] = accPosIndex;
+      if (accColorIndex >= 0) prim.attributes["COLOR_0"] = accColorIndex;
+      if (accUvIndex >= 0 && mm.texture >= 0) prim.attributes["TEXCOORD_0"] = accUvIndex;
+      prim.indices = static_cast<int>(model.accessors.size() - 1);
+      prim.material = gltfMaterial(mm, blend);
+      prim.mode = TINYGLTF_MODE_TRIANGLES;
+      gltfMesh.primitives.push_back(prim);
+    }
+    if (gltf) {
+      tinygltf::Value::Object extras;
+      extras["byteRange"] = tinygltf::Value(tinygltf::Value::Array{
+          tinygltf::Value(double(start)), tinygltf::Value(double(bin.bytes - start))});
+      gltfMesh.extras = tinygltf::Value(std::move(extras));
+    }
+    model.meshes.push_back(gltfMesh);
+    const int meshIndex = static_cast<int>(model.meshes.size() - 1);
+
+    // Node
+    tinygltf::Node node;
+    node.name = sm.name;
+    node.mesh = meshIndex;
+    if (sm.instances) {
+      // Without the extension the mesh would be drawn once at the origin.
+      requireExtension(model, "EXT_mesh_gpu_instancing");
+      tinygltf::Value::Object ext;
+      ext["attributes"] = tinygltf::Value(std::move(instanceAttributes));
+      node.extensions["EXT_mesh_gpu_instancing"] = tinygltf::Value(std::move(ext));
+      tinygltf::Value::Array names;
+      for (const std::string &n : sm.instances->names) names.push_back(tinygltf::Value(n));
+      tinygltf::Value::Object extras;
+      extras["instanceNames"] = tinygltf::Value(std::move(names));
+      node.extras = tinygltf::Value(std::move(extras));
+    }
+    model.nodes.push_back(node);
+    scene.nodes.push_back(static_cast<int>(model.nodes.size() - 1));
+  }
+
+  // Scene
   model.scenes.push_back(scene);
   model.defaultScene = 0;
 
-  tinygltf::TinyGLTF gltf;
-  std::string warn;
-  const bool ok = gltf.WriteGltfSceneToFile(
-      &model,
-      outPath,
-      /*embedImages*/ true,
-      /*embedBuffers*/ true,
-      /*prettyPrint*/ false,
-      /*writeBinary*/ true);
-
-  if (!warn.empty()) {
-    // tinygltf collects warnings in some builds; keep err minimal.
-  }
-  if (!ok) {
-    err = "tinygltf failed to write GLB.";
+  // Images: encoded on `encodeThreads` threads, one image at a time each (an
+  // image shared with an earlier output is already encoded), then appended
+  // to the BIN chunk. KTX2 images are the KHR_texture_basisu source of their
+  // textures; a texture whose image stayed PNG (sides not multiples of 4)
+  // keeps it as the plain source.
+  if (!images.empty()) {
+    encodeImages(images, encodeThreads);
+    for (size_t i = 0; i < images.size(); ++i) {
+      const TextureImage &img = *images[i];
+      if (img.encoded.empty()) {
+        err = "texture encoding failed";
+        return false;
+      }
+      tinygltf::BufferView bv;
+      bv.buffer = 0;
+      bv.byteOffset = bin.add(img.encoded.data(), img.encoded.size());
+      bv.byteLength = img.encoded.size();
+      model.bufferViews.push_back(bv);
+      model.images[i].bufferView = static_cast<int>(model.bufferViews.size() - 1);
+      model.images[i].mimeType = img.mimeType;
+    }
+    for (tinygltf::Texture &t : model.textures) {
+      if (std::strcmp(images[t.source]->mimeType, "image/ktx2") != 0) continue;
+      tinygltf::Value::Object ext;
+      ext["source"] = tinygltf::Value(t.source);
+      t.extensions["KHR_texture_basisu"] = tinygltf::Value(std::move(ext));
+      t.source = -1;
+      requireExtension(model, "KHR_texture_basisu");
+    }
+  }
+
+  std::string binFile;
+  if (gltf) {
+    // The .bin first, so a .gltf that exists always has its buffer complete.
+    const std::string binPath = gltfBinPath(outPath);
+    const size_t slash = binPath.rfind('/');
+    binFile = slash == std::string::npos ? binPath : binPath.substr(slash + 1);
+    WriteBehindFile file;
+    if (!file.open(binPath)) {
+      err = "cannot create " + binPath + ": " + std::strerror(file.error());
+      return false;
+    }
+    if (ioBackend) *ioBackend = file.backend();
+    if (!writeBin(bin, file) || !file.close()) {
+      err = "write to " + binPath + " failed: " + std::strerror(file.error());
+      return false;
+    }
+  }
+
+  WriteBehindFile file;
+  if (!file.open(outPath)) {
+    err = "cannot create " + outPath + ": " + std::strerror(file.error());
+    return false;
+  }
+  if (gltf) {
+    const std::string json = gltfJson(model, bin.bytes, binFile);
+    file.write(json.data(), json.size());
+  } else {
+    if (ioBackend) *ioBackend = file.backend();
+    writeGlb(model, bin, file);
+  }
+  if (!file.close()) {
+    err = "write to " + outPath + " failed: " + std::strerror(file.error());
     return false;
   }
   return true;
 }
 
+// More boxes than this and --preview keeps the largest: the preview is meant
+// to be a small download.
+static constexpr size_t kPreviewMaxBoxes = 50000;
+
+// --preview: writes a GLB of one box per shape instance of `root` to
+// `previewPath`, by way of a temporary name so the file appears complete.
+// Runs before the full traversal; a failure only adds a warning.
+static void writePreview(SoNode *root, const std::string &previewPath, ConvertStats &stats) {
+  const auto t0 = std::chrono::steady_clock::now();
+  std::vector<std::array<float, 6>> found;
+  SoCallbackAction action;
+  action.addPreCallback(SoNode::getClassTypeId(), budgetPreCB, nullptr);
+  action.addPreCallback(SoShape::getClassTypeId(), previewShapeCB, &found);
+  action.apply(root);
+  if (g_run.abortCode.load()) return;
+  const size_t shapes = found.size();
+  if (shapes > kPreviewMaxBoxes) {
+    // Only the largest become geometry, so the GLB stays within the cap.
+    auto diagonal = [](const std::array<float, 6> &b) { return boundsDiagonal(&b[0], &b[3]); };
+    std::nth_element(found.begin(), found.begin() + kPreviewMaxBoxes, found.end(),
+                     [&](const std::array<float, 6> &a, const std::array<float, 6> &b) {
+                       return diagonal(a) > diagonal(b);
+                     });
+    found.resize(kPreviewMaxBoxes);
+  }
+  MeshOut boxes;
+  for (const std::array<float, 6> &b : found) appendBox(boxes, &b[0], &b[3]);
+
+  const std::string tmpPath = previewPath + ".part";
+  PartialFile partial(tmpPath);
+  std::string err;
+  if (!writeGLB({{"preview", &boxes}}, tmpPath, err)) {
+    ::unlink(tmpPath.c_str());
+    stats.warnings.push_back("Preview not written: " + err);
+    return;
+  }
+  if (::rename(tmpPath.c_str(), previewPath.c_str()) != 0) {
+    stats.warnings.push_back("Preview not written: rename to " + previewPath + ": " + std::strerror(errno));
+    ::unlink(tmpPath.c_str());
+    return;
+  }
+  stats.previewMs = msSince(t0);
+  std::fprintf(stderr, "Preview: wrote %s (%zu of %zu shape boxes)\n", previewPath.c_str(),
+               boxes.parts.size(), shapes);
+}
+
+// The top-level property state streamReadAndTraverse replays ahead of each
+// unit, folded to one node per kind however many top-level nodes set it:
+// transformations accumulate into one matrix, and of any other property only
+// the latest node of each type is kept, as it replaces what the earlier one
+// set (fields marked ignored excepted).
+class CarriedState {
+public:
+  CarriedState() : group_(new SoGroup), transform_(new SoMatrixTransform) {
+    group_->ref();
+    group_->addChild(transform_);
+    matrix_.makeIdentity();
+  }
+  ~CarriedState() { group_->unref(); }
+
+  // The nodes to traverse ahead of the next unit.
+  SoGroup *group() const { return group_; }
+
+  void add(SoNode *node) {
+    if (node->isOfType(SoResetTransform::getClassTypeId())) {
+      if (static_cast<SoResetTransform *>(node)->whatToReset.getValue() & SoResetTransform::TRANSFORM) {
+        matrix_.makeIdentity();
+        transform_->matrix.setValue(matrix_);
+      }
+      return;
+    }
+    // SoUnits is a transformation too, but scales relative to the units in
+    // effect, so it stays a node of its own.
+    if (node->isOfType(SoTransformation::getClassTypeId()) && !node->isOfType(SoUnits::getClassTypeId())) {
+      SoGetMatrixAction ma{SbViewportRegion()};
+      ma.apply(node);
+      matrix_.multLeft(ma.getMatrix());
+      transform_->matrix.setValue(matrix_);
+      return;
+    }
+    // Ahead of the transform, which stays last.
+    for (int i = 0; i + 1 < group_->getNumChildren(); ++i) {
+      if (group_->getChild(i)->getTypeId() == node->getTypeId()) {
+        group_->replaceChild(i, node);
+        return;
+      }
+    }
+    group_->insertChild(node, group_->getNumChildren() - 1);
+  }
+
+private:
+  SoGroup *group_;
+  SoMatrixTransform *transform_;
+  SbMatrix matrix_;
+};
+
+// --degrade with a memory cap: reads top-level nodes one at a time and
+// traverses each before reading the next, so only one top-level subtree is in
+// memory at once. readAll would have put every top-level node under one
+// separator, so top-level property nodes (no children, not shapes) are folded
+// into a CarriedState replayed ahead of later nodes; state set inside a
+// top-level non-separator group is not carried over. DEF'd nodes stay
+// referenced for later USEs. Returns false if the input is not valid Inventor.
+static bool streamReadAndTraverse(SoInput &in, SoCallbackAction &action, ConvertStats &stats) {
+  CarriedState carried;
+  std::vector<SoNode *> keep;
+  std::unordered_set<const SoNode *> kept;
+  bool ok = true;
+  for (;;) {
+    enterStage(kStageParse, stats);
+    auto t0 = std::chrono::steady_clock::now();
+    SoNode *node = nullptr;
+    if (!SoDB::read(&in, node)) {
+      ok = false;
+      break;
+    }
+    stats.parseMs += msSince(t0);
+    if (!node) break;  // EOF
+    node->ref();
+    std::vector<SoNode *> named;
+    countNodes(node, stats, &named);
+    for (SoNode *n : named) {
+      n->ref();
+      keep.push_back(n);
+      kept.insert(n);
+    }
+    // A named top-level node is a part; an unnamed one is looked into.
+    if (node->getName().getLength() == 0) {
+      collectTopLevelParts(node, stats.meta.topLevelParts);
+    } else if (stats.meta.topLevelParts.size() < kMaxTopLevelParts) {
+      stats.meta.topLevelParts.push_back(node->getName().getString());
+    }
+
+    enterStage(kStageTraverse, stats);
+    t0 = std::chrono::steady_clock::now();
+    SoGroup *unit = new SoGroup;
+    unit->ref();
+    unit->addChild(carried.group());
+    unit->addChild(node);
+    action.apply(unit);
+    unit->unref();
+    stats.traverseMs += msSince(t0);
+
+    if (!node->getChildren() && !node->isOfType(SoShape::getClassTypeId())) carried.add(node);
+    node->unref();
+    retireShapes(stats.meta, kept);
+    g_textures.forget();
+    if (g_run.abortCode.load()) break;
+  }
+  for (SoNode *n : keep) n->unref();
+  return ok;
+}
+
+// Parts smaller than this fraction of the model's diagonal are the first to
+// go when --degrade has to meet a triangle budget.
+static constexpr float kSmallPartFraction = 0.002f;
+
+// --degrade: bring the collected mesh within --max-triangles instead of
+// failing. Small parts go first (fasteners, text, decals), then what is left
+// is welded and vertex-clustered on the finest grid that fits. What was done
+// goes to `warnings`, which callers append to the run's stats once done: the
+// watchdog may write those from its thread meanwhile.
+static void degradeToBudget(MeshOut &mesh, size_t maxTriangles, std::vector<std::string> &warnings) {
+  const size_t before = mesh.triangleCount();
+  if (!maxTriangles || before <= maxTriangles) return;
+  char msg[256];
+  const size_t dropped = dropSmallParts(mesh, maxTriangles, kSmallPartFraction);
+  if (dropped) {
+    std::snprintf(msg, sizeof(msg), "Dropped %zu parts smaller than %.1f%% of the model size.",
+                  dropped, kSmallPartFraction * 100.0);
+    warnings.push_back(msg);
+  }
+  weldVertices(mesh);
+  const float cell = clusterToBudget(mesh, maxTriangles);
+  if (cell > 0.0f) {
+    std::snprintf(msg, sizeof(msg), "Decimated by vertex clustering on a %.3g mm grid.",
+                  cell * 1000.0);
+    warnings.push_back(msg);
+  }
+  std::snprintf(msg, sizeof(msg),
+                "Triangle budget of %zu exceeded: reduced %zu -> %zu triangles.",
+                maxTriangles, before, mesh.triangleCount());
+  warnings.push_back(msg);
+}
+
+// One Inventor/VRML entry of a zip input.
+struct ZipModel {
+  const ZipEntry *entry = nullptr;
+  SoNode *root = nullptr;
+  bool included = false;  // pulled into another entry by SoFile / Inline
+  int resolved = 0;       // resolveIncludes: 0 not yet, 1 in progress, 2 done
+};
+
+// Replaces the SoFile and VRML Inline nodes of models[i] that name another
+// archive entry with that entry's (already parsed, itself resolved) scene.
+// Coin could not load them while parsing from a buffer and left them empty.
+// A reference back into an entry still being resolved is a cycle and is
+// left unresolved.
+static void resolveIncludes(std::vector<ZipModel> &models, size_t i, const ZipArchive &zip,
+                            const std::unordered_map<const ZipEntry *, size_t> &modelOf,
+                            ConvertStats &stats) {
+  if (models[i].resolved) return;
+  models[i].resolved = 1;
+  const std::string &from = models[i].entry->name;
+
+  struct Site {
+    SoGroup *parent;
+    int index;
+    SoNode *node;
+    std::string ref;
+  };
+  std::vector<Site> sites;
+  for (const SoType type : {SoFile::getClassTypeId(), SoVRMLInline::getClassTypeId()}) {
+    SoSearchAction sa;
+    sa.setType(type);
+    sa.setInterest(SoSearchAction::ALL);
+    sa.setSearchingAll(TRUE);
+    sa.apply(models[i].root);
+    const SoPathList &paths = sa.getPaths();
+    for (int p = 0; p < paths.getLength(); ++p) {
+      const SoPath *path = paths[p];
+      if (path->getLength() < 2) continue;
+      SoNode *parent = path->getNodeFromTail(1);
+      if (!parent->isOfType(SoGroup::getClassTypeId())) continue;
+      SoNode *node = path->getTail();
+      std::string ref;
+      if (node->isOfType(SoFile::getClassTypeId())) {
+        ref = static_cast<SoFile *>(node)->name.getValue().getString();
+      } else {
+        const SoVRMLInline *inl = static_cast<SoVRMLInline *>(node);
+        if (inl->url.getNum() > 0) ref = inl->url[0].getString();
+      }
+      if (!ref.empty()) {
+        sites.push_back({static_cast<SoGroup *>(parent), path->getIndexFromTail(0), node, ref});
+      }
+    }
+  }
+
+  for (const Site &site : sites) {
+    const ZipEntry *e = resolveZipReference(zip, from, site.ref);
+    const auto it = e ? modelOf.find(e) : modelOf.end();
+    if (it == modelOf.end()) {
+      stats.warnings.push_back(from + ": referenced file '" + site.ref + "' is not in the archive.");
+      continue;
+    }
+    ZipModel &target = models[it->second];
+    if (target.resolved == 1) {
+      stats.warnings.push_back(from + ": circular reference to '" + site.ref + "' ignored.");
+      continue;
+    }
+    resolveIncludes(models, it->second, zip, modelOf, stats);
+    if (site.parent->getChild(site.index) == site.node) {
+      site.parent->replaceChild(site.index, target.root);
+    }
+    target.included = true;
+  }
+  models[i].resolved = 2;
+}
+
+// Loads the images of the SoTexture2 nodes in an entry's scene that name
+// another archive entry: Coin could not open them while parsing from a
+// buffer. The entry is extracted to a temporary file for Coin's image
+// loader (simage) and the texels set as the node's image. Textures that are
+// not in the archive or cannot be decoded get a warning each.
+static void resolveTextures(SoNode *root, const std::string &from, const ZipArchive &zip,
+                            ConvertStats &stats) {
+  SoSearchAction sa;
+  sa.setType(SoTexture2::getClassTypeId());
+  sa.setInterest(SoSearchAction::ALL);
+  sa.setSearchingAll(TRUE);
+  sa.apply(root);
+  const SoPathList &paths = sa.getPaths();
+  const char *tmpDir = std::getenv("TMPDIR");
+  for (int p = 0; p < paths.getLength(); ++p) {
+    SoTexture2 *tex = static_cast<SoTexture2 *>(paths[p]->getTail());
+    const std::string ref = tex->filename.getValue().getString();
+    if (ref.empty()) continue;
+    SbVec2s size;
+    int components = 0;
+    if (tex->image.getValue(size, components) && size[0] > 0 && size[1] > 0) continue;  // already loaded
+    const ZipEntry *e = resolveZipReference(zip, from, ref);
+    if (!e || isZipModelEntry(*e)) {
+      stats.warnings.push_back(from + ": texture '" + ref + "' is not in the archive.");
+      continue;
+    }
+    std::vector<char> bytes;
+    std::string err;
+    if (!zip.extract(*e, bytes, err)) {
+      stats.warnings.push_back(from + ": texture '" + ref + "' not read: " + err);
+      continue;
+    }
+    // Same extension as the entry: some of simage's loaders go by it.
+    const size_t dot = e->name.rfind('.'), slash = e->name.rfind('/');
+    const std::string ext = dot != std::string::npos && (slash == std::string::npos || dot > slash)
+                                ? e->name.substr(dot)
+                                : "";
+    std::string tmpPath = std::string(tmpDir && *tmpDir ? tmpDir : "/tmp") + "/iv2glb-tex-XXXXXX" + ext;
+    const int fd = ::mkstemps(&tmpPath[0], static_cast<int>(ext.size()));
+    if (fd < 0) {
+      stats.warnings.push_back(from + ": texture '" + ref + "' not read: cannot create a temporary file.");
+      continue;
+    }
+    PartialFile partial(tmpPath);
+    bool written = true;
+    for (size_t off = 0; written && off < bytes.size();) {
+      const ssize_t n = ::write(fd, bytes.data() + off, bytes.size() - off);
+      if (n < 0 && errno == EINTR) continue;
+      written = n > 0;
+      off += written ? static_cast<size_t>(n) : 0;
+    }
+    ::close(fd);
+    SbImage image;
+    const bool decoded = written && image.readFile(SbString(tmpPath.c_str()));
+    ::unlink(tmpPath.c_str());
+    const unsigned char *texels = decoded ? image.getValue(size, components) : nullptr;
+    if (!texels || size[0] <= 0 || size[1] <= 0 || components < 1 || components > 4) {
+      stats.warnings.push_back(from + ": texture '" + ref + "' could not be decoded.");
+      continue;
+    }
+    tex->image.setValue(size, components, texels);
+  }
+}
+
+// Output file name for an archive entry: its base name, sanitised, made
+// unique within the output directory.
+static std::string outputNameFor(const std::string &entry, std::unordered_set<std::string> &used) {
+  const size_t slash = entry.rfind('/');
+  std::string stem = entry.substr(slash == std::string::npos ? 0 : slash + 1);
+  const size_t dot = stem.rfind('.');
+  if (dot != std::string::npos && dot > 0) stem.erase(dot);
+  for (char &c : stem) {
+    if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_' && c != '.') c = '_';
+  }
+  if (stem.empty()) stem = "model";
+  std::string name = stem + ".glb";
+  for (int n = 2; !used.insert(name).second; ++n) name = stem + "-" + std::to_string(n) + ".glb";
+  return name;
+}
+
+// Zip input. Model entries are inflated in parallel straight from the mapped
+// archive, then parsed from memory with SoInput::setBuffer; SoDB is not
+// thread-safe, so parsing and traversal stay serial. Entries no other entry
+// references are the models: each becomes one node of the GLB, or its own
+// GLB in the `outPath` directory with `splitFiles`. Returns the exit code;
+// budget trips return their abort code for the caller to report.
+static int convertZip(const std::string &inPath, const std::string &outPath, bool splitFiles,
+                      size_t maxTriangles, ConvertStats &stats) {
+  ZipArchive zip;
+  std::string err;
+  if (!zip.open(inPath, err)) {
+    std::fprintf(stderr, "Failed to open zip input: %s\n", err.c_str());
+    return 3;
+  }
+  std::vector<ZipModel> models;
+  std::unordered_map<const ZipEntry *, size_t> modelOf;
+  for (const ZipEntry &e : zip.entries()) {
+    if (!isZipModelEntry(e)) continue;
+    modelOf[&e] = models.size();
+    models.emplace_back();
+    models.back().entry = &e;
+  }
+  if (models.empty()) {
+    std::fprintf(stderr, "Zip input contains no .iv/.wrl entries.\n");
+    return 4;
+  }
+
+  auto t0 = std::chrono::steady_clock::now();
+  std::vector<std::vector<char>> data(models.size());
+  std::vector<std::string> errors(models.size());
+  std::atomic<size_t> next{0};
+  auto inflateWorker = [&]() {
+    for (size_t i; (i = next.fetch_add(1)) < models.size();) {
+      if (g_run.abortCode.load(std::memory_order_relaxed)) return;
+      zip.extract(*models[i].entry, data[i], errors[i]);
+    }
+  };
+  const unsigned threads = std::max(1u, std::min<unsigned>(std::thread::hardware_concurrency(),
+                                                           static_cast<unsigned>(models.size())));
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads; ++t) pool.emplace_back(inflateWorker);
+  inflateWorker();
+  for (std::thread &t : pool) t.join();
+  for (size_t i = 0; i < models.size(); ++i) {
+    if (!errors[i].empty()) {
+      std::fprintf(stderr, "Failed to read zip entry %s\n", errors[i].c_str());
+      return 4;
+    }
+    stats.inputBytes += data[i].size();
+  }
+
+  auto releaseRoots = [&]() {
+    for (ZipModel &m : models) {
+      if (m.root) m.root->unref();
+      m.root = nullptr;
+    }
+  };
+  for (size_t i = 0; i < models.size(); ++i) {
+    SoInput in;
+    in.setBuffer(data[i].data(), data[i].size());
+    SoNode *root = SoDB::readAll(&in);
+    if (!root) {
+      releaseRoots();
+      std::fprintf(stderr, "SoDB::readAll() failed for %s (invalid/unsupported .iv).\n",
+                   models[i].entry->name.c_str());
+      return 4;
+    }
+    root->ref();
+    models[i].root = root;
+    countNodes(root, stats);
+    std::vector<char>().swap(data[i]);
+    resolveTextures(root, models[i].entry->name, zip, stats);
+  }
+  for (size_t i = 0; i < models.size(); ++i) resolveIncludes(models, i, zip, modelOf, stats);
+  stats.parseMs = msSince(t0);
+
+  t0 = std::chrono::steady_clock::now();
+  enterStage(kStageTraverse, stats);
+  std::vector<MeshOut> meshes(models.size());
+  TraverseCtx ctx;
+  ctx.stats = &stats;
+  ctx.maxTriangles = maxTriangles;
+  SoCallbackAction action;
+  action.addPreCallback(SoNode::getClassTypeId(), budgetPreCB, nullptr);
+  action.addPreCallback(SoShape::getClassTypeId(), shapePreCB, &ctx);
+  action.addTriangleCallback(SoShape::getClassTypeId(), triangleCB, &ctx);
+  for (size_t i = 0; i < models.size() && !g_run.abortCode.load(); ++i) {
+    if (models[i].included) continue;
+    ctx.mesh = &meshes[i];
+    action.apply(models[i].root);
+    ctx.priorTriangles += meshes[i].triangleCount();
+  }
+  releaseRoots();
+  stats.traverseMs = msSince(t0);
+  stats.triangleCount = ctx.priorTriangles;
+  if (const int code = g_run.abortCode.load()) return code;
+  if (ctx.compactions) {
+    stats.warnings.push_back("Memory budget pressure: geometry compacted " +
+                             std::to_string(ctx.compactions) + " time(s) during traversal.");
+  }
+  // Over budget: each model gets its share of the triangle budget.
+  enterStage(kStageReduce, stats);
+  const size_t total = ctx.priorTriangles;
+  if (g_run.degrade && maxTriangles && total > maxTriangles) {
+    std::vector<std::string> reduced;
+    for (MeshOut &m : meshes) {
+      const size_t share = static_cast<size_t>(double(maxTriangles) * m.triangleCount() / total);
+      degradeToBudget(m, std::max<size_t>(share, 1), reduced);
+    }
+    stats.warnings.insert(stats.warnings.end(), reduced.begin(), reduced.end());
+  }
+  enterStage(kStageWrite, stats);
+  std::vector<MeshOut *> atlased;
+  for (MeshOut &m : meshes) atlased.push_back(&m);
+  atlasTextures(atlased, stats);
+
+  t0 = std::chrono::steady_clock::now();
+  std::vector<SceneMesh> scene;
+  std::vector<const ZipEntry *> sceneEntries;
+  size_t written = 0;
+  for (size_t i = 0; i < models.size(); ++i) {
+    if (models[i].included) continue;
+    if (meshes[i].indices.empty()) {
+      stats.warnings.push_back(models[i].entry->name + ": no triangles.");
+      continue;
+    }
+    std::string name = models[i].entry->name;
+    name.erase(std::min(name.rfind('.'), name.size()));
+    scene.push_back({name, &meshes[i]});
+    sceneEntries.push_back(models[i].entry);
+    written += meshes[i].triangleCount();
+    noteWritten(stats.meta, meshes[i]);
+  }
+  ThumbnailTask thumbnail;
+  if (!scene.empty()) thumbnail.start(thumbSources(scene));
+  if (splitFiles) {
+    if (scene.empty()) {
+      std::fprintf(stderr, "GLB export failed: No triangles extracted from scene graph.\n");
+      return 5;
+    }
+    if (::mkdir(outPath.c_str(), 0755) != 0 && errno != EEXIST) {
+      std::fprintf(stderr, "GLB export failed: cannot create directory %s\n", outPath.c_str());
+      return 5;
+    }
+    std::unordered_set<std::string> used;
+    for (size_t k = 0; k < scene.size(); ++k) {
+      const std::string file = outputNameFor(sceneEntries[k]->name, used);
+      if (!writeGLB({scene[k]}, outPath + "/" + file, err, &stats.ioBackend)) {
+        std::fprintf(stderr, "GLB export failed: %s: %s\n", file.c_str(), err.c_str());
+        return 5;
+      }
+      stats.outputs.push_back({file, sceneEntries[k]->name, scene[k].mesh->triangleCount()});
+    }
+  } else if (!writeGLB(scene, outPath, err, &stats.ioBackend)) {
+    std::fprintf(stderr, "GLB export failed: %s\n", err.c_str());
+    return 5;
+  }
+  stats.writeMs = msSince(t0);
+  thumbnail.finish(stats);
+
+  std::fprintf(reportStream(outPath), "OK: wrote %s (%zu triangles from %zu of %zu archive entries)\n",
+               outPath.c_str(), written, scene.size(), models.size());
+  return 0;
+}
+
+// Shared tail of a single-model conversion: optionally keep the collected
+// geometry as a mesh file, meet the triangle budget, write the GLB. Returns
+// the exit code (kExitTriangles for the caller to report as an abort).
+static int exportMesh(MeshOut &mesh, const std::string &outPath, const std::string &saveMeshPath,
+                      size_t maxTriangles, ConvertStats &stats) {
+  std::string err;
+  enterStage(kStageReduce, stats);
+  if (!saveMeshPath.empty()) {
+    // Saved before --degrade, so a re-export can pick another budget.
+    const auto t0 = std::chrono::steady_clock::now();
+    if (!writeMeshFile(mesh, saveMeshPath, err)) {
+      std::fprintf(stderr, "Mesh file export failed: %s\n", err.c_str());
+      return 5;
+    }
+    stats.saveMeshMs = msSince(t0);
+  }
+  if (g_run.degrade) {
+    std::vector<std::string> reduced;
+    degradeToBudget(mesh, maxTriangles, reduced);
+    stats.warnings.insert(stats.warnings.end(), reduced.begin(), reduced.end());
+  } else if (maxTriangles && mesh.triangleCount() > maxTriangles) {
+    return kExitTriangles;
+  }
+  enterStage(kStageWrite, stats);
+  atlasTextures({&mesh}, stats);
+  noteWritten(stats.meta, mesh);
+
+  const auto t0 = std::chrono::steady_clock::now();
+  const std::vector<SceneMesh> scene = {{std::string(), &mesh}};
+  ThumbnailTask thumbnail;
+  thumbnail.start(thumbSources(scene));
+  if (!writeGLB(scene, outPath, err, &stats.ioBackend)) {
+    std::fprintf(stderr, "GLB export failed: %s\n", err.c_str());
+    return 5;
+  }
+  stats.writeMs = msSince(t0);
+  thumbnail.finish(stats);
+  std::fprintf(reportStream(outPath), "OK: wrote %s (%zu triangles)\n",
+               outPath.c_str(), mesh.indices.size() / 3);
+  return 0;
+}
+
+// --proxy-boxes: writes the collected boxes as instances of one unit cube,
+// oriented where their frame allows (box_proxy.h), with the instance names
+// in the node's extras.instanceNames for picking.
+static int exportProxy(const ProxyTraversal &t, const std::string &outPath, ConvertStats &stats) {
+  InstanceSet instances;
+  for (const ProxyBox &b : t.boxes) {
+    instances.add(boxInstance(b.frame, b.box.getMin().getValue(), b.box.getMax().getValue()), b.name);
+    SbBox3f world = b.box;
+    world.transform(b.frame);
+    const SbVec3f &lo = world.getMin(), &hi = world.getMax();
+    extendBounds(stats.meta.bmin, stats.meta.bmax, lo[0], lo[1], lo[2]);
+    extendBounds(stats.meta.bmin, stats.meta.bmax, hi[0], hi[1], hi[2]);
+  }
+  if (!instances.count()) {
+    std::fprintf(stderr, "GLB export failed: No shapes with bounds in scene graph.\n");
+    return 5;
+  }
+  MeshOut cube;
+  const float lo[3] = {-0.5f, -0.5f, -0.5f}, hi[3] = {0.5f, 0.5f, 0.5f};
+  appendBox(cube, lo, hi);
+  stats.triangleCount = instances.count() * cube.triangleCount();
+  stats.meta.written = true;
+  stats.meta.outputTriangles = stats.triangleCount;
+  stats.meta.outputVertices = instances.count() * cube.vertexCount();
+  enterStage(kStageWrite, stats);
+
+  const auto t0 = std::chrono::steady_clock::now();
+  std::string err;
+  if (!writeGLB({{"proxy", &cube, &instances}}, outPath, err, &stats.ioBackend)) {
+    std::fprintf(stderr, "GLB export failed: %s\n", err.c_str());
+    return 5;
+  }
+  stats.writeMs = msSince(t0);
+  std::fprintf(reportStream(outPath), "OK: wrote %s (%zu proxy boxes)\n", outPath.c_str(), instances.count());
+  return 0;
+}
+
+// --split-assemblies: writes one GLB per assembly that has triangles (plus
+// "root" for geometry outside them) into the `outDir` directory, several at
+// once, each reduced to its share of the triangle budget with --degrade.
+// manifest.json then lists per GLB the name, path, triangle count, world
+// bounds and the matrix that places its geometry in the scene (column-major,
+// as glTF node.matrix), so a viewer can load and drop assemblies on demand.
+static int exportAssemblies(AssemblyTraversal &t, const std::string &outDir, size_t maxTriangles,
+                            ConvertStats &stats) {
+  enterStage(kStageWrite, stats);
+  if (t.rest->triangleCount()) {
+    t.assemblies.emplace_front();
+    Assembly &root = t.assemblies.front();
+    root.name = root.path = "root";
+    root.toWorld.makeIdentity();
+    root.toLocal.makeIdentity();
+    root.mesh = std::move(*t.rest);
+  }
+  std::vector<Assembly *> parts;
+  size_t total = 0;
+  for (Assembly &a : t.assemblies) {
+    if (!a.mesh.triangleCount()) continue;
+    parts.push_back(&a);
+    total += a.mesh.triangleCount();
+  }
+  if (parts.empty()) {
+    std::fprintf(stderr, "GLB export failed: No triangles extracted from scene graph.\n");
+    return 5;
+  }
+  if (!g_run.degrade && maxTriangles && total > maxTriangles) return kExitTriangles;
+  if (::mkdir(outDir.c_str(), 0755) != 0 && errno != EEXIST) {
+    std::fprintf(stderr, "GLB export failed: cannot create directory %s\n", outDir.c_str());
+    return 5;
+  }
+  std::vector<MeshOut *> atlased;
+  for (Assembly *a : parts) atlased.push_back(&a->mesh);
+  atlasTextures(atlased, stats);
+
+  const auto t0 = std::chrono::steady_clock::now();
+  // Textures the parts share are encoded once here, on one pool; the writers
+  // below run a thread per core already, so each encodes on its own thread.
+  std::vector<TextureImage *> images;
+  std::unordered_set<uint32_t> seen;
+  for (Assembly *a : parts) {
+    for (const MeshMaterial &mm : a->mesh.materials) {
+      if (mm.texture < 0) continue;
+      const uint32_t image = g_textures.textures[mm.texture].image;
+      if (seen.insert(image).second) images.push_back(&g_textures.images[image]);
+    }
+  }
+  encodeImages(images, 0);
+  std::unordered_set<std::string> used;
+  std::vector<std::string> files(parts.size());
+  for (size_t i = 0; i < parts.size(); ++i) files[i] = outputNameFor(parts[i]->name, used);
+  const bool shrink = g_run.degrade && maxTriangles && total > maxTriangles;
+  std::vector<ConvertStats> partStats(parts.size());
+  std::vector<std::string> errors(parts.size());
+  std::vector<const char *> backends(parts.size(), nullptr);
+  std::atomic<size_t> next{0};
+  auto writeWorker = [&]() {
+    for (size_t i; (i = next.fetch_add(1)) < parts.size();) {
+      if (g_run.abortCode.load(std::memory_order_relaxed)) return;
+      MeshOut &m = parts[i]->mesh;
+      if (shrink) {
+        const size_t share = static_cast<size_t>(double(maxTriangles) * m.triangleCount() / total);
+        degradeToBudget(m, std::max<size_t>(share, 1), partStats[i].warnings);
+      }
+      writeGLB({{parts[i]->name, &m}}, outDir + "/" + files[i], errors[i], &backends[i], 1);
+    }
+  };
+  const unsigned threads = std::max(1u, std::min<unsigned>(std::thread::hardware_concurrency(),
+                                                           static_cast<unsigned>(parts.size())));
+  std::vector<std::thread> pool;
+  for (unsigned n = 1; n < threads; ++n) pool.emplace_back(writeWorker);
+  writeWorker();
+  for (std::thread &th : pool) th.join();
+  if (const int code = g_run.abortCode.load()) return code;
+  for (size_t i = 0; i < parts.size(); ++i) {
+    if (!errors[i].empty()) {
+      std::fprintf(stderr, "GLB export failed: %s: %s\n", files[i].c_str(), errors[i].c_str());
+      return 5;
+    }
+    for (const std::string &w : partStats[i].warnings) stats.warnings.push_back(parts[i]->path + ": " + w);
+  }
+  ThumbnailTask thumbnail;
+  std::vector<ThumbSource> placed(parts.size());
+  for (size_t i = 0; i < parts.size(); ++i) {
+    placed[i].mesh = &parts[i]->mesh;
+    for (int r = 0; r < 4; ++r) {
+      for (int c = 0; c < 4; ++c) placed[i].toWorld[r][c] = parts[i]->toWorld[r][c];
+    }
+  }
+  thumbnail.start(std::move(placed));
+
+  const std::string manifestPath = outDir + "/manifest.json";
+  FILE *f = std::fopen(manifestPath.c_str(), "w");
+  if (!f) {
+    std::fprintf(stderr, "GLB export failed: cannot create %s\n", manifestPath.c_str());
+    return 5;
+  }
+  std::fprintf(f, "{\"version\":1,\"depth\":%d,\"assemblies\":[", t.pathLength - 1);
+  size_t written = 0;
+  for (size_t i = 0; i < parts.size(); ++i) {
+    const Assembly &a = *parts[i];
+    float bmin[3], bmax[3];
+    for (int k = 0; k < 3; ++k) {
+      bmin[k] = +std::numeric_limits<float>::infinity();
+      bmax[k] = -std::numeric_limits<float>::infinity();
+    }
+    for (int c = 0; c < 8; ++c) {
+      SbVec3f w;
+      a.toWorld.multVecMatrix(SbVec3f(c & 1 ? a.mesh.posMax[0] : a.mesh.posMin[0],
+                                      c & 2 ? a.mesh.posMax[1] : a.mesh.posMin[1],
+                                      c & 4 ? a.mesh.posMax[2] : a.mesh.posMin[2]), w);
+      extendBounds(bmin, bmax, w[0], w[1], w[2]);
+    }
+    std::string matrix;
+    for (int r = 0; r < 4; ++r) {
+      for (int c = 0; c < 4; ++c) {
+        char num[32];
+        std::snprintf(num, sizeof(num), "%s%.9g", matrix.empty() ? "" : ",", a.toWorld[r][c]);
+        matrix += num;
+      }
+    }
+    std::fprintf(f,
+                 "%s{\"name\":\"%s\",\"path\":\"%s\",\"file\":\"%s\",\"triangleCount\":%zu,"
+                 "\"min\":[%.9g,%.9g,%.9g],\"max\":[%.9g,%.9g,%.9g],\"matrix\":[%s]}",
+                 i ? "," : "", jsonEscape(a.name).c_str(), jsonEscape(a.path).c_str(),
+                 jsonEscape(files[i]).c_str(), a.mesh.triangleCount(), bmin[0], bmin[1], bmin[2],
+                 bmax[0], bmax[1], bmax[2], matrix.c_str());
+    stats.outputs.push_back({files[i], a.path, a.mesh.triangleCount()});
+    written += a.mesh.triangleCount();
+    noteWritten(stats.meta, a.mesh, &a.toWorld);
+  }
+  std::fprintf(f, "]}\n");
+  if (std::fclose(f) != 0) {
+    std::fprintf(stderr, "GLB export failed: write to %s failed\n", manifestPath.c_str());
+    return 5;
+  }
+  stats.ioBackend = backends[0];
+  stats.writeMs = msSince(t0);
+  thumbnail.finish(stats);
+  std::fprintf(stdout, "OK: wrote %s (%zu triangles in %zu assemblies)\n", outDir.c_str(), written,
+               parts.size());
+  return 0;
+}
+
+// --metadata-only: the metadata JSON goes to stdout (the stats file, if
+// requested, is written as usual).
+static int printMetadata(const ConvertStats &stats) {
+  std::fprintf(stdout, "%s\n", metadataJson(stats).c_str());
+  return std::fflush(stdout) == 0 ? 0 : 5;
+}
+
+static void usage() {
+  std::fprintf(stderr,
+               "Usage: iv2glb [options] <input.iv> <output.glb>\n"
+               "       iv2glb --scan <input.iv>\n"
+               "       iv2glb --metadata-only [options] <input.iv>\n"
+               "  <input.iv> may be - (stdin), a FIFO or /dev/fd/N: read sequentially as it\n"
+               "  arrives (gzip/zstd included); SoFile paths then resolve from the cwd\n"
+               "  <output.glb> may be - (stdout) or /dev/fd/N; the GLB is written in\n"
+               "  one sequential pass, so pipes work; a path ending in .gltf writes\n"
+               "  JSON plus a .bin of the same name, each mesh one aligned byte range\n"
+               "  --stats <path>   write conversion statistics as JSON\n"
+               "  --deadline-ms N  abort (exit 6) after N ms of wall time\n"
+               "  --max-rss-mb N   abort (exit 7) once resident memory exceeds N MiB\n"
+               "                   SIGTERM/SIGINT cancel the run (exit 8)\n"
+               "  --max-triangles N  abort (exit 9) once more than N triangles are produced\n"
+               "  --degrade        instead of failing on --max-triangles/--max-rss-mb,\n"
+               "                   stream the parse, drop small parts and decimate;\n"
+               "                   what was done is listed in the stats warnings\n"
+               "  --scan           validate and count structure without parsing\n"
+               "                   into a scene graph; prints JSON to stdout\n"
+               "  --metadata-only  parse and walk the scene without generating triangles\n"
+               "                   or writing a GLB; prints the stats \"metadata\" (bounds,\n"
+               "                   counts, instancing, units, materials, named parts)\n"
+               "  --cache-dir DIR  keep a binary Inventor copy of each parsed input in DIR,\n"
+               "                   keyed by content hash, and read that instead of\n"
+               "                   re-parsing identical input (not for FIFO/pipe input)\n"
+               "  --save-mesh PATH also write the extracted geometry (before --degrade)\n"
+               "                   as a mesh file; passing a mesh file as <input>\n"
+               "                   re-exports it without parsing or traversal\n"
+               "  --preview PATH   before the full traversal, write a GLB of one box per\n"
+               "                   shape instance to PATH (appears complete, via rename)\n"
+               "  --proxy-boxes D  write only bounding boxes, as instances of one unit cube\n"
+               "                   (EXT_mesh_gpu_instancing), without generating triangles:\n"
+               "                   one per shape instance (D = 0) or per node at depth D,\n"
+               "                   oriented in its frame; names in extras.instanceNames\n"
+               "  --thumbnail PATH also render a PNG of the exported geometry on the CPU\n"
+               "                   (three-quarter view; a failure is only a warning)\n"
+               "  --thumbnail-size N  its width and height in pixels (default 256)\n"
+               "  --texture-max-size N  scale textures down to power-of-two sides of at\n"
+               "                   most N pixels (default: written at their own size)\n"
+               "  --texture-format F  png (default), or etc1s / uastc: KTX2 with Basis\n"
+               "                   Universal (KHR_texture_basisu), GPU-compressed, with\n"
+               "                   mipmaps; images with sides not multiples of 4 stay PNG\n"
+               "  --texture-atlas  pack small textures used within [0, 1] into shared\n"
+               "                   atlases so their materials, and primitives, merge\n"
+               "  --chunk-triangles N  split meshes over N triangles into spatial chunks\n"
+               "                   (nearby parts, one glTF mesh each) for partial loading\n"
+               "  --io MODE        input read-ahead / GLB write-behind: uring (io_uring\n"
+               "                   where the kernel allows, else a thread), thread, or\n"
+               "                   sync (plain blocking I/O; the default)\n"
+               "  --no-fast-parse  read coordinate/index arrays through SoInput too\n"
+               "                   (by default large ones are parsed outside Coin)\n"
+               "  --split-files    zip input: write one GLB per model entry into the\n"
+               "                   <output> directory (listed in the stats \"outputs\")\n"
+               "                   instead of one GLB with a node per entry\n"
+               "  --split-assemblies D  one GLB per node at depth D below the root (1 = its\n"
+               "                   children), in its own frame, written in parallel into\n"
+               "                   the <output> directory with manifest.json (names,\n"
+               "                   paths, triangle counts, world bounds, placement matrices)\n");
+}
+
 int main(int argc, char **argv) {
-  if (argc < 3) {
-    std::fprintf(stderr, "Usage: iv2glb <input.iv> <output.glb>\n");
+  std::string statsPath;
+  bool scanOnly = false;
+  bool metadataOnly = false;
+  bool splitFiles = false;
+  bool fastParseEnabled = true;
+  std::string cacheDir;
+  std::string saveMeshPath;
+  size_t maxTriangles = 0;
+  int assemblyDepth = 0;
+  std::string previewPath;
+  int proxyDepth = -1;  // --proxy-boxes; -1 = off
+  std::vector<std::string> positional;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--stats" && i + 1 < argc) {
+      statsPath = argv[++i];
+    } else if (arg == "--scan") {
+      scanOnly = true;
+    } else if (arg == "--metadata-only") {
+      metadataOnly = true;
+    } else if (arg == "--deadline-ms" && i + 1 < argc) {
+      g_run.deadline = std::chrono::steady_clock::now() +
+                       std::chrono::milliseconds(std::atoll(argv[++i]));
+    } else if (arg == "--max-rss-mb" && i + 1 < argc) {
+      g_run.maxRssKb = std::atol(argv[++i]) * 1024;
+    } else if (arg == "--max-triangles" && i + 1 < argc) {
+      maxTriangles = static_cast<size_t>(std::atoll(argv[++i]));
+    } else if (arg == "--degrade") {
+      g_run.degrade = true;
+    } else if (arg == "--split-files") {
+      splitFiles = true;
+    } else if (arg == "--cache-dir" && i + 1 < argc) {
+      cacheDir = argv[++i];
+    } else if (arg == "--io" && i + 1 < argc) {
+      const std::string mode = argv[++i];
+      if (mode == "uring") g_ioMode = IoMode::kUring;
+      else if (mode == "thread") g_ioMode = IoMode::kThread;
+      else if (mode == "sync") g_ioMode = IoMode::kSync;
+      else {
+        std::fprintf(stderr, "Unknown --io mode: %s\n", mode.c_str());
+        usage();
+        return 2;
+      }
+    } else if (arg == "--no-fast-parse") {
+      fastParseEnabled = false;
+    } else if (arg == "--save-mesh" && i + 1 < argc) {
+      saveMeshPath = argv[++i];
+    } else if (arg == "--split-assemblies" && i + 1 < argc) {
+      assemblyDepth = std::atoi(argv[++i]);
+      if (assemblyDepth < 1) {
+        std::fprintf(stderr, "--split-assemblies needs a depth of at least 1\n");
+        usage();
+        return 2;
+      }
+    } else if (arg == "--proxy-boxes" && i + 1 < argc) {
+      proxyDepth = std::atoi(argv[++i]);
+      if (proxyDepth < 0) {
+        std::fprintf(stderr, "--proxy-boxes needs a depth of 0 (per shape) or more\n");
+        usage();
+        return 2;
+      }
+    } else if (arg == "--thumbnail" && i + 1 < argc) {
+      g_thumbnailPath = argv[++i];
+    } else if (arg == "--thumbnail-size" && i + 1 < argc) {
+      g_thumbnailSize = std::atoi(argv[++i]);
+      if (g_thumbnailSize < 16 || g_thumbnailSize > 4096) {
+        std::fprintf(stderr, "--thumbnail-size must be between 16 and 4096\n");
+        usage();
+        return 2;
+      }
+    } else if (arg == "--texture-max-size" && i + 1 < argc) {
+      g_textures.maxSize = std::atoi(argv[++i]);
+      if (g_textures.maxSize < 1 || g_textures.maxSize > 16384) {
+        std::fprintf(stderr, "--texture-max-size must be between 1 and 16384\n");
+        usage();
+        return 2;
+      }
+    } else if (arg == "--texture-atlas") {
+      g_textures.atlas = true;
+    } else if (arg == "--texture-format" && i + 1 < argc) {
+      const std::string format = argv[++i];
+      if (format == "png") g_textures.format = TextureFormat::kPng;
+      else if (format == "etc1s") g_textures.format = TextureFormat::kEtc1s;
+      else if (format == "uastc") g_textures.format = TextureFormat::kUastc;
+      else {
+        std::fprintf(stderr, "Unknown --texture-format: %s\n", format.c_str());
+        usage();
+        return 2;
+      }
+      if (format != "png" && !IV2GLB_HAVE_BASISU) {
+        std::fprintf(stderr, "--texture-format %s needs a build with Basis Universal (IV2GLB_HAVE_BASISU)\n",
+                     format.c_str());
+        return 2;
+      }
+    } else if (arg == "--preview" && i + 1 < argc) {
+      previewPath = argv[++i];
+    } else if (arg == "--chunk-triangles" && i + 1 < argc) {
+      g_chunkTriangles = static_cast<size_t>(std::atoll(argv[++i]));
+    } else if (arg.size() > 1 && arg[0] == '-') {
+      std::fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+      usage();
+      return 2;
+    } else {
+      positional.push_back(arg);
+    }
+  }
+  if (scanOnly && positional.size() == 1) {
+    return runScan(positional[0]);
+  }
+  if (positional.size() != (metadataOnly ? 1u : 2u) || scanOnly) {
+    usage();
+    return 2;
+  }
+
+  const std::string inPath = positional[0];
+  const std::string outPath = metadataOnly ? std::string() : positional[1];
+  if (metadataOnly && (assemblyDepth || splitFiles || proxyDepth >= 0 || !saveMeshPath.empty() ||
+                       !previewPath.empty() || !g_thumbnailPath.empty())) {
+    std::fprintf(stderr, "--metadata-only writes no geometry; drop the output options\n");
+    usage();
+    return 2;
+  }
+  if (assemblyDepth && !saveMeshPath.empty()) {
+    std::fprintf(stderr, "--split-assemblies cannot be combined with --save-mesh\n");
+    usage();
+    return 2;
+  }
+  if (proxyDepth >= 0 && (assemblyDepth || splitFiles || !saveMeshPath.empty() || !previewPath.empty() ||
+                          !g_thumbnailPath.empty())) {
+    std::fprintf(stderr, "--proxy-boxes is an output of its own; drop the other output options\n");
+    usage();
+    return 2;
+  }
+  if (previewPath == "-" || (!previewPath.empty() && previewPath == outPath)) {
+    std::fprintf(stderr, "--preview needs a file path of its own\n");
+    usage();
     return 2;
   }
+  if (outPath == "-") {
+    if (splitFiles || assemblyDepth) {
+      usage();
+      return 2;
+    }
+    // A reader that goes away fails the write (exit 5) instead of killing us.
+    std::signal(SIGPIPE, SIG_IGN);
+  }
+  ConvertStats stats;
+
+  struct stat st;
+  if (::stat(inPath.c_str(), &st) == 0) stats.inputBytes = static_cast<uint64_t>(st.st_size);
 
-  const std::string inPath = argv[1];
-  const std::string outPath = argv[2];
+  std::signal(SIGTERM, onTerminateSignal);
+  std::signal(SIGINT, onTerminateSignal);
+  std::atomic<bool> watchdogDone{false};
+  enterStage(kStageParse, stats);
+  std::thread watchdog(watchdogLoop, statsPath, &watchdogDone);
+  auto stopWatchdog = [&]() {
+    watchdogDone.store(true);
+    if (watchdog.joinable()) watchdog.join();
+  };
 
   // Initialize Coin database (required before reading). [web:211]
   SoDB::init();
 
+  // A mesh file from an earlier --save-mesh: straight to export.
+  if (!isStreamPath(inPath) && isMeshFile(inPath)) {
+    if (assemblyDepth || proxyDepth >= 0) {
+      stopWatchdog();
+      std::fprintf(stderr, "%s needs a scene graph, not a mesh file\n",
+                   assemblyDepth ? "--split-assemblies" : "--proxy-boxes");
+      return 2;
+    }
+    if (!previewPath.empty()) stats.warnings.push_back("Preview skipped: mesh file input is exported directly.");
+    MeshOut mesh;
+    std::string err;
+    const auto t0 = std::chrono::steady_clock::now();
+    if (!loadMeshFile(inPath, mesh, err)) {
+      stopWatchdog();
+      std::fprintf(stderr, "Failed to load mesh file: %s\n", err.c_str());
+      return 4;
+    }
+    stats.parseMs = msSince(t0);
+    stats.shapeCount = mesh.parts.size();
+    stats.triangleCount = mesh.triangleCount();
+    int code;
+    if (metadataOnly) {
+      if (mesh.triangleCount()) {
+        extendBounds(stats.meta.bmin, stats.meta.bmax, mesh.posMin[0], mesh.posMin[1], mesh.posMin[2]);
+        extendBounds(stats.meta.bmin, stats.meta.bmax, mesh.posMax[0], mesh.posMax[1], mesh.posMax[2]);
+      }
+      code = printMetadata(stats);
+    } else {
+      code = exportMesh(mesh, outPath, std::string(), maxTriangles, stats);
+    }
+    stopWatchdog();
+    if (abortName(code)) return abortRun(stats, statsPath, code);
+    if (code == 0) finishStats(stats, statsPath);
+    return code;
+  }
+
+  // Zips are read in place (mapped), so only from a regular file.
+  if (!isStreamPath(inPath) && isZipFile(inPath)) {
+    if (assemblyDepth || proxyDepth >= 0 || metadataOnly) {
+      stopWatchdog();
+      std::fprintf(stderr, "%s does not apply to zip input\n",
+                   assemblyDepth ? "--split-assemblies" : proxyDepth >= 0 ? "--proxy-boxes" : "--metadata-only");
+      return 2;
+    }
+    if (!previewPath.empty()) stats.warnings.push_back("Preview skipped: not available for zip input.");
+    const int code = convertZip(inPath, outPath, splitFiles, maxTriangles, stats);
+    stopWatchdog();
+    if (abortName(code)) return abortRun(stats, statsPath, code);
+    if (code == 0) finishStats(stats, statsPath);
+    return code;
+  }
+
+  std::string cachePath;
+  bool cacheHit = false;
+  if (!cacheDir.empty() && !isStreamPath(inPath)) {
+    const auto tc = std::chrono::steady_clock::now();
+    cachePath = parseCachePath(cacheDir, inPath);
+    stats.cacheMs = msSince(tc);
+    cacheHit = !cachePath.empty() && parseCacheHit(cachePath);
+    stats.cache = cacheHit ? "hit" : "miss";
+  }
+
+  // A FIFO/pipe input is parsed as it arrives (main.py streams the download
+  // into one), and gzip/zstd input is decompressed on the fly while it is
+  // parsed; SoInput does not close a FILE * it was given, so we do.
   SoInput in;
-  if (!in.openFile(inPath.c_str())) { // Open Inventor file input. [web:209]
-    std::fprintf(stderr, "Failed to open input file: %s\n", inPath.c_str());
-    return 3;
+  // SoFile names are relative to the input when Coin reads something else.
+  const size_t slash = inPath.rfind('/');
+  const std::string inputDir = slash == std::string::npos ? "." : inPath.substr(0, slash);
+  FILE *streamFp = nullptr;
+  StreamCookie *streamCookie = nullptr;
+  Compression compression = Compression::kNone;
+  auto openSource = [&]() -> bool {
+    // Files are read ahead of the parser through the same stream (--io).
+    if (isStreamPath(inPath) || isCompressedFile(inPath) || g_ioMode != IoMode::kSync) {
+      streamFp = openInputStream(inPath, &streamCookie, &compression);
+      if (!streamFp) return false;
+      SoInput::addDirectoryFirst(inputDir.c_str());
+      in.setFilePointer(streamFp);
+      return true;
+    }
+    return in.openFile(inPath.c_str()); // Open Inventor file input. [web:209]
+  };
+  if (cacheHit) {
+    SoInput::addDirectoryFirst(inputDir.c_str());
+    cacheHit = in.openFile(cachePath.c_str());
   }
 
-  SoNode *root = SoDB::readAll(&in); // Read full scene graph. [web:211]
-  if (!root) {
-    std::fprintf(stderr, "SoDB::readAll() failed (invalid/unsupported .iv).\n");
-    return 4;
+  // --degrade with a memory cap reads and converts one top-level node at a
+  // time, which never holds the whole scene; assemblies need the scene, and
+  // --metadata-only collects no geometry to degrade.
+  const bool streamTraverse = g_run.degrade && g_run.maxRssKb && !assemblyDepth && !metadataOnly;
+
+  // Large Coordinate3/IndexedFaceSet arrays of plain ASCII input are parsed
+  // outside SoInput; Coin reads the rest from memory. Not with the
+  // one-node-at-a-time read of a memory budget, which never holds the scene.
+  FastParse fast;
+  bool fastParse = false;
+  if (fastParseEnabled && !cacheHit && !streamTraverse &&
+      !isStreamPath(inPath) && !isCompressedFile(inPath)) {
+    const auto tf = std::chrono::steady_clock::now();
+    fastParse = prepareFastParse(inPath, fast);
+    stats.fastParseMs = msSince(tf);
+    if (fastParse) {
+      SoInput::addDirectoryFirst(inputDir.c_str());
+      in.setBuffer(fast.text.data(), fast.text.size());
+    } else {
+      fast.release();
+    }
+  }
+  if (!cacheHit && !fastParse && !openSource()) {
+    stopWatchdog();
+    std::fprintf(stderr, "Failed to open input file: %s\n", inPath.c_str());
+    return 3;
   }
-  root->ref();
 
   MeshOut mesh;
+  TraverseCtx ctx;
+  ctx.mesh = &mesh;
+  ctx.stats = &stats;
+  ctx.maxTriangles = maxTriangles;
+
+  AssemblyTraversal assemblies;
+  assemblies.ctx = &ctx;
+  assemblies.rest = &mesh;
+  assemblies.pathLength = assemblyDepth + 1;  // the root alone is length 1
+
+  ProxyTraversal proxy;
+  proxy.stats = &stats;
+  proxy.pathLength = proxyDepth > 0 ? proxyDepth + 1 : 0;
 
   SoCallbackAction action;
-  action.addTriangleCallback(SoShape::getClassTypeId(), triangleCB, &mesh); // [web:248]
-  action.apply(root);
+  action.addPreCallback(SoNode::getClassTypeId(), budgetPreCB, nullptr);
+  if (metadataOnly) {
+    action.addPreCallback(SoShape::getClassTypeId(), metadataShapeCB, &stats);
+  } else if (proxyDepth >= 0) {
+    // Bounds only: shapes are pruned before they generate triangles.
+    if (proxy.pathLength) {
+      action.addPreCallback(SoNode::getClassTypeId(), proxyGroupPreCB, &proxy);
+      action.addPostCallback(SoNode::getClassTypeId(), proxyGroupPostCB, &proxy);
+    }
+    action.addPreCallback(SoShape::getClassTypeId(), proxyShapeCB, &proxy);
+  } else {
+    if (assemblyDepth) {
+      action.addPreCallback(SoNode::getClassTypeId(), assemblyPreCB, &assemblies);
+      action.addPostCallback(SoNode::getClassTypeId(), assemblyPostCB, &assemblies);
+    }
+    action.addPreCallback(SoShape::getClassTypeId(), shapePreCB, &ctx);
+    action.addTriangleCallback(SoShape::getClassTypeId(), triangleCB, &ctx); // [web:248]
+  }
 
-  root->unref();
+  uint64_t countedTriangles = 0;  // --metadata-only
+  auto t0 = std::chrono::steady_clock::now();
+  if (streamTraverse) {
+    stats.warnings.push_back("Memory budget set: parsed and converted one top-level node at a time.");
+    if (!previewPath.empty()) {
+      stats.warnings.push_back("Preview skipped: the scene is never held whole under a memory budget.");
+    }
+    if (!streamReadAndTraverse(in, action, stats)) {
+      stopWatchdog();
+      std::fprintf(stderr, "SoDB::read() failed (invalid/unsupported .iv).\n");
+      return 4;
+    }
+  } else {
+    SoNode *root = SoDB::readAll(&in); // Read full scene graph. [web:211]
+    if (!root && cacheHit) {
+      // Unreadable cache entry: drop it and parse the source instead.
+      std::fprintf(stderr, "Warning: discarding unreadable cache entry %s\n", cachePath.c_str());
+      in.closeFile();
+      ::unlink(cachePath.c_str());
+      cacheHit = false;
+      stats.cache = "miss";
+      if (openSource()) root = SoDB::readAll(&in);
+    }
+    if (fastParse) {
+      if (root) root->ref();
+      if (!root || !applyFastParse(root, fast)) {
+        // A placeholder the search could not reach (or the read failed):
+        // read the file the ordinary way.
+        std::fprintf(stderr, "Warning: fast array parse not applicable, reading with Coin only\n");
+        if (root) root->unref();
+        root = nullptr;
+        in.closeFile();
+        if (openSource()) root = SoDB::readAll(&in);
+        if (root) root->ref();
+      } else {
+        stats.fastArrays = fast.placeholders;
+      }
+      fast.release();
+      if (root) root->unrefNoDelete();
+    }
+    if (!root) {
+      stopWatchdog();
+      std::fprintf(stderr, "SoDB::readAll() failed (invalid/unsupported .iv).\n");
+      return 4;
+    }
+    root->ref();
+    stats.parseMs = stats.fastParseMs + msSince(t0);
+    countNodes(root, stats);
+    collectTopLevelParts(root, stats.meta.topLevelParts);
+    if (!cachePath.empty() && !cacheHit) {
+      const auto tc = std::chrono::steady_clock::now();
+      if (writeParseCache(root, cachePath)) stats.cache = "stored";
+      else std::fprintf(stderr, "Warning: could not write cache entry %s\n", cachePath.c_str());
+      stats.cacheMs += msSince(tc);
+    }
 
-  std::string err;
-  if (!writeGLB(mesh, outPath, err)) {
-    std::fprintf(stderr, "GLB export failed: %s\n", err.c_str());
-    return 5;
+    enterStage(kStageTraverse, stats);
+    if (!previewPath.empty()) writePreview(root, previewPath, stats);
+
+    t0 = std::chrono::steady_clock::now();
+    action.apply(root);
+    if (metadataOnly && !g_run.abortCode.load()) {
+      // What the traversal would generate, counted per shape without
+      // collecting the triangles.
+      SoGetPrimitiveCountAction count;
+      count.apply(root);
+      countedTriangles = static_cast<uint64_t>(count.getTriangleCount());
+    }
+    stats.traverseMs = msSince(t0);
+    root->unref();
+  }
+  stats.triangleCount = metadataOnly ? countedTriangles : ctx.priorTriangles + ctx.mesh->triangleCount();
+  if (streamFp) {
+    // A read error would otherwise look like EOF and yield a partial model.
+    const bool readError = std::ferror(streamFp);
+    if (compression != Compression::kNone || isStreamPath(inPath)) stats.inputBytes = streamCookie->filled;
+    in.closeFile();
+    std::fclose(streamFp);
+    if (readError && !g_run.abortCode.load()) {
+      stopWatchdog();
+      std::fprintf(stderr, "Input read failed (truncated or corrupt %s data).\n",
+                   compression == Compression::kNone ? "input" : compressionName(compression));
+      return 4;
+    }
   }
 
-  std::fprintf(stdout, "OK: wrote %s (%zu triangles)\n",
-               outPath.c_str(), mesh.indices.size() / 3);
-  return 0;
+  if (const int code = g_run.abortCode.load()) {
+    stopWatchdog();
+    return abortRun(stats, statsPath, code);
+  }
+  if (ctx.compactions) {
+    stats.warnings.push_back("Memory budget pressure: geometry compacted " +
+                             std::to_string(ctx.compactions) + " time(s) during traversal.");
+  }
+  int code;
+  if (metadataOnly) code = printMetadata(stats);
+  else if (proxyDepth >= 0) code = exportProxy(proxy, outPath, stats);
+  else if (assemblyDepth) code = exportAssemblies(assemblies, outPath, maxTriangles, stats);
+  else code = exportMesh(mesh, outPath, saveMeshPath, maxTriangles, stats);
+  stopWatchdog();
+  if (abortName(code)) return abortRun(stats, statsPath, code);
+  if (code == 0) finishStats(stats, statsPath);
+  return code;
 }
@@ -0,0 +1,522 @@
+// Fast path for the bulk arrays of ASCII Inventor / VRML 1.0 input.
+//
+// On geometry-heavy files nearly all of the text is Coordinate3.point and
+// IndexedFaceSet.coordIndex values, and SoInput reads those one number at a
+// time through its generic field machinery. Here the mapped file is
+// tokenized just enough to find those arrays; each is parsed straight into
+// a float/int32 vector, and SoDB reads a copy of the file in which the array
+// is replaced by a tagged one-value placeholder. After readAll the parsed
+// values are put back into the fields the placeholders landed in. Anything
+// the fast parser does not understand is left in the text for Coin.
+//
+// Floats are read as double and narrowed, as SoInput does. Plain decimal
+// literals with up to 19 significant digits and a small exponent take the
+// exact Clinger fast path (8 digits at a time, SWAR); the rest go through
+// strtod, so results match Coin bit for bit.
+//
+// Arrays are cut at separators into chunks of about kFastChunkBytes, and
+// the chunks of all arrays are parsed on a thread pool. Every number lies
+// inside one chunk and is parsed without context, so the concatenated
+// chunks are exactly the serial result; they are copied straight into the
+// field's own storage once Coin has sized it.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <Inventor/actions/SoSearchAction.h>
+#include <Inventor/nodekits/SoBaseKit.h>
+#include <Inventor/nodes/SoCoordinate3.h>
+#include <Inventor/nodes/SoIndexedFaceSet.h>
+
+// Arrays with less text than this are left to Coin.
+static constexpr size_t kFastArrayMinBytes = 4096;
+// Unit of work for the parser threads.
+static constexpr size_t kFastChunkBytes = 4 << 20;
+
+struct FastChunk {
+  size_t begin = 0, end = 0;  // text, cut at a separator outside comments
+  bool ok = false;
+  std::vector<float> floats;  // kPoints: xyz xyz ... (a triple may straddle chunks)
+  std::vector<int32_t> ints;  // kCoordIndex
+};
+
+struct FastArray {
+  enum Kind { kPoints, kCoordIndex };
+  Kind kind;
+  size_t begin = 0, end = 0;  // value text between '[' and ']'
+  bool parsed = false;        // else the original text is kept
+  bool applied = false;
+  size_t count = 0;           // numbers over all chunks
+  std::vector<FastChunk> chunks;
+
+  // Copies the chunks, in order, to `out` (room for `count` values) and
+  // frees them.
+  template <typename T>
+  void moveTo(T *out) {
+    for (FastChunk &c : chunks) {
+      std::vector<T> &v = values(c, out);
+      std::copy(v.begin(), v.end(), out);
+      out += v.size();
+    }
+    std::vector<FastChunk>().swap(chunks);
+  }
+
+private:
+  static std::vector<float> &values(FastChunk &c, float *) { return c.floats; }
+  static std::vector<int32_t> &values(FastChunk &c, int32_t *) { return c.ints; }
+};
+
+struct FastParse {
+  const char *data = nullptr;  // mapped input
+  size_t size = 0;
+  std::vector<FastArray> arrays;
+  std::string text;            // input with the parsed arrays as placeholders
+  size_t placeholders = 0;
+  uint64_t values = 0;         // numbers parsed on the fast path
+
+  FastParse() = default;
+  FastParse(const FastParse &) = delete;
+  FastParse &operator=(const FastParse &) = delete;
+  ~FastParse() { release(); }
+
+  // Drops the mapping and buffers once the scene has been read.
+  void release() {
+    if (data) ::munmap(const_cast<char *>(data), size);
+    data = nullptr;
+    std::vector<FastArray>().swap(arrays);
+    std::string().swap(text);
+  }
+};
+
+namespace ivfast {
+
+// Placeholder marker; exact in float and not a valid coordinate index.
+constexpr int32_t kTag = -16777216;
+
+inline bool isSpace(unsigned char c) { return c <= ' ' || c == ','; }
+inline bool isDigit(unsigned char c) { return static_cast<unsigned>(c - '0') < 10u; }
+inline bool endsToken(const char *p, const char *e) {
+  return p == e || isSpace(*p) || *p == ']' || *p == '#';
+}
+
+// Skips separators and comments; returns false at the end of the range.
+inline bool skipSpace(const char *&p, const char *e) {
+  while (p < e) {
+    if (isSpace(*p)) {
+      ++p;
+    } else if (*p == '#') {
+      const void *nl = std::memchr(p, '\n', e - p);
+      p = nl ? static_cast<const char *>(nl) + 1 : e;
+    } else {
+      return true;
+    }
+  }
+  return false;
+}
+
+inline uint64_t load8(const char *p) {
+  uint64_t v;
+  std::memcpy(&v, p, 8);
+  return v;
+}
+inline bool isEightDigits(uint64_t v) {
+  return ((v & 0xF0F0F0F0F0F0F0F0ull) |
+          (((v + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+}
+inline uint32_t parseEightDigits(uint64_t v) {
+  v -= 0x3030303030303030ull;
+  v = (v * 10) + (v >> 8);
+  v = (((v & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) +
+       (((v >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+  return static_cast<uint32_t>(v);
+}
+
+// Appends decimal digits at p to `mant`, counting them in `nd`.
+inline void readDigits(const char *&p, const char *e, uint64_t &mant, int &nd) {
+  while (e - p >= 8 && nd <= 11) {
+    const uint64_t v = load8(p);
+    if (!isEightDigits(v)) break;
+    mant = mant * 100000000ull + parseEightDigits(v);
+    nd += 8;
+    p += 8;
+  }
+  for (; p < e && isDigit(*p); ++p, ++nd) {
+    if (nd < 19) mant = mant * 10 + static_cast<unsigned>(*p - '0');
+  }
+}
+
+// Token at p through strtod/strtol (NUL-terminated copy); false if too long
+// or not entirely a number.
+inline bool slowToken(const char *&p, const char *e, bool isFloat, double &d, long &l) {
+  const char *t = p;
+  while (!endsToken(t, e)) ++t;
+  char buf[64];
+  const size_t n = static_cast<size_t>(t - p);
+  if (n == 0 || n >= sizeof(buf)) return false;
+  std::memcpy(buf, p, n);
+  buf[n] = '\0';
+  char *stop;
+  if (isFloat) d = std::strtod(buf, &stop);
+  else l = std::strtol(buf, &stop, 0);
+  if (stop != buf + n) return false;
+  p = t;
+  return true;
+}
+
+inline bool parseDouble(const char *&p, const char *e, double &out) {
+  static const double kPow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                  1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                  1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  const char *start = p;
+  const bool neg = (*p == '-');
+  if (*p == '-' || *p == '+') ++p;
+  uint64_t mant = 0;
+  int nd = 0;
+  readDigits(p, e, mant, nd);
+  int exp10 = 0;
+  if (p < e && *p == '.') {
+    ++p;
+    const int intDigits = nd;
+    readDigits(p, e, mant, nd);
+    exp10 = -(nd - intDigits);
+  }
+  bool fast = nd > 0 && nd <= 19;
+  if (fast && p < e && (*p == 'e' || *p == 'E')) {
+    ++p;
+    const bool eneg = (p < e && *p == '-');
+    if (p < e && (*p == '-' || *p == '+')) ++p;
+    int x = 0, xd = 0;
+    for (; p < e && isDigit(*p); ++p, ++xd) {
+      if (x < 10000) x = x * 10 + (*p - '0');
+    }
+    fast = xd > 0;
+    exp10 += eneg ? -x : x;
+  }
+  fast = fast && endsToken(p, e) && mant <= (1ull << 53) && exp10 >= -22 && exp10 <= 22;
+  if (fast) {
+    const double m = static_cast<double>(mant);
+    out = exp10 < 0 ? m / kPow10[-exp10] : m * kPow10[exp10];
+    if (neg) out = -out;
+    return true;
+  }
+  p = start;
+  long unused;
+  return slowToken(p, e, true, out, unused);
+}
+
+inline bool parseInt32(const char *&p, const char *e, int32_t &out) {
+  const char *start = p;
+  const bool neg = (*p == '-');
+  if (*p == '-' || *p == '+') ++p;
+  // Hex and octal (0x1f, 017) are valid Inventor integers; leave them to strtol.
+  if (p < e && *p == '0' && e - p > 1 && (isDigit(p[1]) || p[1] == 'x' || p[1] == 'X')) {
+    p = start;
+  } else {
+    int64_t v = 0;
+    int nd = 0;
+    for (; p < e && isDigit(*p) && nd < 11; ++p, ++nd) v = v * 10 + (*p - '0');
+    if (nd > 0 && nd < 11 && endsToken(p, e)) {
+      v = neg ? -v : v;
+      if (v < INT32_MIN || v > INT32_MAX) return false;
+      out = static_cast<int32_t>(v);
+      return true;
+    }
+    p = start;
+  }
+  double unused;
+  long l;
+  if (!slowToken(p, e, false, unused, l) || l < INT32_MIN || l > INT32_MAX) return false;
+  out = static_cast<int32_t>(l);
+  return true;
+}
+
+// Parses one chunk of an array; false if it holds anything but numbers.
+inline bool parseChunk(const char *data, FastArray::Kind kind, FastChunk &c) {
+  const char *p = data + c.begin, *e = data + c.end;
+  if (kind == FastArray::kPoints) {
+    c.floats.reserve((c.end - c.begin) / 8);
+    double d;
+    while (skipSpace(p, e)) {
+      if (!parseDouble(p, e, d)) return false;
+      c.floats.push_back(static_cast<float>(d));
+    }
+  } else {
+    c.ints.reserve((c.end - c.begin) / 4);
+    int32_t v;
+    while (skipSpace(p, e)) {
+      if (!parseInt32(p, e, v)) return false;
+      c.ints.push_back(v);
+    }
+  }
+  return true;
+}
+
+// First chunk boundary at or after `at`: a newline within a quarter chunk
+// (which also ends any comment), or, on long lines, a separator with no
+// comment open on its line.
+inline size_t chunkCut(const char *data, size_t at, size_t end, size_t chunkBytes = kFastChunkBytes) {
+  const size_t limit = std::min(end, at + chunkBytes / 4);
+  for (size_t i = at; i < limit; ++i) {
+    if (data[i] == '\n') return i + 1;
+  }
+  const char *lineStart = static_cast<const char *>(::memrchr(data, '\n', at));
+  lineStart = lineStart ? lineStart + 1 : data;
+  if (!std::memchr(lineStart, '#', data + at - lineStart)) {
+    for (size_t i = at; i < end; ++i) {
+      if (isSpace(data[i])) return i + 1;
+      if (data[i] == '#') break;
+    }
+  }
+  const void *nl = std::memchr(data + at, '\n', end - at);
+  return nl ? static_cast<size_t>(static_cast<const char *>(nl) - data) + 1 : end;
+}
+
+// Cuts `a` into chunks of about `chunkBytes` (smaller in tests).
+inline void splitArray(const char *data, FastArray &a, size_t chunkBytes = kFastChunkBytes) {
+  for (size_t at = a.begin; at < a.end;) {
+    const size_t cut = a.end - at <= chunkBytes ? a.end : chunkCut(data, at + chunkBytes, a.end, chunkBytes);
+    FastChunk c;
+    c.begin = at;
+    c.end = cut;
+    a.chunks.push_back(std::move(c));
+    at = cut;
+  }
+}
+
+// Parses every chunk of every array on up to hardware_concurrency threads.
+inline void parseArrays(FastParse &fp) {
+  std::vector<std::pair<FastArray *, FastChunk *>> work;
+  for (FastArray &a : fp.arrays) {
+    splitArray(fp.data, a);
+    for (FastChunk &c : a.chunks) work.emplace_back(&a, &c);
+  }
+  std::atomic<size_t> next{0};
+  auto worker = [&]() {
+    for (size_t i; (i = next.fetch_add(1)) < work.size();) {
+      FastChunk &c = *work[i].second;
+      c.ok = parseChunk(fp.data, work[i].first->kind, c);
+    }
+  };
+  const unsigned threads = std::max(1u, std::min<unsigned>(std::thread::hardware_concurrency(),
+                                                           static_cast<unsigned>(work.size())));
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads; ++t) pool.emplace_back(worker);
+  worker();
+  for (std::thread &t : pool) t.join();
+
+  for (FastArray &a : fp.arrays) {
+    a.parsed = true;
+    for (const FastChunk &c : a.chunks) {
+      a.parsed = a.parsed && c.ok;
+      a.count += c.floats.size() + c.ints.size();
+    }
+    if (a.count == 0 || (a.kind == FastArray::kPoints && a.count % 3)) a.parsed = false;
+    if (!a.parsed) {
+      std::vector<FastChunk>().swap(a.chunks);
+      a.count = 0;
+    }
+    fp.values += a.count;
+  }
+}
+
+// End of the array whose values start at p ('[' already consumed): the
+// first ']' outside a comment, or nullptr.
+inline const char *findArrayEnd(const char *p, const char *e) {
+  for (;;) {
+    const char *close = static_cast<const char *>(std::memchr(p, ']', e - p));
+    if (!close) return nullptr;
+    const char *hash = static_cast<const char *>(std::memchr(p, '#', close - p));
+    if (!hash) return close;
+    const void *nl = std::memchr(hash, '\n', e - hash);
+    if (!nl) return nullptr;
+    p = static_cast<const char *>(nl) + 1;
+  }
+}
+
+// Walks the structure (node bodies, field names) and records the arrays
+// worth taking. Strings and comments are skipped; other arrays are
+// tokenized through, since in Inventor they may hold nodes.
+inline void locateArrays(FastParse &fp, size_t from) {
+  const char *p = fp.data + from, *e = fp.data + fp.size;
+  std::vector<std::string> nodeStack;
+  std::string pending;  // last identifier: a node type before '{', a field name before '['
+  while (p < e) {
+    const char c = *p;
+    if (isSpace(c)) {
+      ++p;
+    } else if (c == '#') {
+      const void *nl = std::memchr(p, '\n', e - p);
+      p = nl ? static_cast<const char *>(nl) + 1 : e;
+    } else if (c == '"') {
+      for (++p; p < e && *p != '"'; ++p) {
+        if (*p == '\\') ++p;
+      }
+      ++p;
+      pending.clear();
+    } else if (c == '{') {
+      nodeStack.push_back(pending);
+      pending.clear();
+      ++p;
+    } else if (c == '}') {
+      if (!nodeStack.empty()) nodeStack.pop_back();
+      pending.clear();
+      ++p;
+    } else if (c == '[') {
+      ++p;
+      static const std::string kNone;
+      const std::string &owner = nodeStack.empty() ? kNone : nodeStack.back();
+      FastArray a;
+      if (pending == "point" && (owner == "Coordinate3" || owner == "SoCoordinate3")) {
+        a.kind = FastArray::kPoints;
+      } else if (pending == "coordIndex" && (owner == "IndexedFaceSet" || owner == "SoIndexedFaceSet")) {
+        a.kind = FastArray::kCoordIndex;
+      } else {
+        pending.clear();
+        continue;
+      }
+      pending.clear();
+      const char *close = findArrayEnd(p, e);
+      if (!close) return;  // unterminated: Coin reports it
+      if (static_cast<size_t>(close - p) >= kFastArrayMinBytes) {
+        a.begin = static_cast<size_t>(p - fp.data);
+        a.end = static_cast<size_t>(close - fp.data);
+        fp.arrays.push_back(std::move(a));
+      }
+      p = close + 1;
+    } else if (c == ']') {
+      pending.clear();
+      ++p;
+    } else {
+      const char *t = p;
+      while (t < e && !isSpace(*t) && *t != '{' && *t != '}' && *t != '[' && *t != ']' &&
+             *t != '"' && *t != '#') {
+        ++t;
+      }
+      if (isDigit(c) || c == '-' || c == '+' || c == '.') pending.clear();
+      else pending.assign(p, t);
+      p = t;
+    }
+  }
+}
+
+// The input with each parsed array replaced by "[ tag id tag ]" (points) or
+// "[ tag, id ]" (indices), id being its position in fp.arrays.
+inline void buildText(FastParse &fp) {
+  size_t kept = fp.size;
+  for (const FastArray &a : fp.arrays) {
+    if (a.parsed) kept -= a.end - a.begin;
+  }
+  fp.text.clear();
+  fp.text.reserve(kept + fp.arrays.size() * 40);
+  size_t at = 0;
+  char tag[64];
+  for (size_t i = 0; i < fp.arrays.size(); ++i) {
+    const FastArray &a = fp.arrays[i];
+    if (!a.parsed) continue;
+    fp.text.append(fp.data + at, a.begin - at);
+    if (a.kind == FastArray::kPoints) {
+      std::snprintf(tag, sizeof(tag), " %d %zu %d ", kTag, i, kTag);
+    } else {
+      std::snprintf(tag, sizeof(tag), " %d, %zu ", kTag, i);
+    }
+    fp.text += tag;
+    at = a.end;
+    ++fp.placeholders;
+  }
+  fp.text.append(fp.data + at, fp.size - at);
+}
+
+}  // namespace ivfast
+
+// Maps `path` and prepares fp.text for SoInput::setBuffer. False if the fast
+// path does not apply (not ASCII Inventor / VRML 1.0, nothing big enough, or
+// nothing it could parse); the caller then reads the file as usual.
+static bool prepareFastParse(const std::string &path, FastParse &fp) {
+  using namespace ivfast;
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < 16) {
+    ::close(fd);
+    return false;
+  }
+  void *map = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) return false;
+  ::madvise(map, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+  fp.data = static_cast<const char *>(map);
+  fp.size = static_cast<size_t>(st.st_size);
+
+  const char *nl = static_cast<const char *>(std::memchr(fp.data, '\n', fp.size));
+  if (!nl) return false;
+  const std::string header(fp.data, nl);
+  const bool inventor = header.rfind("#Inventor V", 0) == 0 && header.find("ascii") != std::string::npos;
+  if (!inventor && header.rfind("#VRML V1.0 ascii", 0) != 0) return false;
+
+  locateArrays(fp, static_cast<size_t>(nl + 1 - fp.data));
+  parseArrays(fp);
+  buildText(fp);
+  return fp.placeholders > 0;
+}
+
+// Moves the parsed arrays into the fields their placeholders were read into.
+// Returns false unless every placeholder was found (e.g. one inside a node
+// the search cannot reach); the caller then parses the file with Coin alone.
+static bool applyFastParse(SoNode *root, FastParse &fp) {
+  using namespace ivfast;
+  const SbBool kitChildren = SoBaseKit::isSearchingChildren();
+  SoBaseKit::setSearchingChildren(TRUE);
+  size_t applied = 0;
+  auto take = [&](int32_t id, FastArray::Kind kind) -> FastArray * {
+    if (id < 0 || static_cast<size_t>(id) >= fp.arrays.size()) return nullptr;
+    FastArray &a = fp.arrays[id];
+    if (a.kind != kind || !a.parsed || a.applied) return nullptr;
+    a.applied = true;
+    ++applied;
+    return &a;
+  };
+  for (const SoType type : {SoCoordinate3::getClassTypeId(), SoIndexedFaceSet::getClassTypeId()}) {
+    SoSearchAction sa;
+    sa.setType(type);
+    sa.setInterest(SoSearchAction::ALL);
+    sa.setSearchingAll(TRUE);
+    sa.apply(root);
+    const SoPathList &paths = sa.getPaths();
+    for (int i = 0; i < paths.getLength(); ++i) {
+      SoNode *node = paths[i]->getTail();
+      if (type == SoCoordinate3::getClassTypeId()) {
+        SoMFVec3f &field = static_cast<SoCoordinate3 *>(node)->point;
+        if (field.getNum() != 1) continue;
+        const SbVec3f v = field.getValues(0)[0];
+        if (v[0] != float(kTag) || v[2] != float(kTag)) continue;
+        FastArray *a = take(static_cast<int32_t>(v[1]), FastArray::kPoints);
+        if (!a) continue;
+        field.setNum(static_cast<int>(a->count / 3));
+        a->moveTo(&field.startEditing()[0][0]);  // SbVec3f is three packed floats
+        field.finishEditing();
+      } else {
+        SoMFInt32 &field = static_cast<SoIndexedFaceSet *>(node)->coordIndex;
+        if (field.getNum() != 2 || field.getValues(0)[0] != kTag) continue;
+        FastArray *a = take(field.getValues(0)[1], FastArray::kCoordIndex);
+        if (!a) continue;
+        field.setNum(static_cast<int>(a->count));
+        a->moveTo(field.startEditing());
+        field.finishEditing();
+      }
+    }
+  }
+  SoBaseKit::setSearchingChildren(kitChildren);
+  return applied == fp.placeholders;
+}
@@ -0,0 +1,391 @@
+// Fast pre-flight scan of Inventor / VRML input.
+//
+// Tokenizes the file in fixed-size chunks without building a scene graph:
+// validates the header and bracket structure and counts nodes, DEF/USE,
+// coordinates and face indices. Used by `iv2glb --scan` so the worker can
+// reject malformed or oversized uploads before they take a conversion slot.
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+struct ScanResult {
+  std::string kind = "unknown";  // ascii | binary | vrml1 | vrml2 | gzip | zstd | zip | unknown
+  std::string format;            // kind of the (decompressed) content: ascii | binary | vrml1 | vrml2
+  std::string header;            // first line, e.g. "#Inventor V2.1 ascii"
+  bool valid = false;
+  std::string error;
+  uint64_t bytes = 0;            // scanned, i.e. after decompression
+  uint64_t compressedBytes = 0;  // gzip / zstd input size
+  uint64_t nodes = 0;            // node bodies, i.e. "Type {"
+  uint64_t defs = 0;
+  uint64_t uses = 0;
+  uint64_t shapes = 0;
+  uint64_t coordinates = 0;      // points in Coordinate3/4 and VertexProperty
+  uint64_t faceIndices = 0;      // face set coordIndex entries, excluding -1 separators
+  uint64_t faces = 0;
+  uint64_t triangleEstimate = 0; // sum of (verts - 2) over faces / strips
+  uint64_t largestArray = 0;     // values in the biggest [ ... ] list
+  int maxDepth = 0;
+  uint64_t entries = 0;          // zip: Inventor/VRML entries (bytes = their inflated total)
+};
+
+// Buffered byte reader over a file descriptor.
+class ScanReader {
+public:
+  explicit ScanReader(int fd) : fd_(fd), buf_(1 << 20) {}
+  explicit ScanReader(FILE *fp) : fp_(fp), buf_(1 << 20) {}
+
+  inline int peek() {
+    if (pos_ == len_ && !fill()) return -1;
+    return static_cast<unsigned char>(buf_[pos_]);
+  }
+  inline int get() {
+    const int c = peek();
+    if (c >= 0) {
+      ++pos_;
+      if (c == '\n') ++line_;
+    }
+    return c;
+  }
+  uint64_t consumed() const { return total_ - (len_ - pos_); }
+  int line() const { return line_; }
+
+private:
+  bool fill() {
+    if (eof_) return false;
+    ssize_t n;
+    if (fp_) {
+      n = static_cast<ssize_t>(std::fread(buf_.data(), 1, buf_.size(), fp_));
+    } else {
+      do {
+        n = ::read(fd_, buf_.data(), buf_.size());
+      } while (n < 0 && errno == EINTR);
+    }
+    if (n <= 0) {
+      eof_ = true;
+      return false;
+    }
+    pos_ = 0;
+    len_ = static_cast<size_t>(n);
+    total_ += len_;
+    return true;
+  }
+
+  int fd_ = -1;
+  FILE *fp_ = nullptr;
+  std::vector<char> buf_;
+  size_t pos_ = 0;
+  size_t len_ = 0;
+  uint64_t total_ = 0;
+  bool eof_ = false;
+  int line_ = 1;
+};
+
+namespace ivscan {
+
+// Integers saturate here: the counters only need magnitudes, and untrusted
+// digit strings must not overflow.
+constexpr long long kIntLimit = 1000000000000000LL;
+
+inline uint64_t saturatingAdd(uint64_t a, uint64_t b) { return a > UINT64_MAX - b ? UINT64_MAX : a + b; }
+
+enum Token { T_EOF, T_IDENT, T_NUMBER, T_STRING, T_LBRACE, T_RBRACE, T_LBRACKET, T_RBRACKET, T_ERROR };
+
+inline bool isDelimiter(int c) {
+  return c < 0 || c <= ' ' || c == ',' || c == '{' || c == '}' || c == '[' || c == ']' ||
+         c == '"' || c == '#';
+}
+
+// Reads the next token. Identifiers are copied into `text` (capped, they are
+// only compared against short names); numbers only record whether they are
+// an integer and its value, which is all the counters need.
+inline Token nextToken(ScanReader &r, std::string &text, bool &isInt, long long &intValue) {
+  int c;
+  for (;;) {
+    c = r.peek();
+    if (c < 0) return T_EOF;
+    if (c <= ' ' || c == ',') {
+      r.get();
+    } else if (c == '#') {
+      while ((c = r.get()) >= 0 && c != '\n') {}
+    } else {
+      break;
+    }
+  }
+  r.get();
+  switch (c) {
+    case '{': return T_LBRACE;
+    case '}': return T_RBRACE;
+    case '[': return T_LBRACKET;
+    case ']': return T_RBRACKET;
+    case '"':
+      while ((c = r.get()) >= 0) {
+        if (c == '\\') r.get();
+        else if (c == '"') return T_STRING;
+      }
+      text = "unterminated string";
+      return T_ERROR;
+    default: break;
+  }
+  if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.') {
+    const bool neg = (c == '-');
+    isInt = (c != '.');
+    intValue = (c >= '0' && c <= '9') ? (c - '0') : 0;
+    while (!isDelimiter(r.peek())) {
+      c = r.get();
+      if (c >= '0' && c <= '9') intValue = intValue < kIntLimit ? intValue * 10 + (c - '0') : kIntLimit;
+      else isInt = false;
+    }
+    if (neg) intValue = -intValue;
+    return T_NUMBER;
+  }
+  text.assign(1, static_cast<char>(c));
+  while (!isDelimiter(r.peek())) {
+    c = r.get();
+    if (text.size() < 64) text.push_back(static_cast<char>(c));
+  }
+  return T_IDENT;
+}
+
+inline bool isShapeType(const std::string &t) {
+  static const char *const kShapes[] = {
+      "IndexedFaceSet", "FaceSet", "IndexedTriangleStripSet", "TriangleStripSet",
+      "QuadMesh", "IndexedLineSet", "LineSet", "PointSet", "Cube", "Box", "Sphere",
+      "Cone", "Cylinder", "AsciiText", "Text2", "Text3", "NurbsSurface",
+      "IndexedNurbsSurface", "ElevationGrid", "Extrusion", "VRMLIndexedFaceSet",
+      "SoIndexedFaceSet", "SoFaceSet", "SoIndexedTriangleStripSet", "SoTriangleStripSet"};
+  for (const char *s : kShapes) {
+    if (t == s) return true;
+  }
+  return false;
+}
+
+// Shapes whose coordIndex / numVertices describe faces or triangle strips
+// (not lines), so they count towards faces and triangleEstimate.
+inline bool isFaceSetType(const std::string &t) {
+  static const char *const kFaceSets[] = {
+      "IndexedFaceSet", "FaceSet", "IndexedTriangleStripSet", "TriangleStripSet",
+      "VRMLIndexedFaceSet", "SoIndexedFaceSet", "SoFaceSet", "SoIndexedTriangleStripSet",
+      "SoTriangleStripSet"};
+  for (const char *s : kFaceSets) {
+    if (t == s) return true;
+  }
+  return false;
+}
+
+}  // namespace ivscan
+
+// Scans `r` to EOF. Returns false (with result.error set) if the input is
+// not a structurally valid Inventor/VRML file. Binary (and still compressed)
+// inputs are only header-checked; their counters stay zero.
+inline bool scanInventor(ScanReader &r, ScanResult &res) {
+  using namespace ivscan;
+
+  std::string header;
+  int c;
+  while ((c = r.get()) >= 0 && c != '\n' && header.size() < 256) {
+    header.push_back(static_cast<char>(c));
+  }
+  if (!header.empty() && header.back() == '\r') header.pop_back();
+  res.header = header;
+
+  auto drain = [&]() {
+    while (r.get() >= 0) {}
+    res.bytes = r.consumed();
+  };
+
+  if (header.size() >= 2 && static_cast<unsigned char>(header[0]) == 0x1f &&
+      static_cast<unsigned char>(header[1]) == 0x8b) {
+    res.kind = "gzip";
+    res.header.clear();
+    drain();
+    res.valid = true;
+    return true;
+  }
+  if (header.rfind("#Inventor V", 0) == 0) {
+    res.kind = header.find("binary") != std::string::npos ? "binary" : "ascii";
+  } else if (header.rfind("#VRML V1.0", 0) == 0) {
+    res.kind = "vrml1";
+  } else if (header.rfind("#VRML V2.0", 0) == 0) {
+    res.kind = "vrml2";
+  } else {
+    res.header.clear();
+    drain();
+    res.error = "not an Inventor or VRML file (bad header)";
+    return false;
+  }
+  res.format = res.kind;
+  if (res.kind == "binary") {
+    drain();
+    res.valid = true;
+    return true;
+  }
+
+  std::vector<std::string> nodeStack;  // type names of open node bodies
+  std::string text;
+  std::string pending;                 // identifier not yet classified
+  enum FieldClass { F_OTHER, F_COORD, F_INDEX, F_NUMVERTS };
+  FieldClass field = F_OTHER;          // field the current values belong to
+  bool afterDef = false, afterUse = false;
+  int bracketDepth = 0;
+  uint64_t arrayValues = 0;
+  uint64_t faceVerts = 0;
+  int coordValues = 0;
+  int coordComponents = 3;
+
+  // Classifies a field name once, against the enclosing node type, so the
+  // per-number path is a switch rather than string compares.
+  auto setField = [&](const std::string &name) {
+    static const std::string kNone;
+    const std::string &owner = nodeStack.empty() ? kNone : nodeStack.back();
+    field = F_OTHER;
+    if (name == "point" && (owner == "Coordinate3" || owner == "Coordinate" ||
+                            owner == "Coordinate4" || owner == "SoCoordinate3")) {
+      field = F_COORD;
+      coordComponents = (owner == "Coordinate4") ? 4 : 3;
+    } else if (name == "vertex" && (owner == "VertexProperty" || owner == "SoVertexProperty")) {
+      field = F_COORD;
+      coordComponents = 3;
+    } else if (name == "coordIndex" && isFaceSetType(owner)) {
+      field = F_INDEX;
+    } else if (name == "numVertices" && isFaceSetType(owner)) {
+      field = F_NUMVERTS;
+    }
+    coordValues = 0;
+  };
+
+  auto flushFace = [&]() {
+    if (faceVerts > 0) {
+      ++res.faces;
+      if (faceVerts >= 3) res.triangleEstimate = saturatingAdd(res.triangleEstimate, faceVerts - 2);
+      faceVerts = 0;
+    }
+  };
+  auto fail = [&](const std::string &msg) {
+    res.error = msg + " (line " + std::to_string(r.line()) + ")";
+    res.bytes = r.consumed();
+    return false;
+  };
+
+  for (;;) {
+    bool isInt = false;
+    long long value = 0;
+    const Token t = nextToken(r, text, isInt, value);
+    if (t == T_EOF) break;
+    if (t == T_ERROR) return fail(text);
+
+    switch (t) {
+      case T_IDENT:
+        if (afterUse) {
+          afterUse = false;
+          ++res.uses;
+        } else if (afterDef) {
+          afterDef = false;
+          ++res.defs;
+        } else if (text == "DEF") {
+          afterDef = true;
+        } else if (text == "USE") {
+          afterUse = true;
+          pending.clear();
+        } else {
+          pending = text;
+        }
+        break;
+
+      case T_LBRACE:
+        // "Type {" opens a node. A brace with no type (VRML PROTO bodies,
+        // script blocks) is accepted as an anonymous block.
+        ++res.nodes;
+        if (!pending.empty() && isShapeType(pending)) ++res.shapes;
+        nodeStack.push_back(pending);
+        res.maxDepth = std::max<int>(res.maxDepth, static_cast<int>(nodeStack.size()));
+        pending.clear();
+        field = F_OTHER;
+        break;
+
+      case T_RBRACE:
+        if (nodeStack.empty()) return fail("unbalanced '}'");
+        if (bracketDepth) return fail("'}' inside [ ... ]");
+        nodeStack.pop_back();
+        pending.clear();
+        field = F_OTHER;
+        break;
+
+      case T_LBRACKET:
+        if (!pending.empty()) setField(pending);
+        pending.clear();
+        ++bracketDepth;
+        arrayValues = 0;
+        break;
+
+      case T_RBRACKET:
+        if (bracketDepth == 0) return fail("unbalanced ']'");
+        --bracketDepth;
+        if (arrayValues > res.largestArray) res.largestArray = arrayValues;
+        if (field == F_INDEX) flushFace();
+        field = F_OTHER;
+        break;
+
+      case T_NUMBER:
+        if (!pending.empty()) {
+          setField(pending);
+          pending.clear();
+        }
+        ++arrayValues;
+        switch (field) {
+          case F_COORD:
+            if (++coordValues == coordComponents) {
+              ++res.coordinates;
+              coordValues = 0;
+            }
+            break;
+          case F_INDEX:
+            if (isInt && value < 0) {
+              flushFace();
+            } else {
+              ++res.faceIndices;
+              ++faceVerts;
+            }
+            break;
+          case F_NUMVERTS:
+            if (isInt && value > 0) {
+              ++res.faces;
+              if (value >= 3) {
+                res.triangleEstimate = saturatingAdd(res.triangleEstimate, static_cast<uint64_t>(value) - 2);
+              }
+            }
+            break;
+          default:
+            break;
+        }
+        break;
+
+      case T_STRING:
+        pending.clear();
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  res.bytes = r.consumed();
+  if (bracketDepth) return fail("unterminated '['");
+  if (!nodeStack.empty()) return fail("unterminated node body ('{' without '}')");
+  if (afterDef || afterUse) return fail("DEF/USE without a name");
+  res.valid = true;
+  return true;
+}
+
+inline bool scanInventor(int fd, ScanResult &res) {
+  ScanReader r(fd);
+  return scanInventor(r, res);
+}
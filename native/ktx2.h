@@ -0,0 +1,75 @@
+// KTX2 encoding of exported textures with Basis Universal (--texture-format
+// etc1s|uastc, glTF KHR_texture_basisu): the client transcodes them to
+// whatever block compression its GPU has, so they stay compressed in GPU
+// memory. ETC1S is the smaller download, UASTC the higher quality (zstd
+// supercompressed). Both come with a full mip chain.
+//
+// The encoder is an optional dependency: build with -DIV2GLB_HAVE_BASISU=1,
+// the basis_universal source tree on the include path and its
+// basisu_encoder library linked (see the Dockerfile's WITH_BASISU).
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifndef IV2GLB_HAVE_BASISU
+#define IV2GLB_HAVE_BASISU 0
+#endif
+
+#if IV2GLB_HAVE_BASISU
+#include <mutex>
+
+#include <encoder/basisu_comp.h>
+#endif
+
+// ETC1S quality (1..255) and UASTC level (0..4): basisu's defaults, which
+// trade encode time for size sensibly on a shared worker.
+static constexpr int kEtc1sQuality = 128;
+static constexpr int kUastcLevel = 2;
+
+// Encodes `width` x `height` RGBA8 texels (rows top to bottom; sides
+// multiples of 4, as KHR_texture_basisu requires) as a KTX2 file image in
+// `out`, sRGB, ETC1S or UASTC. Runs on the calling thread only, so callers
+// parallelise across textures. False if the encoder fails or is not built in.
+static bool encodeKtx2(const uint8_t *rgba, int width, int height, bool uastc, std::string &out) {
+#if IV2GLB_HAVE_BASISU
+  static std::once_flag initOnce;
+  std::call_once(initOnce, []() { basisu::basisu_encoder_init(); });
+
+  basisu::image img(width, height);
+  std::memcpy(img.get_ptr(), rgba, size_t(width) * height * 4);
+  basisu::job_pool pool(1);
+  basisu::basis_compressor_params params;
+  params.m_source_images.push_back(img);
+  params.m_uastc = uastc;
+  if (uastc) {
+    params.m_pack_uastc_flags = static_cast<uint32_t>(kUastcLevel);
+    params.m_ktx2_uastc_supercompression = basist::KTX2_SS_ZSTANDARD;
+  } else {
+    params.m_quality_level = kEtc1sQuality;
+  }
+  params.m_create_ktx2_file = true;
+  params.m_ktx2_srgb_transfer_func = true;
+  params.m_perceptual = true;
+  params.m_mip_gen = true;
+  params.m_mip_srgb = true;
+  params.m_multithreading = false;
+  params.m_status_output = false;
+  params.m_pJob_pool = &pool;
+
+  basisu::basis_compressor compressor;
+  if (!compressor.init(params) || compressor.process() != basisu::basis_compressor::cECSuccess) return false;
+  const basisu::uint8_vec &file = compressor.get_output_ktx2_file();
+  if (file.empty()) return false;
+  out.assign(reinterpret_cast<const char *>(file.data()), file.size());
+  return true;
+#else
+  (void)rgba;
+  (void)width;
+  (void)height;
+  (void)uastc;
+  out.clear();
+  return false;
+#endif
+}
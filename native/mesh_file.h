@@ -0,0 +1,284 @@
+// Flat on-disk copy of MeshOut (--save-mesh), for re-exporting with other
+// options without reading and traversing the scene again.
+//
+// Layout (little-endian, every payload 64-byte aligned):
+//   MeshFileHeader
+//   MeshFileSection[sectionCount]
+//   section payloads
+// Loading is one mmap plus a bulk copy per section; nothing is parsed.
+// Readers skip section tags they do not know, so sections can be added
+// (as materials and colours were) without breaking older files; changing the
+// layout of an existing section bumps kMeshFileVersion.
+// Textures are not kept: their images live with the traversal
+// (TextureSet), so a reloaded mesh exports untextured.
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mesh_out.h"
+#include "partial_files.h"
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "mesh files are little-endian");
+
+static constexpr char kMeshFileMagic[8] = {'I', 'V', '2', 'G', 'M', 'E', 'S', 'H'};
+static constexpr uint32_t kMeshFileVersion = 1;
+static constexpr uint64_t kMeshFileAlign = 64;
+
+struct MeshFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t sectionCount;
+  uint64_t fileBytes;
+  float posMin[3];
+  float posMax[3];
+  uint32_t reserved[4];
+};
+static_assert(sizeof(MeshFileHeader) == 64, "MeshFileHeader layout");
+
+struct MeshFileSection {
+  uint32_t tag;           // kSection*
+  uint32_t elementBytes;  // size of one element, checked on load
+  uint64_t offset;        // from the start of the file
+  uint64_t count;         // elements
+};
+static_assert(sizeof(MeshFileSection) == 24, "MeshFileSection layout");
+
+// One per PartRange.
+struct MeshFilePart {
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  float bmin[3];
+  float bmax[3];
+};
+static_assert(sizeof(MeshFilePart) == 32, "MeshFilePart layout");
+
+// One per MeshMaterial.
+struct MeshFileMaterial {
+  float diffuse[3];
+  float emissive[3];
+  float opacity;
+  uint32_t flags;  // kMaterialVertexColors
+};
+static_assert(sizeof(MeshFileMaterial) == 32, "MeshFileMaterial layout");
+
+namespace meshfile {
+
+constexpr uint32_t tag(char a, char b, char c, char d) {
+  return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) |
+         (uint32_t(uint8_t(d)) << 24);
+}
+
+constexpr uint32_t kSectionPositions = tag('P', 'O', 'S', '3');  // float xyz
+constexpr uint32_t kSectionIndices = tag('I', 'D', 'X', '1');    // uint32 triangles
+constexpr uint32_t kSectionParts = tag('P', 'A', 'R', 'T');      // MeshFilePart
+// Optional; files without them load with the default material.
+constexpr uint32_t kSectionMaterials = tag('M', 'A', 'T', 'L');      // MeshFileMaterial
+constexpr uint32_t kSectionPartMaterials = tag('P', 'M', 'A', 'T');  // uint32 per part
+constexpr uint32_t kSectionColors = tag('C', 'O', 'L', '4');         // RGBA8 per vertex
+
+constexpr uint32_t kMaterialVertexColors = 1;
+
+inline uint64_t alignUp(uint64_t v) { return (v + kMeshFileAlign - 1) & ~(kMeshFileAlign - 1); }
+
+}  // namespace meshfile
+
+// True if `path` starts with the mesh file magic.
+static inline bool isMeshFile(const std::string &path) {
+  char magic[8];
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  const ssize_t n = ::read(fd, magic, sizeof(magic));
+  ::close(fd);
+  return n == 8 && std::memcmp(magic, kMeshFileMagic, 8) == 0;
+}
+
+// Writes `m` to `path` via a temporary name, so readers never see a partial
+// file.
+static bool writeMeshFile(const MeshOut &m, const std::string &path, std::string &err) {
+  using namespace meshfile;
+  std::vector<MeshFilePart> parts(m.parts.size());
+  for (size_t i = 0; i < parts.size(); ++i) {
+    parts[i].firstIndex = m.parts[i].firstIndex;
+    parts[i].indexCount = m.parts[i].indexCount;
+    std::memcpy(parts[i].bmin, m.parts[i].bmin, sizeof(parts[i].bmin));
+    std::memcpy(parts[i].bmax, m.parts[i].bmax, sizeof(parts[i].bmax));
+  }
+  std::vector<MeshFileMaterial> materials(m.materials.size());
+  for (size_t i = 0; i < materials.size(); ++i) {
+    std::memcpy(materials[i].diffuse, m.materials[i].diffuse, sizeof(materials[i].diffuse));
+    std::memcpy(materials[i].emissive, m.materials[i].emissive, sizeof(materials[i].emissive));
+    materials[i].opacity = m.materials[i].opacity;
+    materials[i].flags = m.materials[i].vertexColors ? kMaterialVertexColors : 0;
+  }
+  std::vector<uint32_t> partMaterials(m.materials.empty() ? 0 : m.parts.size());
+  for (size_t i = 0; i < partMaterials.size(); ++i) partMaterials[i] = m.parts[i].material;
+  struct Payload {
+    uint32_t tag, elementBytes;
+    const void *data;
+    uint64_t count;
+  };
+  const Payload payloads[] = {
+      {kSectionPositions, 12, m.positions.data(), m.vertexCount()},
+      {kSectionIndices, 4, m.indices.data(), m.indices.size()},
+      {kSectionParts, sizeof(MeshFilePart), parts.data(), parts.size()},
+      {kSectionMaterials, sizeof(MeshFileMaterial), materials.data(), materials.size()},
+      {kSectionPartMaterials, 4, partMaterials.data(), partMaterials.size()},
+      {kSectionColors, 4, m.colors.data(), m.colors.size()},
+  };
+  const uint32_t nSections = sizeof(payloads) / sizeof(payloads[0]);
+
+  MeshFileHeader h;
+  std::memset(&h, 0, sizeof(h));
+  std::memcpy(h.magic, kMeshFileMagic, 8);
+  h.version = kMeshFileVersion;
+  h.sectionCount = nSections;
+  std::memcpy(h.posMin, m.posMin, sizeof(h.posMin));
+  std::memcpy(h.posMax, m.posMax, sizeof(h.posMax));
+  std::vector<MeshFileSection> sections(nSections);
+  uint64_t offset = alignUp(sizeof(h) + nSections * sizeof(MeshFileSection));
+  for (uint32_t i = 0; i < nSections; ++i) {
+    sections[i] = {payloads[i].tag, payloads[i].elementBytes, offset, payloads[i].count};
+    offset = alignUp(offset + payloads[i].count * payloads[i].elementBytes);
+  }
+  h.fileBytes = offset;
+
+  const std::string tmp = path + ".tmp" + std::to_string(::getpid());
+  PartialFile partial(tmp);
+  FILE *f = std::fopen(tmp.c_str(), "wb");
+  if (!f) {
+    err = "cannot create " + tmp;
+    return false;
+  }
+  static const char zeros[kMeshFileAlign] = {};
+  uint64_t at = 0;
+  auto put = [&](const void *p, uint64_t n) {
+    if (n && std::fwrite(p, 1, n, f) != n) return false;
+    at += n;
+    return true;
+  };
+  auto padTo = [&](uint64_t target) { return put(zeros, target - at); };
+  bool ok = put(&h, sizeof(h)) && put(sections.data(), nSections * sizeof(MeshFileSection));
+  for (uint32_t i = 0; ok && i < nSections; ++i) {
+    ok = padTo(sections[i].offset) && put(payloads[i].data, payloads[i].count * payloads[i].elementBytes);
+  }
+  ok = ok && padTo(h.fileBytes);
+  if (std::fclose(f) != 0) ok = false;
+  if (!ok || ::rename(tmp.c_str(), path.c_str()) != 0) {
+    ::unlink(tmp.c_str());
+    err = "write to " + path + " failed";
+    return false;
+  }
+  return true;
+}
+
+// Maps `path` and copies its sections into `m`, validating sizes, index
+// ranges and part ranges.
+static bool loadMeshFile(const std::string &path, MeshOut &m, std::string &err) {
+  using namespace meshfile;
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    err = "cannot open " + path;
+    return false;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < sizeof(MeshFileHeader)) {
+    ::close(fd);
+    err = "truncated mesh file";
+    return false;
+  }
+  const uint64_t size = static_cast<uint64_t>(st.st_size);
+  void *map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    err = "cannot map " + path;
+    return false;
+  }
+  const unsigned char *base = static_cast<const unsigned char *>(map);
+  auto fail = [&](const char *msg) {
+    ::munmap(map, size);
+    err = msg;
+    return false;
+  };
+
+  MeshFileHeader h;
+  std::memcpy(&h, base, sizeof(h));
+  if (std::memcmp(h.magic, kMeshFileMagic, 8) != 0) return fail("not a mesh file");
+  if (h.version != kMeshFileVersion) return fail("unsupported mesh file version");
+  if (h.fileBytes != size) return fail("mesh file size mismatch (truncated?)");
+  if (sizeof(h) + uint64_t(h.sectionCount) * sizeof(MeshFileSection) > size) {
+    return fail("corrupt section table");
+  }
+
+  const MeshFileSection *pos = nullptr, *idx = nullptr, *parts = nullptr;
+  const MeshFileSection *mats = nullptr, *partMats = nullptr, *colors = nullptr;
+  for (uint32_t i = 0; i < h.sectionCount; ++i) {
+    const MeshFileSection *s =
+        reinterpret_cast<const MeshFileSection *>(base + sizeof(h)) + i;
+    if (s->offset > size || (s->elementBytes && s->count > (size - s->offset) / s->elementBytes)) {
+      return fail("section past end of file");
+    }
+    if (s->tag == kSectionPositions && s->elementBytes == 12) pos = s;
+    else if (s->tag == kSectionIndices && s->elementBytes == 4) idx = s;
+    else if (s->tag == kSectionParts && s->elementBytes == sizeof(MeshFilePart)) parts = s;
+    else if (s->tag == kSectionMaterials && s->elementBytes == sizeof(MeshFileMaterial)) mats = s;
+    else if (s->tag == kSectionPartMaterials && s->elementBytes == 4) partMats = s;
+    else if (s->tag == kSectionColors && s->elementBytes == 4) colors = s;
+  }
+  if (!pos || !idx || !parts) return fail("missing mesh file section");
+  if (idx->count % 3 || idx->count > UINT32_MAX) return fail("bad index count");
+  if (mats && mats->count && (!partMats || partMats->count != parts->count)) {
+    return fail("bad part material count");
+  }
+  if (colors && colors->count && colors->count != pos->count) return fail("bad colour count");
+
+  const float *p = reinterpret_cast<const float *>(base + pos->offset);
+  m.positions.assign(p, p + pos->count * 3);
+  const uint32_t *ix = reinterpret_cast<const uint32_t *>(base + idx->offset);
+  m.indices.assign(ix, ix + idx->count);
+  uint32_t maxIndex = 0;
+  for (const uint32_t i : m.indices) maxIndex = i > maxIndex ? i : maxIndex;
+  if (!m.indices.empty() && maxIndex >= pos->count) return fail("index out of range");
+
+  m.parts.resize(parts->count);
+  const MeshFilePart *fp = reinterpret_cast<const MeshFilePart *>(base + parts->offset);
+  for (size_t i = 0; i < m.parts.size(); ++i) {
+    if (uint64_t(fp[i].firstIndex) + fp[i].indexCount > idx->count) return fail("part out of range");
+    m.parts[i].firstIndex = fp[i].firstIndex;
+    m.parts[i].indexCount = fp[i].indexCount;
+    std::memcpy(m.parts[i].bmin, fp[i].bmin, sizeof(fp[i].bmin));
+    std::memcpy(m.parts[i].bmax, fp[i].bmax, sizeof(fp[i].bmax));
+  }
+  if (mats && mats->count) {
+    const MeshFileMaterial *fm = reinterpret_cast<const MeshFileMaterial *>(base + mats->offset);
+    for (uint64_t i = 0; i < mats->count; ++i) {
+      MeshMaterial mat;
+      std::memcpy(mat.diffuse, fm[i].diffuse, sizeof(mat.diffuse));
+      std::memcpy(mat.emissive, fm[i].emissive, sizeof(mat.emissive));
+      mat.opacity = fm[i].opacity;
+      mat.vertexColors = fm[i].flags & kMaterialVertexColors;
+      m.materials.push_back(mat);
+      m.materialIndex.emplace(mat.key(), static_cast<uint32_t>(i));
+    }
+    const uint32_t *pm = reinterpret_cast<const uint32_t *>(base + partMats->offset);
+    for (size_t i = 0; i < m.parts.size(); ++i) {
+      if (pm[i] >= mats->count) return fail("part material out of range");
+      m.parts[i].material = pm[i];
+    }
+  }
+  if (colors && colors->count) {
+    const uint32_t *c = reinterpret_cast<const uint32_t *>(base + colors->offset);
+    m.colors.assign(c, c + colors->count);
+  }
+  std::memcpy(m.posMin, h.posMin, sizeof(h.posMin));
+  std::memcpy(m.posMax, h.posMax, sizeof(h.posMax));
+  ::munmap(map, size);
+  return true;
+}
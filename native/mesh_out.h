@@ -0,0 +1,110 @@
+// Geometry collected by the SoCallbackAction pass, in world space and metres.
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <vector>
+
+// Identity of a MeshMaterial for dedup (MeshMaterial::key()).
+typedef std::array<float, 9> MaterialKey;
+
+// One glTF material, in linear values as glTF wants them (Coin's colours
+// are display values; see srgbToLinear).
+struct MeshMaterial {
+  float diffuse[3] = {1.0f, 1.0f, 1.0f};
+  float emissive[3] = {0.0f, 0.0f, 0.0f};
+  float opacity = 1.0f;
+  bool vertexColors = false;  // diffuse and opacity come from MeshOut::colors (COLOR_0)
+  int32_t texture = -1;       // base colour texture (TextureSet::textures), over MeshOut::texcoords
+
+  MaterialKey key() const {
+    return {diffuse[0], diffuse[1], diffuse[2], emissive[0], emissive[1], emissive[2], opacity,
+            vertexColors ? 1.0f : 0.0f, static_cast<float>(texture)};
+  }
+};
+
+// Vertex colour of parts without vertex colours: COLOR_0 multiplies the
+// material's base colour, so white leaves it as it is.
+static constexpr uint32_t kWhiteRGBA = 0xFFFFFFFFu;
+
+// One shape instance's contiguous slice of MeshOut::indices.
+struct PartRange {
+  uint32_t firstIndex = 0;
+  uint32_t indexCount = 0;
+  uint32_t material = 0;  // index into MeshOut::materials (unused while that is empty)
+  float bmin[3] = { +std::numeric_limits<float>::infinity(),
+                    +std::numeric_limits<float>::infinity(),
+                    +std::numeric_limits<float>::infinity() };
+  float bmax[3] = { -std::numeric_limits<float>::infinity(),
+                    -std::numeric_limits<float>::infinity(),
+                    -std::numeric_limits<float>::infinity() };
+};
+
+struct MeshOut {
+  std::vector<float> positions;   // xyz xyz xyz ...
+  std::vector<uint32_t> indices;  // 0..N-1
+  std::vector<PartRange> parts;   // one per shape instance that emitted triangles
+  // Materials of the parts; empty = one default material for all.
+  std::vector<MeshMaterial> materials;
+  std::map<MaterialKey, uint32_t> materialIndex;  // MeshMaterial::key() -> index
+  // RGBA8 per vertex (r in the low byte: the bytes of COLOR_0), linear; only
+  // once some part has vertex colours, and then for every vertex.
+  std::vector<uint32_t> colors;
+  // uv per vertex (TEXCOORD_0: v down, as glTF has it); only once some part
+  // is textured, and then for every vertex (zeros where untextured).
+  std::vector<float> texcoords;
+  float posMin[3] = { +std::numeric_limits<float>::infinity(),
+                      +std::numeric_limits<float>::infinity(),
+                      +std::numeric_limits<float>::infinity() };
+  float posMax[3] = { -std::numeric_limits<float>::infinity(),
+                      -std::numeric_limits<float>::infinity(),
+                      -std::numeric_limits<float>::infinity() };
+
+  size_t vertexCount() const { return positions.size() / 3; }
+  size_t triangleCount() const { return indices.size() / 3; }
+};
+
+// Index of `mat` in m.materials, adding it if new.
+static inline uint32_t addMaterial(MeshOut &m, const MeshMaterial &mat) {
+  const auto ins = m.materialIndex.emplace(mat.key(), static_cast<uint32_t>(m.materials.size()));
+  if (ins.second) m.materials.push_back(mat);
+  return ins.first->second;
+}
+
+static inline void extendBounds(float *bmin, float *bmax, float x, float y, float z) {
+  if (x < bmin[0]) bmin[0] = x;
+  if (y < bmin[1]) bmin[1] = y;
+  if (z < bmin[2]) bmin[2] = z;
+  if (x > bmax[0]) bmax[0] = x;
+  if (y > bmax[1]) bmax[1] = y;
+  if (z > bmax[2]) bmax[2] = z;
+}
+
+static inline void updateMinMax(MeshOut &m, float x, float y, float z) {
+  extendBounds(m.posMin, m.posMax, x, y, z);
+}
+
+// Recomputes mesh and part bounds from the indexed geometry (after edits).
+static inline void recomputeBounds(MeshOut &m) {
+  const float inf = std::numeric_limits<float>::infinity();
+  for (int k = 0; k < 3; ++k) {
+    m.posMin[k] = +inf;
+    m.posMax[k] = -inf;
+  }
+  for (PartRange &p : m.parts) {
+    for (int k = 0; k < 3; ++k) {
+      p.bmin[k] = +inf;
+      p.bmax[k] = -inf;
+    }
+    for (uint32_t i = p.firstIndex; i < p.firstIndex + p.indexCount; ++i) {
+      const float *v = &m.positions[size_t(m.indices[i]) * 3];
+      extendBounds(p.bmin, p.bmax, v[0], v[1], v[2]);
+    }
+    for (int k = 0; k < 3; ++k) {
+      if (p.bmin[k] < m.posMin[k]) m.posMin[k] = p.bmin[k];
+      if (p.bmax[k] > m.posMax[k]) m.posMax[k] = p.bmax[k];
+    }
+  }
+}
@@ -0,0 +1,129 @@
+// Binary Inventor cache of parsed scenes (--cache-dir).
+//
+// ASCII parsing dominates large conversions, and the same source is often
+// converted again with other options. After a parse the scene graph is
+// written once as binary Inventor (SoOutput::setBinary), keyed by a hash of
+// the input bytes; later runs on identical input read that instead, which
+// skips tokenizing and number parsing. Entries are written to a temporary
+// name and renamed, so concurrent workers never see a partial file.
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <Inventor/SoDB.h>
+#include <Inventor/SoOutput.h>
+#include <Inventor/actions/SoWriteAction.h>
+
+#include "partial_files.h"
+
+// Bump when what is cached changes meaning; old entries are then ignored.
+static constexpr uint64_t kParseCacheVersion = 1;
+
+namespace xxh {
+
+constexpr uint64_t P1 = 0x9E3779B185EBCA87ull, P2 = 0xC2B2AE3D27D4EB4Full,
+                   P3 = 0x165667B19E3779F9ull, P4 = 0x85EBCA77C2B2AE63ull,
+                   P5 = 0x27D4EB2F165667C5ull;
+
+inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+inline uint64_t rd64(const unsigned char *p) { uint64_t v; std::memcpy(&v, p, 8); return v; }
+inline uint32_t rd32(const unsigned char *p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+inline uint64_t mixRound(uint64_t acc, uint64_t in) { return rotl(acc + in * P2, 31) * P1; }
+inline uint64_t merge(uint64_t h, uint64_t v) { return (h ^ mixRound(0, v)) * P1 + P4; }
+
+}  // namespace xxh
+
+// XXH64 of `len` bytes (several GB/s, so hashing is noise next to parsing).
+static inline uint64_t xxhash64(const unsigned char *p, size_t len, uint64_t seed) {
+  using namespace xxh;
+  const unsigned char *end = p + len;
+  uint64_t h;
+  if (len >= 32) {
+    uint64_t v1 = seed + P1 + P2, v2 = seed + P2, v3 = seed, v4 = seed - P1;
+    for (; end - p >= 32; p += 32) {
+      v1 = mixRound(v1, rd64(p));
+      v2 = mixRound(v2, rd64(p + 8));
+      v3 = mixRound(v3, rd64(p + 16));
+      v4 = mixRound(v4, rd64(p + 24));
+    }
+    h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    h = merge(merge(merge(merge(h, v1), v2), v3), v4);
+  } else {
+    h = seed + P5;
+  }
+  h += len;
+  for (; end - p >= 8; p += 8) h = rotl(h ^ mixRound(0, rd64(p)), 27) * P1 + P4;
+  if (end - p >= 4) {
+    h = rotl(h ^ (uint64_t(rd32(p)) * P1), 23) * P2 + P3;
+    p += 4;
+  }
+  for (; p < end; ++p) h = rotl(h ^ (*p * P5), 11) * P1;
+  h ^= h >> 33;
+  h *= P2;
+  h ^= h >> 29;
+  h *= P3;
+  return h ^ (h >> 32);
+}
+
+// Cache file for the contents of `inPath` (a regular file), or "" if it
+// cannot be read. The key covers the bytes, their length, the cache format
+// and the Coin version that wrote the binary.
+static inline std::string parseCachePath(const std::string &cacheDir, const std::string &inPath) {
+  const int fd = ::open(inPath.c_str(), O_RDONLY);
+  if (fd < 0) return std::string();
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    ::close(fd);
+    return std::string();
+  }
+  const size_t size = static_cast<size_t>(st.st_size);
+  uint64_t h = kParseCacheVersion;
+  const char *coin = SoDB::getVersion();
+  h = xxhash64(reinterpret_cast<const unsigned char *>(coin), std::strlen(coin), h);
+  if (size) {
+    void *p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      ::close(fd);
+      return std::string();
+    }
+    ::madvise(p, size, MADV_SEQUENTIAL);
+    h = xxhash64(static_cast<const unsigned char *>(p), size, h);
+    ::munmap(p, size);
+  }
+  ::close(fd);
+  char name[64];
+  std::snprintf(name, sizeof(name), "/%016llx-%llu.ivb", static_cast<unsigned long long>(h),
+                static_cast<unsigned long long>(size));
+  return cacheDir + name;
+}
+
+// True if a cache entry exists; refreshes its mtime, which is what the
+// worker's size-bounded eviction orders by.
+static inline bool parseCacheHit(const std::string &path) {
+  if (::access(path.c_str(), R_OK) != 0) return false;
+  ::utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+  return true;
+}
+
+static inline bool writeParseCache(SoNode *root, const std::string &path) {
+  const std::string tmp = path + ".tmp" + std::to_string(::getpid());
+  PartialFile partial(tmp);
+  SoOutput out;
+  if (!out.openFile(tmp.c_str())) return false;
+  out.setBinary(TRUE);
+  SoWriteAction write(&out);
+  write.apply(root);
+  out.closeFile();
+  if (::rename(tmp.c_str(), path.c_str()) != 0) {
+    ::unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,59 @@
+// Output files that are not complete yet: temporary names about to be
+// renamed into place, and outputs being written in place. A run ended from
+// the watchdog (std::_Exit: no destructors, no cleanup) removes them first,
+// so an aborted conversion leaves no partial file behind.
+#pragma once
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+
+namespace partial {
+
+inline std::mutex &mutex() {
+  static std::mutex m;
+  return m;
+}
+
+inline std::vector<std::string> &paths() {
+  static std::vector<std::string> p;
+  return p;
+}
+
+}  // namespace partial
+
+// Registers `path` as partial until release() or destruction (written and
+// renamed, or given up on and unlinked by the owner).
+class PartialFile {
+public:
+  explicit PartialFile(std::string path) : path_(std::move(path)) {
+    std::lock_guard<std::mutex> lock(partial::mutex());
+    partial::paths().push_back(path_);
+  }
+  PartialFile(const PartialFile &) = delete;
+  PartialFile &operator=(const PartialFile &) = delete;
+  ~PartialFile() { release(); }
+
+  void release() {
+    if (!active_) return;
+    active_ = false;
+    std::lock_guard<std::mutex> lock(partial::mutex());
+    std::vector<std::string> &p = partial::paths();
+    const auto it = std::find(p.begin(), p.end(), path_);
+    if (it != p.end()) p.erase(it);
+  }
+
+private:
+  std::string path_;
+  bool active_ = true;
+};
+
+// Unlinks every registered file. For the watchdog, just before std::_Exit.
+inline void removePartialFiles() {
+  std::lock_guard<std::mutex> lock(partial::mutex());
+  for (const std::string &path : partial::paths()) ::unlink(path.c_str());
+  partial::paths().clear();
+}
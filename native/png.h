@@ -0,0 +1,63 @@
+// PNG encoding for the thumbnail and exported textures: 8-bit RGB or RGBA,
+// one deflate stream (zlib), the Up filter on every row.
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+namespace png {
+
+inline void put32(std::string &o, uint32_t v) {
+  const char b[4] = {char(v >> 24), char(v >> 16), char(v >> 8), char(v)};
+  o.append(b, 4);
+}
+
+inline void chunk(std::string &o, const char *type, const std::string &data) {
+  put32(o, static_cast<uint32_t>(data.size()));
+  const size_t at = o.size();
+  o.append(type, 4);
+  o += data;
+  put32(o, static_cast<uint32_t>(crc32(0, reinterpret_cast<const Bytef *>(o.data() + at), o.size() - at)));
+}
+
+}  // namespace png
+
+// Encodes `width` x `height` pixels of `channels` (3 = RGB, 4 = RGBA) bytes,
+// rows top to bottom, as a PNG file image in `out`. False only if zlib fails.
+static bool encodePng(const uint8_t *px, int width, int height, int channels, std::string &out) {
+  using namespace png;
+  const size_t stride = size_t(width) * channels;
+  std::vector<uint8_t> raw;
+  raw.reserve(size_t(height) * (stride + 1));
+  for (int y = 0; y < height; ++y) {
+    const uint8_t *row = px + size_t(y) * stride;
+    if (y == 0) {
+      raw.push_back(0);  // filter: none
+      raw.insert(raw.end(), row, row + stride);
+      continue;
+    }
+    raw.push_back(2);  // filter: up
+    const uint8_t *above = row - stride;
+    for (size_t i = 0; i < stride; ++i) raw.push_back(static_cast<uint8_t>(row[i] - above[i]));
+  }
+  uLongf packedBytes = compressBound(raw.size());
+  std::string packed(packedBytes, '\0');
+  if (compress2(reinterpret_cast<Bytef *>(&packed[0]), &packedBytes, raw.data(), raw.size(), 6) != Z_OK) {
+    return false;
+  }
+  packed.resize(packedBytes);
+
+  out.assign("\x89PNG\r\n\x1a\n", 8);
+  std::string ihdr;
+  put32(ihdr, static_cast<uint32_t>(width));
+  put32(ihdr, static_cast<uint32_t>(height));
+  // 8 bits, colour type 6 (RGBA) or 2 (RGB), deflate, no filter set, no interlace
+  ihdr += std::string(channels == 4 ? "\x08\x06\x00\x00\x00" : "\x08\x02\x00\x00\x00", 5);
+  chunk(out, "IHDR", ihdr);
+  chunk(out, "IDAT", packed);
+  chunk(out, "IEND", std::string());
+  return true;
+}
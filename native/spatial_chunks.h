@@ -0,0 +1,139 @@
+// Spatial chunking for --chunk-triangles: one large MeshOut becomes several
+// self-contained meshes of nearby parts, so a viewer can fetch and draw a
+// region without the rest of the model.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "mesh_out.h"
+
+namespace chunks {
+
+// Interleaves the low 21 bits of x, y, z (Morton / Z-order).
+inline uint64_t spread(uint64_t v) {
+  v &= 0x1FFFFF;
+  v = (v | v << 32) & 0x1F00000000FFFFull;
+  v = (v | v << 16) & 0x1F0000FF0000FFull;
+  v = (v | v << 8) & 0x100F00F00F00F00Full;
+  v = (v | v << 4) & 0x10C30C30C30C30C3ull;
+  v = (v | v << 2) & 0x1249249249249249ull;
+  return v;
+}
+
+}  // namespace chunks
+
+// Groups the parts of `m` in Z-order of their box centres into meshes of at
+// most `maxTriangles` triangles and copies each group's vertices, compacted
+// and reindexed. A part over the limit is first cut into pieces of at most
+// `maxTriangles` triangles in the Z-order of their centroids, each a part of
+// its own with its own bounds, so no chunk grows past the limit. Materials
+// carry over.
+static std::vector<MeshOut> splitSpatialChunks(const MeshOut &m, size_t maxTriangles) {
+  using chunks::spread;
+  float scale[3];
+  for (int k = 0; k < 3; ++k) {
+    const float extent = m.posMax[k] - m.posMin[k];
+    scale[k] = extent > 0.0f ? float(0x1FFFFF) / extent : 0.0f;
+  }
+  auto mortonKey = [&](const float *c) {
+    uint64_t q[3];
+    for (int k = 0; k < 3; ++k) {
+      q[k] = static_cast<uint64_t>(std::min(std::max((c[k] - m.posMin[k]) * scale[k], 0.0f), float(0x1FFFFF)));
+    }
+    return spread(q[0]) | spread(q[1]) << 1 | spread(q[2]) << 2;
+  };
+
+  // Pieces: whole parts, or runs of an oversized part's triangles, whose
+  // indices are then reordered in a copy of the index buffer.
+  const size_t maxIndices = maxTriangles * 3;
+  std::vector<PartRange> pieces;
+  std::vector<std::pair<uint64_t, size_t>> order;
+  std::vector<uint32_t> reordered;
+  const uint32_t *indices = m.indices.data();
+  for (const PartRange &p : m.parts) {
+    if (!p.indexCount) continue;
+    if (p.indexCount <= maxIndices) {
+      const float c[3] = {0.5f * (p.bmin[0] + p.bmax[0]), 0.5f * (p.bmin[1] + p.bmax[1]),
+                          0.5f * (p.bmin[2] + p.bmax[2])};
+      order.push_back({mortonKey(c), pieces.size()});
+      pieces.push_back(p);
+      continue;
+    }
+    if (reordered.empty()) {
+      reordered = m.indices;
+      indices = reordered.data();
+    }
+    std::vector<std::pair<uint64_t, uint32_t>> tris;
+    tris.reserve(p.indexCount / 3);
+    for (uint32_t i = p.firstIndex; i + 2 < p.firstIndex + p.indexCount; i += 3) {
+      float c[3] = {0.0f, 0.0f, 0.0f};
+      for (int v = 0; v < 3; ++v) {
+        const float *pos = &m.positions[size_t(m.indices[i + v]) * 3];
+        for (int k = 0; k < 3; ++k) c[k] += pos[k] / 3.0f;
+      }
+      tris.push_back({mortonKey(c), i});
+    }
+    std::sort(tris.begin(), tris.end());
+    for (size_t t = 0; t < tris.size(); ++t) {
+      for (int v = 0; v < 3; ++v) reordered[p.firstIndex + t * 3 + v] = m.indices[tris[t].second + v];
+    }
+    const uint32_t end = p.firstIndex + static_cast<uint32_t>(tris.size() * 3);
+    for (uint32_t first = p.firstIndex; first < end; first += static_cast<uint32_t>(maxIndices)) {
+      PartRange piece;
+      piece.material = p.material;
+      piece.firstIndex = first;
+      piece.indexCount = static_cast<uint32_t>(std::min<size_t>(maxIndices, end - first));
+      for (uint32_t i = first; i < first + piece.indexCount; ++i) {
+        const float *pos = &m.positions[size_t(reordered[i]) * 3];
+        for (int k = 0; k < 3; ++k) {
+          piece.bmin[k] = std::min(piece.bmin[k], pos[k]);
+          piece.bmax[k] = std::max(piece.bmax[k], pos[k]);
+        }
+      }
+      const float c[3] = {0.5f * (piece.bmin[0] + piece.bmax[0]), 0.5f * (piece.bmin[1] + piece.bmax[1]),
+                          0.5f * (piece.bmin[2] + piece.bmax[2])};
+      order.push_back({mortonKey(c), pieces.size()});
+      pieces.push_back(piece);
+    }
+  }
+  std::sort(order.begin(), order.end());
+
+  std::vector<MeshOut> out;
+  std::vector<uint32_t> remap(m.vertexCount(), UINT32_MAX);
+  std::vector<uint32_t> touched;
+  for (size_t at = 0; at < order.size();) {
+    out.emplace_back();
+    MeshOut &c = out.back();
+    c.materials = m.materials;
+    c.materialIndex = m.materialIndex;
+    do {
+      const PartRange &p = pieces[order[at].second];
+      PartRange cp = p;
+      cp.firstIndex = static_cast<uint32_t>(c.indices.size());
+      for (uint32_t i = p.firstIndex; i < p.firstIndex + p.indexCount; ++i) {
+        const uint32_t v = indices[i];
+        if (remap[v] == UINT32_MAX) {
+          remap[v] = static_cast<uint32_t>(c.vertexCount());
+          touched.push_back(v);
+          c.positions.insert(c.positions.end(), &m.positions[size_t(v) * 3], &m.positions[size_t(v) * 3] + 3);
+          if (!m.colors.empty()) c.colors.push_back(m.colors[v]);
+          if (!m.texcoords.empty()) {
+            c.texcoords.insert(c.texcoords.end(), &m.texcoords[size_t(v) * 2], &m.texcoords[size_t(v) * 2] + 2);
+          }
+        }
+        c.indices.push_back(remap[v]);
+      }
+      for (int k = 0; k < 3; ++k) {
+        c.posMin[k] = std::min(c.posMin[k], p.bmin[k]);
+        c.posMax[k] = std::max(c.posMax[k], p.bmax[k]);
+      }
+      c.parts.push_back(cp);
+      ++at;
+    } while (at < order.size() && c.indices.size() + pieces[order[at].second].indexCount <= maxIndices);
+    for (const uint32_t v : touched) remap[v] = UINT32_MAX;
+    touched.clear();
+  }
+  return out;
+}
@@ -0,0 +1,153 @@
+// Chunked parsing of the fast-path arrays (iv_fastparse.h) against a serial
+// parse of the same text: for every chunk size from 1 byte up, the chunks'
+// values, concatenated, must be the serial values bit for bit, and the
+// serial floats must be what strtod gives (as SoInput reads them).
+//
+//   g++ -std=c++17 -O2 -pthread native/tests/fastparse_test.cpp -o fastparse_test -lCoin
+//   ./fastparse_test
+#include "../iv_fastparse.h"
+
+#include <cinttypes>
+#include <random>
+#include <type_traits>
+
+static int g_failures = 0;
+
+#define CHECK(cond, ...)                                              \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      std::fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #cond); \
+      std::fprintf(stderr, __VA_ARGS__);                              \
+      std::fprintf(stderr, "\n");                                     \
+      ++g_failures;                                                   \
+    }                                                                 \
+  } while (0)
+
+// Values of `text` read one token at a time with strtod / strtol, skipping
+// separators and comments.
+template <typename T>
+static std::vector<T> reference(const std::string &text) {
+  std::vector<T> out;
+  const char *p = text.c_str(), *e = p + text.size();
+  while (ivfast::skipSpace(p, e)) {
+    char *end;
+    if (std::is_same<T, float>::value) out.push_back(static_cast<T>(std::strtod(p, &end)));
+    else out.push_back(static_cast<T>(std::strtol(p, &end, 10)));
+    p = end;
+  }
+  return out;
+}
+
+// Whether offset `at` of `text` lies inside a comment.
+static bool inComment(const std::string &text, size_t at) {
+  const size_t lineStart = at == 0 ? 0 : text.rfind('\n', at - 1) + 1;
+  const size_t hash = text.find('#', lineStart);
+  return hash < at;
+}
+
+// Parses `text` as one array of `kind`, serially and in chunks of every
+// size, and compares. Returns how many chunkings split a point triple.
+template <typename T>
+static int checkArray(const char *name, const std::string &text, FastArray::Kind kind) {
+  FastChunk whole;
+  whole.begin = 0;
+  whole.end = text.size();
+  CHECK(ivfast::parseChunk(text.data(), kind, whole), "%s: serial parse failed", name);
+  std::vector<T> expected = kind == FastArray::kPoints ? std::vector<T>(whole.floats.begin(), whole.floats.end())
+                                                       : std::vector<T>(whole.ints.begin(), whole.ints.end());
+  const std::vector<T> ref = reference<T>(text);
+  CHECK(expected.size() == ref.size() && std::memcmp(expected.data(), ref.data(), ref.size() * sizeof(T)) == 0,
+        "%s: serial values differ from strtod", name);
+
+  int splitTriples = 0;
+  for (size_t chunkBytes = 1; chunkBytes <= text.size() + 1; ++chunkBytes) {
+    FastArray a;
+    a.kind = kind;
+    a.begin = 0;
+    a.end = text.size();
+    ivfast::splitArray(text.data(), a, chunkBytes);
+    std::vector<T> got;
+    bool split = false;
+    size_t at = 0;
+    for (FastChunk &c : a.chunks) {
+      CHECK(c.begin == at, "%s: chunk size %zu: gap or overlap at %zu", name, chunkBytes, at);
+      CHECK(!inComment(text, c.begin), "%s: chunk size %zu: cut inside a comment at %zu", name, chunkBytes, c.begin);
+      at = c.end;
+      if (!ivfast::parseChunk(text.data(), kind, c)) {
+        CHECK(false, "%s: chunk size %zu: chunk [%zu, %zu) did not parse", name, chunkBytes, c.begin, c.end);
+        return splitTriples;
+      }
+      if (kind == FastArray::kPoints) {
+        split = split || (got.size() % 3 != 0 && !c.floats.empty());
+        got.insert(got.end(), c.floats.begin(), c.floats.end());
+      } else {
+        got.insert(got.end(), c.ints.begin(), c.ints.end());
+      }
+    }
+    CHECK(at == text.size(), "%s: chunk size %zu: chunks end at %zu of %zu", name, chunkBytes, at, text.size());
+    CHECK(got.size() == expected.size() && std::memcmp(got.data(), expected.data(), got.size() * sizeof(T)) == 0,
+          "%s: chunk size %zu: %zu chunks differ from the serial parse", name, chunkBytes, a.chunks.size());
+    splitTriples += split;
+  }
+  return splitTriples;
+}
+
+// Random coordinates in the spellings exporters use.
+static std::string number(std::mt19937 &rng) {
+  std::uniform_real_distribution<double> value(-1000.0, 1000.0);
+  char buf[64];
+  switch (rng() % 6) {
+    case 0: std::snprintf(buf, sizeof(buf), "%.9g", value(rng)); break;
+    case 1: std::snprintf(buf, sizeof(buf), "%.17g", value(rng)); break;
+    case 2: std::snprintf(buf, sizeof(buf), "%.6f", value(rng)); break;
+    case 3: std::snprintf(buf, sizeof(buf), "%.8e", value(rng) * 1e-20); break;
+    case 4: std::snprintf(buf, sizeof(buf), "%d", static_cast<int>(value(rng))); break;
+    default: std::snprintf(buf, sizeof(buf), "%.25g", value(rng) * 1e10); break;
+  }
+  return buf;
+}
+
+int main() {
+  std::mt19937 rng(62);
+
+  // Points over many lines with trailing and whole-line comments, some
+  // holding digits and separators.
+  std::string lines = "\n";
+  for (int i = 0; i < 60; ++i) {
+    lines += "  " + number(rng) + " " + number(rng) + " " + number(rng) + ",";
+    if (i % 7 == 3) lines += "  # vertex " + std::to_string(i) + ", 1 2 3";
+    lines += "\n";
+    if (i % 11 == 5) lines += "# 0.5 0.5 0.5, -1 ] not a value\n";
+  }
+  lines += "  .5 +2 -0.0, 1e-40 3.4028235e38 123456789012345678901234, 0.1 0.2 0.3\n  ";
+  CHECK(checkArray<float>("points over lines", lines, FastArray::kPoints) > 0, "no chunking split a triple");
+
+  // One line, as some exporters write the whole array.
+  std::string line = " ";
+  for (int i = 0; i < 300; ++i) line += number(rng) + (i % 3 == 2 ? ", " : " ");
+  CHECK(checkArray<float>("points on one line", line, FastArray::kPoints) > 0, "no chunking split a triple");
+
+  // A comment on a long line: no cut may land after its '#'.
+  std::string commented = " ";
+  for (int i = 0; i < 90; ++i) commented += number(rng) + " ";
+  commented += "# the rest of this line, 4 5 6, is a comment\n";
+  for (int i = 0; i < 90; ++i) commented += number(rng) + " ";
+  checkArray<float>("comment on a long line", commented, FastArray::kPoints);
+
+  // Face indices with comments.
+  std::string faces = "\n";
+  for (int i = 0; i < 200; ++i) {
+    faces += std::to_string(rng() % 100000) + ", " + std::to_string(rng() % 100000) + ", " +
+             std::to_string(rng() % 100000) + ", -1,";
+    faces += i % 9 == 4 ? " # face " + std::to_string(i) + "\n" : (i % 4 == 3 ? "\n" : " ");
+  }
+  faces += "2147483647, -2147483648, -1\n";
+  checkArray<int32_t>("coordIndex", faces, FastArray::kCoordIndex);
+
+  if (g_failures) {
+    std::fprintf(stderr, "%d failures\n", g_failures);
+    return 1;
+  }
+  std::printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,244 @@
+// Texture atlases for --texture-atlas: small textures whose coordinates stay
+// within the image are packed into shared atlas images (shelf packing, a
+// replicated-edge border around each tile against bleed), their texture
+// coordinates rewritten into the atlas, and materials that then differ in
+// nothing else merged, so the writer's per-material grouping turns their
+// primitives into one draw.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "mesh_out.h"
+#include "textures.h"
+
+static constexpr int kAtlasMaxTile = 256;   // larger textures keep an image of their own
+static constexpr int kAtlasPadding = 4;     // border texels per tile side (bleed-free to mip level 2)
+static constexpr int kAtlasMaxSide = 2048;  // and at most --texture-max-size
+static constexpr float kAtlasUvSlack = 1e-3f;
+
+namespace atlas {
+
+// One texture's image in an atlas: its texels as encodeTexture would write
+// them, and where they went (the texel area, inside the border).
+struct Tile {
+  uint32_t texture;
+  int width, height;
+  std::vector<uint8_t> rgba;
+  bool alpha;
+  int sheet = -1;
+  int x = 0, y = 0;
+};
+
+inline int ceilPow2(int v) {
+  int p = 1;
+  while (p < v) p *= 2;
+  return p;
+}
+
+// Size `img` is written at with `maxSize` (as encodeTexture resizes).
+inline void writtenSize(const TextureImage &img, int maxSize, int &w, int &h) {
+  w = img.width;
+  h = img.height;
+  if (maxSize > 0) {
+    w = tex::floorPow2(std::min(w, maxSize));
+    h = tex::floorPow2(std::min(h, maxSize));
+  }
+}
+
+// Shelf packing of `tiles` (tallest first) into sheets of `side` texels;
+// returns each sheet's used width and height.
+inline std::vector<std::pair<int, int>> pack(std::vector<Tile> &tiles, int side) {
+  std::vector<Tile *> order;
+  for (Tile &t : tiles) order.push_back(&t);
+  std::stable_sort(order.begin(), order.end(), [](const Tile *a, const Tile *b) { return a->height > b->height; });
+  std::vector<std::pair<int, int>> used;
+  int x = 0, y = 0, shelf = 0;
+  for (Tile *t : order) {
+    const int w = t->width + 2 * kAtlasPadding, h = t->height + 2 * kAtlasPadding;
+    if (used.empty() || x + w > side) {
+      y += shelf;
+      x = 0;
+      shelf = 0;
+    }
+    if (used.empty() || y + h > side) {
+      used.emplace_back(0, 0);
+      x = y = shelf = 0;
+    }
+    t->sheet = static_cast<int>(used.size() - 1);
+    t->x = x + kAtlasPadding;
+    t->y = y + kAtlasPadding;
+    x += w;
+    shelf = std::max(shelf, h);
+    used.back().first = std::max(used.back().first, x);
+    used.back().second = std::max(used.back().second, y + shelf);
+  }
+  return used;
+}
+
+// Copies `t` into the sheet (`width` texels wide) with its edge texels
+// repeated across the border.
+inline void blit(const Tile &t, std::vector<uint8_t> &sheet, int width) {
+  for (int dy = -kAtlasPadding; dy < t.height + kAtlasPadding; ++dy) {
+    const int sy = std::min(std::max(dy, 0), t.height - 1);
+    uint8_t *out = &sheet[(size_t(t.y + dy) * width + (t.x - kAtlasPadding)) * 4];
+    for (int dx = -kAtlasPadding; dx < t.width + kAtlasPadding; ++dx, out += 4) {
+      const int sx = std::min(std::max(dx, 0), t.width - 1);
+      const uint8_t *in = &t.rgba[(size_t(sy) * t.width + sx) * 4];
+      out[0] = in[0];
+      out[1] = in[1];
+      out[2] = in[2];
+      out[3] = in[3];
+    }
+  }
+}
+
+}  // namespace atlas
+
+// Packs the small textures used by `meshes` into atlases added to `set`
+// and points the meshes at them. A texture qualifies when it is written at
+// most kAtlasMaxTile texels a side and, on each axis it repeats along, every
+// coordinate using it lies within [0, 1] (clamped axes are clamped into the
+// tile). Vertices shared between parts with different textures are split
+// first. Returns the number of textures packed; a texture that would be
+// alone in its atlas is left as it is.
+static size_t packTextureAtlases(const std::vector<MeshOut *> &meshes, TextureSet &set) {
+  using namespace atlas;
+  const int side = set.maxSize > 0 ? std::min(kAtlasMaxSide, tex::floorPow2(set.maxSize)) : kAtlasMaxSide;
+  const int maxTile = std::min(kAtlasMaxTile, side - 2 * kAtlasPadding);
+  if (maxTile < 1) return 0;
+
+  // Which textures qualify: small enough, and used only within the image.
+  std::vector<char> used(set.textures.size(), 0), fits(set.textures.size(), 0);
+  for (size_t i = 0; i < set.textures.size(); ++i) {
+    int w, h;
+    writtenSize(set.images[set.textures[i].image], set.maxSize, w, h);
+    fits[i] = w <= maxTile && h <= maxTile;
+  }
+  for (const MeshOut *m : meshes) {
+    if (m->materials.empty() || m->texcoords.empty()) continue;
+    for (const PartRange &p : m->parts) {
+      const int32_t t = m->materials[p.material].texture;
+      if (t < 0) continue;
+      used[t] = 1;
+      if (!fits[t]) continue;
+      const TextureRef &ref = set.textures[t];
+      for (uint32_t i = p.firstIndex; i < p.firstIndex + p.indexCount && fits[t]; ++i) {
+        const float *uv = &m->texcoords[size_t(m->indices[i]) * 2];
+        if ((!ref.clampS && (uv[0] < -kAtlasUvSlack || uv[0] > 1.0f + kAtlasUvSlack)) ||
+            (!ref.clampT && (uv[1] < -kAtlasUvSlack || uv[1] > 1.0f + kAtlasUvSlack))) {
+          fits[t] = 0;
+        }
+      }
+    }
+  }
+  std::vector<Tile> tiles;
+  for (size_t i = 0; i < set.textures.size(); ++i) {
+    if (used[i] && fits[i]) tiles.push_back({static_cast<uint32_t>(i), 0, 0, {}, false});
+  }
+  if (tiles.size() < 2) return 0;
+
+  // Tiles at their written size, packed, composed into sheets.
+  for (Tile &t : tiles) {
+    const TextureImage &img = set.images[set.textures[t.texture].image];
+    writtenSize(img, set.maxSize, t.width, t.height);
+    t.rgba = t.width == img.width && t.height == img.height
+                 ? img.rgba
+                 : tex::downscale(img.rgba, img.width, img.height, t.width, t.height);
+    t.alpha = img.alpha;
+  }
+  std::vector<std::pair<int, int>> sheets = pack(tiles, side);
+  // A sheet holding a single tile would merge nothing: that texture stays.
+  std::vector<int> perSheet(sheets.size(), 0), sheetIndex(sheets.size(), -1);
+  for (const Tile &t : tiles) ++perSheet[t.sheet];
+  size_t kept = 0;
+  for (size_t s = 0; s < sheets.size(); ++s) {
+    if (perSheet[s] > 1) {
+      sheetIndex[s] = static_cast<int>(kept);
+      sheets[kept++] = sheets[s];
+    }
+  }
+  sheets.resize(kept);
+  std::vector<Tile> packed;
+  for (Tile &t : tiles) {
+    if (sheetIndex[t.sheet] < 0) continue;
+    t.sheet = sheetIndex[t.sheet];
+    packed.push_back(std::move(t));
+  }
+  tiles.swap(packed);
+  if (tiles.empty()) return 0;
+
+  std::vector<uint32_t> sheetTexture(sheets.size());
+  std::vector<TextureImage *> sheetImage(sheets.size());
+  for (size_t s = 0; s < sheets.size(); ++s) {
+    set.images.emplace_back();
+    TextureImage &img = set.images.back();
+    img.width = ceilPow2(sheets[s].first);
+    img.height = ceilPow2(sheets[s].second);
+    img.rgba.assign(size_t(img.width) * img.height * 4, 0);
+    sheetImage[s] = &img;
+    sheetTexture[s] = static_cast<uint32_t>(set.textures.size());
+    set.textures.push_back({static_cast<uint32_t>(set.images.size() - 1), true, true});
+  }
+  std::unordered_map<uint32_t, const Tile *> tileOf;
+  for (const Tile &t : tiles) {
+    TextureImage &img = *sheetImage[t.sheet];
+    blit(t, img.rgba, img.width);
+    img.alpha = img.alpha || t.alpha;
+    tileOf[t.texture] = &t;
+  }
+
+  for (MeshOut *mp : meshes) {
+    MeshOut &m = *mp;
+    if (m.materials.empty() || m.texcoords.empty()) continue;
+    // One texture per vertex: a vertex shared across textures is copied.
+    std::vector<int32_t> owner(m.vertexCount(), -1);
+    std::map<std::pair<uint32_t, int32_t>, uint32_t> copies;
+    for (const PartRange &p : m.parts) {
+      const int32_t t = m.materials[p.material].texture;
+      if (t < 0) continue;
+      for (uint32_t i = p.firstIndex; i < p.firstIndex + p.indexCount; ++i) {
+        uint32_t &v = m.indices[i];
+        if (owner[v] < 0) owner[v] = t;
+        if (owner[v] == t) continue;
+        const auto ins = copies.emplace(std::make_pair(v, t), static_cast<uint32_t>(m.vertexCount()));
+        if (ins.second) {
+          const float *pos = &m.positions[size_t(v) * 3];
+          m.positions.insert(m.positions.end(), {pos[0], pos[1], pos[2]});
+          const float *uv = &m.texcoords[size_t(v) * 2];
+          m.texcoords.insert(m.texcoords.end(), {uv[0], uv[1]});
+          if (!m.colors.empty()) m.colors.push_back(m.colors[v]);
+          owner.push_back(t);
+        }
+        v = ins.first->second;
+      }
+    }
+    for (size_t v = 0; v < owner.size(); ++v) {
+      const auto it = owner[v] < 0 ? tileOf.end() : tileOf.find(static_cast<uint32_t>(owner[v]));
+      if (it == tileOf.end()) continue;
+      const Tile &t = *it->second;
+      const TextureImage &img = *sheetImage[t.sheet];
+      float *uv = &m.texcoords[v * 2];
+      const float u = std::min(std::max(uv[0], 0.0f), 1.0f), w = std::min(std::max(uv[1], 0.0f), 1.0f);
+      uv[0] = (t.x + u * t.width) / img.width;
+      uv[1] = (t.y + w * t.height) / img.height;
+    }
+
+    // Materials now differing only in their (old) texture merge.
+    std::vector<MeshMaterial> materials;
+    materials.swap(m.materials);
+    m.materialIndex.clear();
+    std::vector<uint32_t> remap(materials.size());
+    for (size_t i = 0; i < materials.size(); ++i) {
+      MeshMaterial mat = materials[i];
+      const auto it = mat.texture < 0 ? tileOf.end() : tileOf.find(static_cast<uint32_t>(mat.texture));
+      if (it != tileOf.end()) mat.texture = static_cast<int32_t>(sheetTexture[it->second->sheet]);
+      remap[i] = addMaterial(m, mat);
+    }
+    for (PartRange &p : m.parts) p.material = remap[p.material];
+  }
+  return tiles.size();
+}
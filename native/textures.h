@@ -0,0 +1,221 @@
+// Textures for export: SoTexture2 images as the callback action hands them
+// over, kept once per distinct content (XXH64 of the texels) and written as
+// PNG, or as KTX2 (ktx2.h) with --texture-format etc1s|uastc. With a size
+// limit set (--texture-max-size) each image is box-filtered down to
+// power-of-two dimensions within it, so the client can mipmap it and its GPU
+// memory stays bounded.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ktx2.h"
+#include "parse_cache.h"
+#include "png.h"
+
+// How images are written: PNG, or KTX2 as Basis Universal ETC1S / UASTC.
+enum class TextureFormat { kPng, kEtc1s, kUastc };
+
+// One distinct image. It is encoded on first use (encodeTexture), from any
+// writer thread.
+struct TextureImage {
+  int width = 0;
+  int height = 0;
+  bool alpha = false;         // some texel is not opaque
+  std::vector<uint8_t> rgba;  // rows top to bottom
+  std::once_flag encodeOnce;
+  std::string encoded;        // the image file
+  const char *mimeType = "";  // of `encoded`: image/png or image/ktx2
+  int encodedWidth = 0;
+  int encodedHeight = 0;
+};
+
+// A texture as glTF references it: an image and how it wraps.
+struct TextureRef {
+  uint32_t image;
+  bool clampS;
+  bool clampT;
+};
+
+struct TextureSet {
+  std::deque<TextureImage> images;  // stable addresses for encodeTexture
+  std::vector<TextureRef> textures;
+  std::unordered_map<uint64_t, uint32_t> imageByHash;
+  int maxSize = 0;  // --texture-max-size; 0 = as they are
+  TextureFormat format = TextureFormat::kPng;  // --texture-format
+  bool atlas = false;  // --texture-atlas (texture_atlas.h)
+
+  // The last image added, by address, so shapes sharing a texture do not
+  // hash it again; forget() once its node may have been freed.
+  const unsigned char *lastData = nullptr;
+  int lastWidth = 0, lastHeight = 0, lastComponents = 0;
+  uint32_t lastImage = 0;
+
+  void forget() { lastData = nullptr; }
+};
+
+namespace tex {
+
+// Largest power of two <= v (v >= 1).
+inline int floorPow2(int v) {
+  int p = 1;
+  while (p <= v / 2) p *= 2;
+  return p;
+}
+
+// Four floats, one RGBA texel: GCC/Clang vector extensions, so each texel
+// is one SSE / NEON operation.
+typedef float Texel __attribute__((vector_size(16)));
+
+// Source texels and weights that make up destination texel i of a box
+// filter from `src` to `dst` texels (dst <= src).
+struct Span {
+  int first;
+  std::vector<float> weights;
+};
+
+inline std::vector<Span> boxSpans(int src, int dst) {
+  std::vector<Span> spans(dst);
+  const double scale = double(src) / dst;
+  for (int i = 0; i < dst; ++i) {
+    const double lo = i * scale, hi = (i + 1) * scale;
+    Span &s = spans[i];
+    s.first = static_cast<int>(lo);
+    for (int k = s.first; k < hi && k < src; ++k) {
+      s.weights.push_back(static_cast<float>((std::min<double>(k + 1, hi) - std::max<double>(k, lo)) / scale));
+    }
+  }
+  return spans;
+}
+
+// Area-averaging resize of RGBA8 `src` (w x h) to `dw` x `dh` (no larger):
+// rows first, then columns, in float texels.
+inline std::vector<uint8_t> downscale(const std::vector<uint8_t> &src, int w, int h, int dw, int dh) {
+  const std::vector<Span> xs = boxSpans(w, dw), ys = boxSpans(h, dh);
+  std::vector<Texel> rows(size_t(dw) * h);
+  for (int y = 0; y < h; ++y) {
+    const uint8_t *in = &src[size_t(y) * w * 4];
+    Texel *out = &rows[size_t(y) * dw];
+    for (int x = 0; x < dw; ++x) {
+      Texel acc = {0, 0, 0, 0};
+      const Span &s = xs[x];
+      for (size_t k = 0; k < s.weights.size(); ++k) {
+        const uint8_t *t = in + size_t(s.first + k) * 4;
+        const Texel v = {float(t[0]), float(t[1]), float(t[2]), float(t[3])};
+        acc += v * s.weights[k];
+      }
+      out[x] = acc;
+    }
+  }
+  std::vector<uint8_t> dst(size_t(dw) * dh * 4);
+  std::vector<Texel> acc(dw);
+  for (int y = 0; y < dh; ++y) {
+    std::fill(acc.begin(), acc.end(), Texel{0, 0, 0, 0});
+    const Span &s = ys[y];
+    for (size_t k = 0; k < s.weights.size(); ++k) {
+      const Texel *row = &rows[size_t(s.first + k) * dw];
+      const float wk = s.weights[k];
+      for (int x = 0; x < dw; ++x) acc[x] += row[x] * wk;
+    }
+    uint8_t *out = &dst[size_t(y) * dw * 4];
+    for (int x = 0; x < dw; ++x) {
+      for (int c = 0; c < 4; ++c) out[x * 4 + c] = static_cast<uint8_t>(std::min(acc[x][c] + 0.5f, 255.0f));
+    }
+  }
+  return dst;
+}
+
+}  // namespace tex
+
+// Index into set.textures of the image `data` (`width` x `height` texels of
+// `components` bytes, rows bottom to top as in SoSFImage) wrapped as given.
+static uint32_t addTexture(TextureSet &set, const unsigned char *data, int width, int height,
+                           int components, bool clampS, bool clampT) {
+  uint32_t image;
+  if (data == set.lastData && width == set.lastWidth && height == set.lastHeight &&
+      components == set.lastComponents) {
+    image = set.lastImage;
+  } else {
+    const size_t bytes = size_t(width) * height * components;
+    const uint64_t seed = uint64_t(width) << 32 | uint64_t(height) << 4 | uint64_t(components);
+    const uint64_t hash = xxhash64(data, bytes, seed);
+    const auto ins = set.imageByHash.emplace(hash, static_cast<uint32_t>(set.images.size()));
+    if (ins.second) {
+      set.images.emplace_back();
+      TextureImage &img = set.images.back();
+      img.width = width;
+      img.height = height;
+      img.rgba.resize(size_t(width) * height * 4);
+      // Flipped to top-to-bottom rows, as PNG and glTF UVs have them.
+      for (int y = 0; y < height; ++y) {
+        const unsigned char *in = data + size_t(height - 1 - y) * width * components;
+        uint8_t *out = &img.rgba[size_t(y) * width * 4];
+        for (int x = 0; x < width; ++x, in += components, out += 4) {
+          const bool color = components >= 3;
+          out[0] = in[0];
+          out[1] = color ? in[1] : in[0];
+          out[2] = color ? in[2] : in[0];
+          out[3] = components == 2 ? in[1] : components == 4 ? in[3] : 255;
+          if (out[3] != 255) img.alpha = true;
+        }
+      }
+    }
+    image = ins.first->second;
+    set.lastData = data;
+    set.lastWidth = width;
+    set.lastHeight = height;
+    set.lastComponents = components;
+    set.lastImage = image;
+  }
+  for (size_t i = 0; i < set.textures.size(); ++i) {
+    const TextureRef &t = set.textures[i];
+    if (t.image == image && t.clampS == clampS && t.clampT == clampT) return static_cast<uint32_t>(i);
+  }
+  set.textures.push_back({image, clampS, clampT});
+  return static_cast<uint32_t>(set.textures.size() - 1);
+}
+
+// Encodes img once: resized to power-of-two sides within `maxSize` if that
+// is set, then as KTX2 in `format` where KHR_texture_basisu allows (sides
+// that are multiples of 4), else as PNG, RGB unless some texel is
+// translucent. False if encoding fails.
+static bool encodeTexture(TextureImage &img, int maxSize, TextureFormat format) {
+  std::call_once(img.encodeOnce, [&]() {
+    int w = img.width, h = img.height;
+    std::vector<uint8_t> scaled;
+    const std::vector<uint8_t> *px = &img.rgba;
+    if (maxSize > 0) {
+      w = tex::floorPow2(std::min(w, maxSize));
+      h = tex::floorPow2(std::min(h, maxSize));
+      if (w != img.width || h != img.height) {
+        scaled = tex::downscale(img.rgba, img.width, img.height, w, h);
+        px = &scaled;
+      }
+    }
+    img.encodedWidth = w;
+    img.encodedHeight = h;
+    if (format != TextureFormat::kPng && w % 4 == 0 && h % 4 == 0 &&
+        encodeKtx2(px->data(), w, h, format == TextureFormat::kUastc, img.encoded)) {
+      img.mimeType = "image/ktx2";
+      return;
+    }
+    std::vector<uint8_t> rgb;
+    if (!img.alpha) {
+      rgb.resize(size_t(w) * h * 3);
+      for (size_t i = 0, n = size_t(w) * h; i < n; ++i) {
+        for (int c = 0; c < 3; ++c) rgb[i * 3 + c] = (*px)[i * 4 + c];
+      }
+    }
+    if (encodePng(img.alpha ? px->data() : rgb.data(), w, h, img.alpha ? 4 : 3, img.encoded)) {
+      img.mimeType = "image/png";
+    } else {
+      img.encoded.clear();
+    }
+  });
+  return !img.encoded.empty();
+}
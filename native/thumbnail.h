@@ -0,0 +1,331 @@
+// --thumbnail: CPU rendering of the exported geometry to a PNG, for workers
+// without a GPU. Orthographic three-quarter view framed on the bounds,
+// depth-buffered, flat-shaded from the face normals, 2x2 supersampled onto a
+// transparent background.
+//
+// Tile-based and threaded: vertices are projected in parallel, each thread
+// bins a contiguous range of triangles into 32x32 tiles, and tiles are then
+// rasterized independently, each reading the bins in thread order so the
+// result does not depend on scheduling. Meshes above kThumbnailMaxTriangles
+// are first vertex-clustered on a one-pixel grid, which leaves the image
+// unchanged but bounds the binning memory.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "decimate.h"
+#include "mesh_out.h"
+#include "partial_files.h"
+#include "png.h"
+
+// One mesh to draw and where it goes: world = p * toWorld (row vectors,
+// translation in row 3, as SbMatrix).
+struct ThumbSource {
+  const MeshOut *mesh = nullptr;
+  float toWorld[4][4] = {{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
+};
+
+static constexpr size_t kThumbnailMaxTriangles = 4000000;
+
+namespace thumb {
+
+constexpr int kTile = 32;
+constexpr int kSuper = 2;  // samples per pixel along each axis
+
+inline void normalize(float *v) {
+  const float n = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  if (n > 0.0f) {
+    for (int k = 0; k < 3; ++k) v[k] /= n;
+  }
+}
+
+inline void toWorld(const float (*m)[4], const float *p, float *w) {
+  for (int j = 0; j < 3; ++j) w[j] = p[0] * m[0][j] + p[1] * m[1][j] + p[2] * m[2][j] + m[3][j];
+}
+
+// Pixels [a, b] whose centres (x + 0.5) lie in [lo, hi], clipped to
+// [0, limit); false if there are none.
+inline bool pixelSpan(float lo, float hi, int limit, int &a, int &b) {
+  if (!(lo <= hi)) return false;  // also NaN
+  const float first = std::ceil(lo - 0.5f), last = std::floor(hi - 0.5f);
+  if (first > float(limit - 1) || last < 0.0f) return false;
+  a = first < 0.0f ? 0 : int(first);
+  b = last > float(limit - 1) ? limit - 1 : int(last);
+  return a <= b;
+}
+
+// RGBA, 8 bits per channel, rows top to bottom.
+inline bool writePng(const std::vector<uint8_t> &rgba, int size, const std::string &path, std::string &err) {
+  std::string data;
+  if (!encodePng(rgba.data(), size, size, 4, data)) {
+    err = "PNG compression failed";
+    return false;
+  }
+  PartialFile partial(path);
+  FILE *f = std::fopen(path.c_str(), "wb");
+  if (!f) {
+    err = "cannot create " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  const bool ok = std::fwrite(data.data(), 1, data.size(), f) == data.size();
+  if (std::fclose(f) != 0 || !ok) {
+    err = "write to " + path + " failed";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace thumb
+
+// Renders `sources` into a `size` x `size` PNG at `path`.
+static bool renderThumbnail(const std::vector<ThumbSource> &sources, int size, const std::string &path,
+                            std::string &err) {
+  using namespace thumb;
+  // World bounds of everything drawn.
+  float lo[3] = {+INFINITY, +INFINITY, +INFINITY}, hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+  size_t triangles = 0;
+  for (const ThumbSource &s : sources) {
+    if (!s.mesh->triangleCount()) continue;
+    triangles += s.mesh->triangleCount();
+    for (int c = 0; c < 8; ++c) {
+      const float p[3] = {c & 1 ? s.mesh->posMax[0] : s.mesh->posMin[0],
+                          c & 2 ? s.mesh->posMax[1] : s.mesh->posMin[1],
+                          c & 4 ? s.mesh->posMax[2] : s.mesh->posMin[2]};
+      float w[3];
+      toWorld(s.toWorld, p, w);
+      extendBounds(lo, hi, w[0], w[1], w[2]);
+    }
+  }
+  if (!triangles) {
+    err = "no triangles to render";
+    return false;
+  }
+
+  // Camera: looking down at the centre from +x +y +z, y up.
+  float eye[3] = {1.0f, 0.8f, 1.2f}, up[3] = {0.0f, 1.0f, 0.0f}, right[3], camUp[3];
+  normalize(eye);
+  right[0] = up[1] * eye[2] - up[2] * eye[1];
+  right[1] = up[2] * eye[0] - up[0] * eye[2];
+  right[2] = up[0] * eye[1] - up[1] * eye[0];
+  normalize(right);
+  camUp[0] = eye[1] * right[2] - eye[2] * right[1];
+  camUp[1] = eye[2] * right[0] - eye[0] * right[2];
+  camUp[2] = eye[0] * right[1] - eye[1] * right[0];
+  float light[3];
+  for (int k = 0; k < 3; ++k) light[k] = eye[k] + 0.6f * camUp[k] - 0.4f * right[k];
+  normalize(light);
+  float centre[3], half = 0.0f;
+  for (int k = 0; k < 3; ++k) centre[k] = 0.5f * (lo[k] + hi[k]);
+  for (int c = 0; c < 8; ++c) {
+    float d[3];
+    for (int k = 0; k < 3; ++k) d[k] = ((c >> k & 1) ? hi[k] : lo[k]) - centre[k];
+    half = std::max(half, std::fabs(d[0] * right[0] + d[1] * right[1] + d[2] * right[2]));
+    half = std::max(half, std::fabs(d[0] * camUp[0] + d[1] * camUp[1] + d[2] * camUp[2]));
+  }
+  const int res = size * kSuper;
+  const float scale = half > 0.0f ? 0.5f * res / (half * 1.05f) : 1.0f;
+
+  // Huge meshes: cluster a copy on a one-pixel grid first.
+  std::vector<ThumbSource> drawn = sources;
+  std::vector<MeshOut> reduced;
+  if (triangles > kThumbnailMaxTriangles) {
+    reduced.reserve(sources.size());
+    triangles = 0;
+    for (ThumbSource &s : drawn) {
+      reduced.push_back(*s.mesh);
+      // World pixel size over the largest scale of the mesh's placement.
+      float stretch = 0.0f;
+      for (int i = 0; i < 3; ++i) {
+        stretch = std::max(stretch, std::sqrt(s.toWorld[i][0] * s.toWorld[i][0] +
+                                              s.toWorld[i][1] * s.toWorld[i][1] +
+                                              s.toWorld[i][2] * s.toWorld[i][2]));
+      }
+      if (stretch > 0.0f && reduced.back().triangleCount()) clusterVertices(reduced.back(), 1.0f / (scale * stretch));
+      s.mesh = &reduced.back();
+      triangles += s.mesh->triangleCount();
+    }
+  }
+
+  const unsigned threads = std::max(1u, std::min(std::thread::hardware_concurrency(), 16u));
+  auto parallel = [&](auto &&work) {
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) pool.emplace_back(work, t);
+    work(0u);
+    for (std::thread &th : pool) th.join();
+  };
+
+  // Project: x right, y down (pixels), z towards the viewer.
+  std::vector<size_t> vertexBase, triangleBase;
+  size_t vertices = 0;
+  triangles = 0;
+  for (const ThumbSource &s : drawn) {
+    vertexBase.push_back(vertices);
+    triangleBase.push_back(triangles);
+    vertices += s.mesh->vertexCount();
+    triangles += s.mesh->triangleCount();
+  }
+  std::vector<float> screen(vertices * 3);
+  std::vector<uint8_t> shade(triangles);
+  {
+    std::atomic<size_t> next{0};
+    constexpr size_t kBatch = 1 << 16;
+    parallel([&](unsigned) {
+      for (size_t at; (at = next.fetch_add(kBatch)) < vertices;) {
+        size_t si = std::upper_bound(vertexBase.begin(), vertexBase.end(), at) - vertexBase.begin() - 1;
+        for (size_t v = at; v < std::min(at + kBatch, vertices); ++v) {
+          while (si + 1 < drawn.size() && v >= vertexBase[si + 1]) ++si;
+          float w[3];
+          toWorld(drawn[si].toWorld, &drawn[si].mesh->positions[(v - vertexBase[si]) * 3], w);
+          for (int k = 0; k < 3; ++k) w[k] -= centre[k];
+          screen[v * 3] = 0.5f * res + scale * (w[0] * right[0] + w[1] * right[1] + w[2] * right[2]);
+          screen[v * 3 + 1] = 0.5f * res - scale * (w[0] * camUp[0] + w[1] * camUp[1] + w[2] * camUp[2]);
+          screen[v * 3 + 2] = w[0] * eye[0] + w[1] * eye[1] + w[2] * eye[2];
+        }
+      }
+    });
+  }
+
+  // Bin: thread t takes a contiguous range of triangles.
+  const int tilesX = (res + kTile - 1) / kTile;
+  std::vector<uint32_t> corners(triangles * 3);  // global vertex indices
+  std::vector<std::vector<std::vector<uint32_t>>> bins(threads,
+                                                      std::vector<std::vector<uint32_t>>(tilesX * tilesX));
+  parallel([&](unsigned t) {
+    const size_t begin = triangles * t / threads, end = triangles * (t + 1) / threads;
+    size_t si = std::upper_bound(triangleBase.begin(), triangleBase.end(), begin) - triangleBase.begin() - 1;
+    for (size_t tri = begin; tri < end; ++tri) {
+      while (si + 1 < drawn.size() && tri >= triangleBase[si + 1]) ++si;
+      const MeshOut &m = *drawn[si].mesh;
+      const uint32_t *idx = &m.indices[(tri - triangleBase[si]) * 3];
+      const float *p[3];
+      float bmin[2] = {+INFINITY, +INFINITY}, bmax[2] = {-INFINITY, -INFINITY};
+      for (int k = 0; k < 3; ++k) {
+        corners[tri * 3 + k] = static_cast<uint32_t>(vertexBase[si] + idx[k]);
+        p[k] = &screen[size_t(corners[tri * 3 + k]) * 3];
+        for (int a = 0; a < 2; ++a) {
+          bmin[a] = std::min(bmin[a], p[k][a]);
+          bmax[a] = std::max(bmax[a], p[k][a]);
+        }
+      }
+      int x0, x1, y0, y1;
+      if (!pixelSpan(bmin[0], bmax[0], res, x0, x1) || !pixelSpan(bmin[1], bmax[1], res, y0, y1)) continue;
+
+      // Flat shading from the world-space face normal, lit from both sides.
+      const float *w0 = &m.positions[size_t(idx[0]) * 3], *w1 = &m.positions[size_t(idx[1]) * 3],
+                  *w2 = &m.positions[size_t(idx[2]) * 3];
+      float a[3], b[3], n[3], wn[3];
+      for (int k = 0; k < 3; ++k) {
+        a[k] = w1[k] - w0[k];
+        b[k] = w2[k] - w0[k];
+      }
+      n[0] = a[1] * b[2] - a[2] * b[1];
+      n[1] = a[2] * b[0] - a[0] * b[2];
+      n[2] = a[0] * b[1] - a[1] * b[0];
+      // Placements are rotations with a uniform scale, so the normal
+      // transforms like a direction.
+      const float(*mw)[4] = drawn[si].toWorld;
+      for (int j = 0; j < 3; ++j) wn[j] = n[0] * mw[0][j] + n[1] * mw[1][j] + n[2] * mw[2][j];
+      normalize(wn);
+      const float lit = 0.22f + 0.58f * std::fabs(wn[0] * light[0] + wn[1] * light[1] + wn[2] * light[2]) +
+                        0.2f * std::fabs(wn[0] * eye[0] + wn[1] * eye[1] + wn[2] * eye[2]);
+      shade[tri] = static_cast<uint8_t>(std::min(255.0f, lit * 255.0f));
+
+      for (int ty = y0 / kTile; ty <= y1 / kTile; ++ty) {
+        for (int tx = x0 / kTile; tx <= x1 / kTile; ++tx) bins[t][ty * tilesX + tx].push_back(uint32_t(tri));
+      }
+    }
+  });
+
+  // Rasterize tiles.
+  std::vector<uint8_t> image(size_t(res) * res, 0);  // shade; 0 = background
+  {
+    std::atomic<int> next{0};
+    parallel([&](unsigned) {
+      float depth[kTile * kTile];
+      uint8_t colour[kTile * kTile];
+      for (int tile; (tile = next.fetch_add(1)) < tilesX * tilesX;) {
+        const int ox = (tile % tilesX) * kTile, oy = (tile / tilesX) * kTile;
+        const int tw = std::min(kTile, res - ox), th = std::min(kTile, res - oy);
+        std::fill(depth, depth + kTile * kTile, -INFINITY);
+        std::fill(colour, colour + kTile * kTile, uint8_t(0));
+        for (unsigned t = 0; t < threads; ++t) {
+          for (const uint32_t tri : bins[t][tile]) {
+            const float *p0 = &screen[size_t(corners[size_t(tri) * 3]) * 3];
+            const float *p1 = &screen[size_t(corners[size_t(tri) * 3 + 1]) * 3];
+            const float *p2 = &screen[size_t(corners[size_t(tri) * 3 + 2]) * 3];
+            float area = (p1[0] - p0[0]) * (p2[1] - p0[1]) - (p1[1] - p0[1]) * (p2[0] - p0[0]);
+            if (area == 0.0f) continue;
+            if (area < 0.0f) {
+              std::swap(p1, p2);
+              area = -area;
+            }
+            const float inv = 1.0f / area;
+            const float xmin = std::min({p0[0], p1[0], p2[0]}), xmax = std::max({p0[0], p1[0], p2[0]});
+            const float ymin = std::min({p0[1], p1[1], p2[1]}), ymax = std::max({p0[1], p1[1], p2[1]});
+            int x0, x1, y0, y1;
+            if (!pixelSpan(xmin - ox, xmax - ox, tw, x0, x1) || !pixelSpan(ymin - oy, ymax - oy, th, y0, y1)) {
+              continue;
+            }
+            // Edge functions, stepped per pixel: e(x + 1) = e(x) + dx.
+            const float e0dx = -(p2[1] - p1[1]), e1dx = -(p0[1] - p2[1]), e2dx = -(p1[1] - p0[1]);
+            const float e0dy = p2[0] - p1[0], e1dy = p0[0] - p2[0], e2dy = p1[0] - p0[0];
+            const float sx = ox + x0 + 0.5f, sy = oy + y0 + 0.5f;
+            float r0 = e0dy * (sy - p1[1]) + e0dx * (sx - p1[0]);
+            float r1 = e1dy * (sy - p2[1]) + e1dx * (sx - p2[0]);
+            float r2 = e2dy * (sy - p0[1]) + e2dx * (sx - p0[0]);
+            const uint8_t s = shade[tri];
+            for (int y = y0; y <= y1; ++y, r0 += e0dy, r1 += e1dy, r2 += e2dy) {
+              float *drow = depth + y * kTile;
+              uint8_t *crow = colour + y * kTile;
+              float w0 = r0, w1 = r1, w2 = r2;
+              for (int x = x0; x <= x1; ++x, w0 += e0dx, w1 += e1dx, w2 += e2dx) {
+                const float z = (w0 * p0[2] + w1 * p1[2] + w2 * p2[2]) * inv;
+                const bool hit = w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f && z > drow[x];
+                drow[x] = hit ? z : drow[x];
+                crow[x] = hit ? s : crow[x];
+              }
+            }
+          }
+        }
+        for (int y = 0; y < th; ++y) {
+          // Covered samples are at least 1, so 0 stays background.
+          for (int x = 0; x < tw; ++x) {
+            const uint8_t c = colour[y * kTile + x];
+            image[size_t(oy + y) * res + ox + x] = depth[y * kTile + x] > -INFINITY ? std::max<uint8_t>(c, 1) : 0;
+          }
+        }
+      }
+    });
+  }
+
+  // Resolve the supersamples: average colour of covered samples, alpha by coverage.
+  static const float kBase[3] = {0.64f, 0.68f, 0.74f};
+  std::vector<uint8_t> rgba(size_t(size) * size * 4);
+  for (int y = 0; y < size; ++y) {
+    for (int x = 0; x < size; ++x) {
+      int covered = 0, sum = 0;
+      for (int sy = 0; sy < kSuper; ++sy) {
+        for (int sx = 0; sx < kSuper; ++sx) {
+          const uint8_t c = image[size_t(y * kSuper + sy) * res + x * kSuper + sx];
+          covered += c != 0;
+          sum += c;
+        }
+      }
+      uint8_t *px = &rgba[(size_t(y) * size + x) * 4];
+      for (int k = 0; k < 3; ++k) {
+        px[k] = covered ? static_cast<uint8_t>(kBase[k] * sum / covered + 0.5f) : 0;
+      }
+      px[3] = static_cast<uint8_t>(255 * covered / (kSuper * kSuper));
+    }
+  }
+  return writePng(rgba, size, path, err);
+}
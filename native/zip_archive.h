@@ -0,0 +1,341 @@
+// Read-only .zip access for archive inputs.
+//
+// The archive is mmap'd and its central directory indexed; entries (stored
+// or deflate, including zip64 sizes/offsets) are inflated straight into
+// memory with zlib, so nothing is extracted to disk. extract() only reads the
+// mapping and may be called from several threads at once.
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+struct ZipEntry {
+  std::string name;            // path inside the archive, '/' separated
+  uint64_t compressedSize = 0;
+  uint64_t size = 0;           // uncompressed
+  uint64_t headerOffset = 0;   // local file header
+  uint32_t crc = 0;
+  uint16_t method = 0;         // 0 stored, 8 deflate
+  uint16_t flags = 0;
+
+  bool isDirectory() const { return !name.empty() && name.back() == '/'; }
+};
+
+namespace zipfmt {
+
+constexpr uint32_t kLocalSig = 0x04034b50;
+constexpr uint32_t kCentralSig = 0x02014b50;
+constexpr uint32_t kEndSig = 0x06054b50;
+constexpr uint32_t kEnd64Sig = 0x06064b50;
+constexpr uint32_t kEnd64LocatorSig = 0x07064b50;
+// Deflate expands at most about 1032:1, so a directory claiming more is lying.
+constexpr uint64_t kMaxDeflateRatio = 1032;
+
+inline uint16_t rd16(const unsigned char *p) { return uint16_t(p[0] | (p[1] << 8)); }
+inline uint32_t rd32(const unsigned char *p) {
+  return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+inline uint64_t rd64(const unsigned char *p) { return uint64_t(rd32(p)) | (uint64_t(rd32(p + 4)) << 32); }
+
+inline std::string lower(std::string s) {
+  for (char &c : s) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  return s;
+}
+
+}  // namespace zipfmt
+
+class ZipArchive {
+public:
+  ZipArchive() = default;
+  ZipArchive(const ZipArchive &) = delete;
+  ZipArchive &operator=(const ZipArchive &) = delete;
+  ~ZipArchive() {
+    if (data_) ::munmap(const_cast<unsigned char *>(data_), size_);
+  }
+
+  bool open(const std::string &path, std::string &err) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      err = "cannot open " + path;
+      return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size < 22) {
+      ::close(fd);
+      err = "not a zip archive (too small)";
+      return false;
+    }
+    void *p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+      err = "cannot map " + path;
+      return false;
+    }
+    data_ = static_cast<const unsigned char *>(p);
+    size_ = static_cast<size_t>(st.st_size);
+    return readDirectory(err);
+  }
+
+  const std::vector<ZipEntry> &entries() const { return entries_; }
+
+  // Exact path first, then a case-insensitive match (archives made on
+  // Windows often disagree with the case used in references).
+  const ZipEntry *find(const std::string &name) const {
+    auto it = byName_.find(name);
+    if (it != byName_.end()) return &entries_[it->second];
+    it = byLowerName_.find(zipfmt::lower(name));
+    return it != byLowerName_.end() ? &entries_[it->second] : nullptr;
+  }
+
+  // Inflates `e` into `out` and checks its size and CRC.
+  bool extract(const ZipEntry &e, std::vector<char> &out, std::string &err) const {
+    using namespace zipfmt;
+    if (e.flags & 1) {
+      err = e.name + ": encrypted entries are not supported";
+      return false;
+    }
+    if (e.headerOffset + 30 > size_ || rd32(data_ + e.headerOffset) != kLocalSig) {
+      err = e.name + ": bad local header";
+      return false;
+    }
+    const unsigned char *lh = data_ + e.headerOffset;
+    const uint64_t dataStart = e.headerOffset + 30 + rd16(lh + 26) + rd16(lh + 28);
+    if (dataStart > size_ || e.compressedSize > size_ - dataStart) {
+      err = e.name + ": entry data past end of archive";
+      return false;
+    }
+    const unsigned char *src = data_ + dataStart;
+    if (e.method != 0 && e.method != 8) {
+      err = e.name + ": unsupported compression method " + std::to_string(e.method);
+      return false;
+    }
+    // The sizes come from the central directory: checked before allocating.
+    if (e.method == 0 && e.compressedSize != e.size) {
+      err = e.name + ": stored entry size mismatch";
+      return false;
+    }
+    if (e.method == 8 && e.size / kMaxDeflateRatio > e.compressedSize) {
+      err = e.name + ": declared size " + std::to_string(e.size) + " is impossible for " +
+            std::to_string(e.compressedSize) + " deflated bytes";
+      return false;
+    }
+    if (e.size > out.max_size()) {
+      err = e.name + ": entry too large";
+      return false;
+    }
+    out.resize(static_cast<size_t>(e.size));
+
+    if (e.method == 0) {
+      std::memcpy(out.data(), src, out.size());
+    } else {
+      z_stream zs;
+      std::memset(&zs, 0, sizeof(zs));
+      if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+        err = e.name + ": inflateInit failed";
+        return false;
+      }
+      // zlib counts in uInt; feed and drain in slices for >4 GiB entries.
+      uint64_t inLeft = e.compressedSize, outDone = 0;
+      int rc;
+      do {
+        if (zs.avail_in == 0 && inLeft) {
+          zs.next_in = const_cast<Bytef *>(src + (e.compressedSize - inLeft));
+          zs.avail_in = static_cast<uInt>(std::min<uint64_t>(inLeft, 1u << 30));
+          inLeft -= zs.avail_in;
+        }
+        unsigned char probe;
+        if (outDone == e.size) {
+          // Output is full; only the end-of-stream marker may be left. More
+          // data than the directory (and the scan) declared is corruption.
+          zs.next_out = &probe;
+          zs.avail_out = 1;
+        } else {
+          zs.next_out = reinterpret_cast<Bytef *>(out.data()) + outDone;
+          zs.avail_out = static_cast<uInt>(std::min<uint64_t>(e.size - outDone, 1u << 30));
+        }
+        const uInt before = zs.avail_out;
+        rc = inflate(&zs, Z_NO_FLUSH);
+        if (zs.next_out != &probe + 1) outDone += before - zs.avail_out;
+        else rc = Z_DATA_ERROR;
+        if (rc == Z_BUF_ERROR) rc = (zs.avail_in == 0 && !inLeft) ? Z_DATA_ERROR : Z_OK;
+      } while (rc == Z_OK);
+      inflateEnd(&zs);
+      if (rc != Z_STREAM_END || outDone != e.size) {
+        err = e.name + ": corrupt deflate data";
+        return false;
+      }
+    }
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    for (size_t off = 0; off < out.size(); off += 1u << 30) {
+      const size_t n = std::min<size_t>(out.size() - off, 1u << 30);
+      crc = crc32(crc, reinterpret_cast<const Bytef *>(out.data() + off), static_cast<uInt>(n));
+    }
+    if (static_cast<uint32_t>(crc) != e.crc) {
+      err = e.name + ": CRC mismatch";
+      return false;
+    }
+    return true;
+  }
+
+private:
+  bool readDirectory(std::string &err) {
+    using namespace zipfmt;
+    // End of central directory: last 22 bytes plus up to 64 KiB of comment.
+    const size_t scanFrom = size_ > 22 + 0xFFFF ? size_ - 22 - 0xFFFF : 0;
+    size_t eocd = size_;
+    for (size_t i = size_ - 22 + 1; i-- > scanFrom;) {
+      if (rd32(data_ + i) == kEndSig) {
+        eocd = i;
+        break;
+      }
+    }
+    if (eocd == size_) {
+      err = "not a zip archive (no end of central directory)";
+      return false;
+    }
+    uint64_t count = rd16(data_ + eocd + 10);
+    uint64_t dirSize = rd32(data_ + eocd + 12);
+    uint64_t dirOffset = rd32(data_ + eocd + 16);
+    if (eocd >= 20 && rd32(data_ + eocd - 20) == kEnd64LocatorSig) {
+      const uint64_t e64 = rd64(data_ + eocd - 20 + 8);
+      if (e64 + 56 > size_ || rd32(data_ + e64) != kEnd64Sig) {
+        err = "bad zip64 end of central directory";
+        return false;
+      }
+      count = rd64(data_ + e64 + 32);
+      dirSize = rd64(data_ + e64 + 40);
+      dirOffset = rd64(data_ + e64 + 48);
+    }
+    if (dirOffset > size_ || dirSize > size_ - dirOffset) {
+      err = "central directory past end of archive";
+      return false;
+    }
+
+    entries_.reserve(static_cast<size_t>(std::min<uint64_t>(count, dirSize / 46)));
+    const unsigned char *p = data_ + dirOffset;
+    const unsigned char *end = p + dirSize;
+    for (uint64_t i = 0; i < count; ++i) {
+      if (end - p < 46 || rd32(p) != kCentralSig) {
+        err = "corrupt central directory";
+        return false;
+      }
+      const uint16_t nameLen = rd16(p + 28), extraLen = rd16(p + 30), commentLen = rd16(p + 32);
+      if (static_cast<size_t>(end - p) < 46u + nameLen + extraLen + commentLen) {
+        err = "corrupt central directory";
+        return false;
+      }
+      ZipEntry e;
+      e.flags = rd16(p + 8);
+      e.method = rd16(p + 10);
+      e.crc = rd32(p + 16);
+      e.compressedSize = rd32(p + 20);
+      e.size = rd32(p + 24);
+      e.headerOffset = rd32(p + 42);
+      e.name.assign(reinterpret_cast<const char *>(p + 46), nameLen);
+      std::replace(e.name.begin(), e.name.end(), '\\', '/');
+
+      // Zip64 extended information: only the saturated fields are present,
+      // in this order.
+      const unsigned char *x = p + 46 + nameLen, *xEnd = x + extraLen;
+      while (xEnd - x >= 4) {
+        const uint16_t id = rd16(x), len = rd16(x + 2);
+        if (xEnd - x - 4 < len) break;
+        if (id == 0x0001) {
+          const unsigned char *f = x + 4, *fEnd = f + len;
+          if (e.size == 0xFFFFFFFFu && fEnd - f >= 8) { e.size = rd64(f); f += 8; }
+          if (e.compressedSize == 0xFFFFFFFFu && fEnd - f >= 8) { e.compressedSize = rd64(f); f += 8; }
+          if (e.headerOffset == 0xFFFFFFFFu && fEnd - f >= 8) { e.headerOffset = rd64(f); }
+        }
+        x += 4 + len;
+      }
+
+      byName_.emplace(e.name, entries_.size());
+      byLowerName_.emplace(lower(e.name), entries_.size());
+      entries_.push_back(std::move(e));
+      p += 46 + nameLen + extraLen + commentLen;
+    }
+    return true;
+  }
+
+  const unsigned char *data_ = nullptr;
+  size_t size_ = 0;
+  std::vector<ZipEntry> entries_;
+  std::unordered_map<std::string, size_t> byName_;
+  std::unordered_map<std::string, size_t> byLowerName_;
+};
+
+// True if the file starts with a zip local header (or is an empty archive).
+static inline bool isZipFile(const std::string &path) {
+  unsigned char magic[4] = {0, 0, 0, 0};
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  const ssize_t n = ::read(fd, magic, sizeof(magic));
+  ::close(fd);
+  if (n != 4) return false;
+  const uint32_t sig = zipfmt::rd32(magic);
+  return sig == zipfmt::kLocalSig || sig == zipfmt::kEndSig;
+}
+
+// Inventor/VRML scene entries, skipping directories and macOS resource forks.
+static inline bool isZipModelEntry(const ZipEntry &e) {
+  if (e.isDirectory() || e.name.rfind("__MACOSX/", 0) == 0) return false;
+  const std::string n = zipfmt::lower(e.name);
+  for (const char *ext : {".iv", ".wrl", ".vrml"}) {
+    const size_t len = std::strlen(ext);
+    if (n.size() > len && n.compare(n.size() - len, len, ext) == 0) return true;
+  }
+  return false;
+}
+
+// Resolves a file reference made from archive entry `from` (SoFile name,
+// Inline url, texture filename): relative to that entry's directory, then
+// from the archive root, then by base name alone.
+static inline const ZipEntry *resolveZipReference(const ZipArchive &zip, const std::string &from,
+                                                  std::string ref) {
+  std::replace(ref.begin(), ref.end(), '\\', '/');
+  if (ref.rfind("file://", 0) == 0) ref.erase(0, 7);
+  const size_t slash = from.rfind('/');
+  std::string joined = (slash == std::string::npos || (!ref.empty() && ref[0] == '/'))
+                           ? ref
+                           : from.substr(0, slash + 1) + ref;
+  // Normalise "." and ".." segments.
+  std::vector<std::string> parts;
+  size_t start = 0;
+  while (start <= joined.size()) {
+    size_t end = joined.find('/', start);
+    if (end == std::string::npos) end = joined.size();
+    const std::string seg = joined.substr(start, end - start);
+    if (seg == "..") {
+      if (!parts.empty()) parts.pop_back();
+    } else if (!seg.empty() && seg != ".") {
+      parts.push_back(seg);
+    }
+    start = end + 1;
+  }
+  std::string norm;
+  for (const std::string &s : parts) norm += (norm.empty() ? "" : "/") + s;
+
+  if (const ZipEntry *e = zip.find(norm)) return e;
+  if (const ZipEntry *e = zip.find(ref)) return e;
+  const std::string base = parts.empty() ? ref : parts.back();
+  const ZipEntry *match = nullptr;
+  for (const ZipEntry &e : zip.entries()) {
+    const size_t s = e.name.rfind('/');
+    if (zipfmt::lower(s == std::string::npos ? e.name : e.name.substr(s + 1)) == zipfmt::lower(base)) {
+      if (match) return nullptr;  // ambiguous
+      match = &e;
+    }
+  }
+  return match;
+}
@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""Parse cost with and without iv2glb's --cache-dir, on a generated grid.
+
+Runs the conversion without a cache, once filling one (a miss: parse plus
+writing the entry) and --runs times reading it (hits), and prints the
+median of each stage from --stats:
+
+    python3 tests/bench_parse_cache.py --bin bin/iv2glb --rows 1000
+
+--rows 1000 is a 2M-triangle input of about 60 MB.
+"""
+import argparse
+import json
+import os
+import shutil
+import statistics
+import subprocess
+import tempfile
+import time
+
+from scenes import inventor_scene
+
+STAGES = ("parseMs", "cacheMs", "traverseMs", "writeMs")
+
+
+def run(binary: str, src: str, work: str, cache_dir: str | None) -> dict:
+    stats_path = os.path.join(work, "stats.json")
+    args = [binary, "--stats", stats_path]
+    if cache_dir:
+        args += ["--cache-dir", cache_dir]
+    start = time.monotonic()
+    subprocess.run([*args, src, os.path.join(work, "model.glb")], check=True, capture_output=True)
+    with open(stats_path) as f:
+        stats = json.load(f)
+    stats["wallMs"] = (time.monotonic() - start) * 1000.0
+    return stats
+
+
+def report(label: str, runs: list):
+    cells = [f"{statistics.median(r.get(k) or 0.0 for r in runs):12.1f}" for k in (*STAGES, "wallMs")]
+    cache = runs[0].get("cache") or "-"
+    print(f"{label:<10}{cache:>8}{''.join(cells)}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--bin", default=os.path.join(os.path.dirname(__file__), "..", "bin", "iv2glb"))
+    parser.add_argument("--rows", type=int, default=1000, help="grid of rows x rows quads")
+    parser.add_argument("--runs", type=int, default=5)
+    args = parser.parse_args()
+
+    work = tempfile.mkdtemp()
+    try:
+        src = os.path.join(work, "grid.iv")
+        with open(src, "wb") as f:
+            f.write(inventor_scene(args.rows))
+        cache_dir = os.path.join(work, "cache")
+        os.mkdir(cache_dir)
+        print(f"input: {os.path.getsize(src) / 1e6:.1f} MB, {2 * args.rows * args.rows} triangles")
+        print(f"{'':<10}{'cache':>8}{''.join(f'{k:>12}' for k in (*STAGES, 'wallMs'))}")
+        report("no cache", [run(args.bin, src, work, None) for _ in range(args.runs)])
+        report("miss", [run(args.bin, src, work, cache_dir)])
+        report("hit", [run(args.bin, src, work, cache_dir) for _ in range(args.runs)])
+    finally:
+        shutil.rmtree(work, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main()
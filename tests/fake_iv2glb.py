@@ -0,0 +1,42 @@
+#!/usr/bin/env python3
+"""Stand-in for bin/iv2glb in the worker tests, for machines without Coin.
+
+Understands the calls the worker makes for a single GLB: `--stats PATH`,
+then options it ignores, then the input and output paths ("-" for stdin
+and stdout). Like iv2glb it reads the whole input before writing anything,
+and rejects (exit 4) an input that is not a complete ASCII Inventor scene:
+the header line and balanced braces, so a truncated download fails.
+"""
+import json
+import struct
+import sys
+
+
+def main(argv):
+    stats_path = argv[argv.index("--stats") + 1] if "--stats" in argv else None
+    in_path, out_path = argv[-2], argv[-1]
+    if in_path == "-":
+        data = sys.stdin.buffer.read()
+    else:
+        with open(in_path, "rb") as f:
+            data = f.read()
+    if not data.startswith(b"#Inventor V2.1 ascii") or data.count(b"{") == 0 or data.count(b"{") != data.count(b"}"):
+        sys.stderr.write("Invalid or empty Inventor file\n")
+        return 4
+
+    doc = json.dumps({"asset": {"version": "2.0"}, "extras": {"inputBytes": len(data)}}).encode()
+    doc += b" " * (-len(doc) % 4)
+    glb = struct.pack("<4sII", b"glTF", 2, 12 + 8 + len(doc)) + struct.pack("<I4s", len(doc), b"JSON") + doc
+    if out_path == "-":
+        sys.stdout.buffer.write(glb)
+    else:
+        with open(out_path, "wb") as f:
+            f.write(glb)
+    if stats_path:
+        with open(stats_path, "w") as f:
+            json.dump({"inputBytes": len(data), "parseMs": 1.0, "warnings": [], "metadata": {}}, f)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
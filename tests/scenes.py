@@ -0,0 +1,19 @@
+"""ASCII Inventor inputs for the tests and benchmarks."""
+
+
+def inventor_scene(rows: int) -> bytes:
+    """A grid of rows x rows quads (2 * rows**2 triangles) in one Coordinate3
+    and IndexedFaceSet, the arrays iv2glb's fast path takes once they are
+    large enough."""
+    lines = ["#Inventor V2.1 ascii", "", "Separator {", "  Coordinate3 {", "    point ["]
+    for y in range(rows + 1):
+        lines.append("      " + ", ".join(f"{x * 0.5:.3f} {y * 0.5:.3f} 0" for x in range(rows + 1)) + ",")
+    lines += ["    ]", "  }", "  IndexedFaceSet {", "    coordIndex ["]
+    for y in range(rows):
+        quads = []
+        for x in range(rows):
+            a = y * (rows + 1) + x
+            quads.append(f"{a}, {a + 1}, {a + rows + 2}, {a + rows + 1}, -1")
+        lines.append("      " + ", ".join(quads) + ",")
+    lines += ["    ]", "  }", "}", ""]
+    return "\n".join(lines).encode()
@@ -0,0 +1,102 @@
+"""iv2glb --cache-dir: a second conversion of identical input reads the
+binary cache entry instead of parsing the ASCII source. The traversal
+still runs, since a re-conversion may ask for other output options.
+
+Needs a real build (Coin), so it is skipped unless IV2GLB_BIN or bin/iv2glb
+is one:
+
+    IV2GLB_BIN=bin/iv2glb python3 -m unittest discover tests
+"""
+import json
+import os
+import shutil
+import subprocess
+import tempfile
+import unittest
+
+from scenes import inventor_scene
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+IV2GLB = os.environ.get("IV2GLB_BIN") or os.path.join(os.path.dirname(HERE), "bin", "iv2glb")
+REAL_BUILD = os.access(IV2GLB, os.X_OK) and os.path.basename(IV2GLB) != "fake_iv2glb.py"
+
+
+def convert(src: str, cache_dir: str, work: str) -> dict:
+    """Stats of converting `src` with `cache_dir`; fails the test on a non-zero exit."""
+    stats_path = os.path.join(work, "stats.json")
+    proc = subprocess.run(
+        [IV2GLB, "--stats", stats_path, "--cache-dir", cache_dir, src, os.path.join(work, "model.glb")],
+        capture_output=True,
+        text=True,
+    )
+    if proc.returncode != 0:
+        raise AssertionError(f"iv2glb exited with {proc.returncode}: {proc.stderr.strip()}")
+    with open(stats_path) as f:
+        return json.load(f)
+
+
+def cache_entries(cache_dir: str) -> list:
+    return sorted(n for n in os.listdir(cache_dir) if n.endswith(".ivb"))
+
+
+@unittest.skipUnless(REAL_BUILD, f"needs a real iv2glb build (IV2GLB_BIN, or {IV2GLB})")
+class ParseCacheTest(unittest.TestCase):
+    def setUp(self):
+        self.tmp = tempfile.mkdtemp()
+        self.addCleanup(shutil.rmtree, self.tmp, ignore_errors=True)
+
+    def scene(self, name: str, rows: int) -> str:
+        path = os.path.join(self.tmp, name)
+        with open(path, "wb") as f:
+            f.write(inventor_scene(rows))
+        return path
+
+    def cache_dir(self, name: str) -> str:
+        path = os.path.join(self.tmp, name)
+        os.mkdir(path)
+        return path
+
+    def test_identical_input_hits_the_cache(self):
+        src = self.scene("grid.iv", 60)
+        cache = self.cache_dir("cache")
+        first = convert(src, cache, self.tmp)
+        self.assertEqual(first["cache"], "stored")
+        self.assertGreater(first["fastArrays"], 0)
+        self.assertEqual(len(cache_entries(cache)), 1)
+
+        second = convert(src, cache, self.tmp)
+        self.assertEqual(second["cache"], "hit")
+        self.assertEqual(second["fastArrays"], 0)
+        self.assertEqual(second["fastParseMs"], 0)
+        self.assertEqual(second["triangleCount"], first["triangleCount"])
+        self.assertEqual(second["metadata"]["bounds"], first["metadata"]["bounds"])
+
+    def test_a_hit_does_not_parse_the_source(self):
+        # Another scene's entry under this input's key: what comes out is
+        # that scene, so the source text was never read.
+        small, large = self.scene("small.iv", 20), self.scene("large.iv", 30)
+        small_cache, large_cache = self.cache_dir("small"), self.cache_dir("large")
+        self.assertEqual(convert(small, small_cache, self.tmp)["triangleCount"], 2 * 20 * 20)
+        self.assertEqual(convert(large, large_cache, self.tmp)["triangleCount"], 2 * 30 * 30)
+        (small_entry,), (large_entry,) = cache_entries(small_cache), cache_entries(large_cache)
+        shutil.copyfile(os.path.join(large_cache, large_entry), os.path.join(small_cache, small_entry))
+
+        stats = convert(small, small_cache, self.tmp)
+        self.assertEqual(stats["cache"], "hit")
+        self.assertEqual(stats["triangleCount"], 2 * 30 * 30)
+
+    def test_unreadable_entry_falls_back_to_the_source(self):
+        src = self.scene("grid.iv", 20)
+        cache = self.cache_dir("cache")
+        convert(src, cache, self.tmp)
+        (entry,) = cache_entries(cache)
+        with open(os.path.join(cache, entry), "wb") as f:
+            f.write(b"not an Inventor file")
+
+        stats = convert(src, cache, self.tmp)
+        self.assertEqual(stats["cache"], "stored")
+        self.assertEqual(stats["triangleCount"], 2 * 20 * 20)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,144 @@
+"""Streamed jobs end to end: input downloaded into iv2glb's stdin, GLB
+uploaded from its stdout, both against a local HTTP server.
+
+Runs against tests/fake_iv2glb.py unless IV2GLB_BIN names a real build:
+
+    python3 -m unittest discover tests
+    IV2GLB_BIN=bin/iv2glb python3 -m unittest discover tests
+"""
+import http.server
+import importlib
+import os
+import sys
+import tempfile
+import threading
+import time
+import unittest
+import uuid
+
+from scenes import inventor_scene
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+main = None  # imported in setUpModule, once the environment points at the server
+server = None
+base_url = ""
+tmp = None
+
+SCENE = inventor_scene(120)
+PIECE = 16 << 10
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    """GET /model.iv serves SCENE (honouring the probe's Range); GET
+    /broken.iv promises all of it but drops the connection halfway. PUT and
+    DELETE under /out/ keep the worker's uploads in `server.stored`."""
+
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, *args):
+        pass
+
+    def do_GET(self):
+        if self.path not in ("/model.iv", "/broken.iv"):
+            self.send_error(404)
+            return
+        if self.headers.get("Range", "").startswith("bytes=0-"):
+            last = min(int(self.headers["Range"].split("-")[1]), len(SCENE) - 1)
+            self.send_response(206)
+            self.send_header("Content-Range", f"bytes 0-{last}/{len(SCENE)}")
+            self.send_header("Content-Length", str(last + 1))
+            self.end_headers()
+            self.wfile.write(SCENE[: last + 1])
+            return
+        self.send_response(200)
+        self.send_header("Content-Length", str(len(SCENE)))
+        self.end_headers()
+        end = len(SCENE) // 2 if self.path == "/broken.iv" else len(SCENE)
+        for at in range(0, end, PIECE):
+            self.wfile.write(SCENE[at : min(at + PIECE, end)])
+            self.wfile.flush()
+            time.sleep(0.001)
+        if end < len(SCENE):
+            self.close_connection = True
+
+    def do_PUT(self):
+        body = b""
+        if self.headers.get("Transfer-Encoding", "").lower() == "chunked":
+            while size := int(self.rfile.readline().split(b";")[0], 16):
+                body += self.rfile.read(size)
+                self.rfile.readline()
+            while self.rfile.readline() not in (b"\r\n", b"\n", b""):
+                pass
+        else:
+            body = self.rfile.read(int(self.headers.get("Content-Length") or 0))
+        self.server.stored[self.path] = body
+        self.send_response(201)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+    def do_DELETE(self):
+        self.server.stored.pop(self.path, None)
+        self.send_response(204)
+        self.end_headers()
+
+
+def setUpModule():
+    global main, server, base_url, tmp
+    tmp = tempfile.TemporaryDirectory()
+    server = http.server.ThreadingHTTPServer(("127.0.0.1", 0), Handler)
+    server.stored = {}
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    base_url = f"http://127.0.0.1:{server.server_address[1]}"
+    os.environ.update(
+        WORKER_API_KEY="test-key",
+        WORK_DIR=os.path.join(tmp.name, "work"),
+        OUTPUT_DIR=os.path.join(tmp.name, "out"),
+        OUTPUT_PUT_URL=base_url + "/out/{jobId}/{name}",
+        COST_HISTORY_PATH=os.path.join(tmp.name, "history.jsonl"),
+        MAX_CONCURRENT_JOBS="1",
+        INPUT_FETCH_TIMEOUT_SEC="10",
+    )
+    os.environ.setdefault("IV2GLB_BIN", os.path.join(HERE, "fake_iv2glb.py"))
+    sys.path.insert(0, os.path.dirname(HERE))
+    main = importlib.import_module("main")
+
+
+def tearDownModule():
+    server.shutdown()
+    server.server_close()
+    tmp.cleanup()
+
+
+class StreamingPipelineTest(unittest.TestCase):
+    def run_job(self, path: str) -> tuple[str, dict]:
+        req = main.StartJobRequest(
+            jobId=str(uuid.uuid4()),
+            input={"type": "iv", "url": base_url + path},
+            options={"streaming": True, "thumbnail": False},
+        )
+        job_id = main.start_job(req, authorization="Bearer test-key")["workerJobId"]
+        deadline = time.time() + 60
+        while main.JOBS[job_id]["status"] == "running":
+            self.assertLess(time.time(), deadline, f"job still {main.JOBS[job_id]['stage']}")
+            time.sleep(0.05)
+        return job_id, main.JOBS[job_id]
+
+    def test_streams_input_to_converter_and_output_to_store(self):
+        job_id, job = self.run_job("/model.iv")
+        self.assertEqual(job["status"], "completed", job["error"])
+        self.assertTrue(job["streaming"])
+        glb = server.stored[f"/out/{job_id}/model.glb"]
+        self.assertEqual(glb[:4], b"glTF")
+        self.assertEqual(job["output"]["glbUrl"], f"{base_url}/out/{job_id}/model.glb")
+        self.assertFalse(os.path.exists(os.path.join(main.WORK_DIR, job_id)))
+
+    def test_download_dropped_mid_stream_fails_the_job(self):
+        job_id, job = self.run_job("/broken.iv")
+        self.assertEqual(job["status"], "failed")
+        self.assertIn("download failed", job["error"])
+        self.assertNotIn(f"/out/{job_id}/model.glb", server.stored)
+        self.assertFalse(os.path.exists(os.path.join(main.WORK_DIR, job_id)))
+
+
+if __name__ == "__main__":
+    unittest.main()